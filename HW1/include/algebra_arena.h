@@ -0,0 +1,161 @@
+#ifndef ALGEBRA_ARENA_H // Prevents double inclusion of this header
+#define ALGEBRA_ARENA_H
+
+#include <cstddef>         // For std::size_t, std::max_align_t
+#include <cstdint>         // For std::uintptr_t
+#include <memory_resource> // For std::pmr::memory_resource
+#include <vector>          // For std::pmr::vector
+
+namespace algebra {
+    // Matrix data structure whose rows and elements live in a memory_resource
+    template<typename T>
+    using PMR_MATRIX = std::pmr::vector<std::pmr::vector<T>>;
+
+    // Counters of one arena, "avoided" is the number of allocations that never reached the heap
+    struct ArenaStats {
+        std::size_t allocations{0};
+        std::size_t bytes{0};
+        std::size_t chunks{0};
+        std::size_t releases{0};
+        std::size_t avoided() const { return allocations - chunks; }
+    };
+
+    // Bump allocator: memory is handed out from large chunks and only given back
+    // when the enclosing ArenaScope rewinds, deallocate() is a no-op.
+    class ArenaResource : public std::pmr::memory_resource {
+    public:
+        explicit ArenaResource(std::size_t chunk_size = 64 * 1024,
+                               std::pmr::memory_resource* upstream = std::pmr::new_delete_resource()) :
+            chunk_size(chunk_size),
+            upstream(upstream) {
+
+        }
+
+        ArenaResource(const ArenaResource&) = delete;
+        ArenaResource& operator=(const ArenaResource&) = delete;
+
+        ~ArenaResource() override {
+            for (const auto& chunk : chunks)
+                upstream->deallocate(chunk.data, chunk.size, chunk.alignment);
+        }
+
+        // Position of the bump pointer, used by ArenaScope to rewind
+        struct Mark {
+            std::size_t chunk;
+            std::size_t offset;
+        };
+
+        Mark mark() const {
+            return {current, offset};
+        }
+
+        // Releases everything allocated after `m` in one shot, chunks are kept for reuse
+        void rewind(Mark m) {
+            current = m.chunk;
+            offset = m.offset;
+            ++stats.releases;
+        }
+
+        const ArenaStats& get_stats() const {
+            return stats;
+        }
+
+        void reset_stats() {
+            stats = ArenaStats{};
+        }
+
+    private:
+        struct Chunk {
+            std::byte* data;
+            std::size_t size;
+            std::size_t alignment;
+        };
+
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+            ++stats.allocations;
+            stats.bytes += bytes;
+
+            while (current < chunks.size()) {
+                auto& chunk = chunks[current];
+                auto base = reinterpret_cast<std::uintptr_t>(chunk.data);
+                std::size_t aligned = ((base + offset + alignment - 1) & ~(alignment - 1)) - base;
+                if (aligned + bytes <= chunk.size) {
+                    offset = aligned + bytes;
+                    return chunk.data + aligned;
+                }
+                ++current;
+                offset = 0;
+            }
+
+            // 当前所有 chunk 都放不下, 向上游申请新的 chunk
+            std::size_t size = bytes > chunk_size ? bytes : chunk_size;
+            std::size_t align = alignment > alignof(std::max_align_t) ? alignment : alignof(std::max_align_t);
+            auto* data = static_cast<std::byte*>(upstream->allocate(size, align));
+            chunks.push_back({data, size, align});
+            ++stats.chunks;
+
+            current = chunks.size() - 1;
+            offset = bytes;
+            return data;
+        }
+
+        void do_deallocate(void*, std::size_t, std::size_t) override {
+
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+
+        const std::size_t chunk_size;
+        std::pmr::memory_resource* upstream;
+        std::vector<Chunk> chunks;
+        std::size_t current{0};
+        std::size_t offset{0};
+        ArenaStats stats;
+    };
+
+    // Every thread owns one arena so temporaries never need synchronization
+    inline ArenaResource& thread_arena() {
+        thread_local ArenaResource arena;
+        return arena;
+    }
+
+    // RAII guard: all temporaries allocated while the scope is alive are released when it ends.
+    // Scopes nest like a stack, so recursive routines only keep their live temporaries.
+    class ArenaScope {
+    public:
+        explicit ArenaScope(ArenaResource& arena = thread_arena()) :
+            arena(arena),
+            saved(arena.mark()) {
+
+        }
+
+        ArenaScope(const ArenaScope&) = delete;
+        ArenaScope& operator=(const ArenaScope&) = delete;
+
+        ~ArenaScope() {
+            arena.rewind(saved);
+        }
+
+        std::pmr::memory_resource* resource() const {
+            return &arena;
+        }
+
+    private:
+        ArenaResource& arena;
+        const ArenaResource::Mark saved;
+    };
+
+    // Counters of the calling thread's arena
+    inline const ArenaStats& arena_stats() {
+        return thread_arena().get_stats();
+    }
+
+    template<typename T>
+    PMR_MATRIX<T> make_pmr_matrix(std::size_t rows, std::size_t columns, std::pmr::memory_resource* resource) {
+        return PMR_MATRIX<T>(rows, std::pmr::vector<T>(columns, T{0}, resource), resource);
+    }
+};
+
+#endif // ALGEBRA_ARENA_H
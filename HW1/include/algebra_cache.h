@@ -0,0 +1,214 @@
+#ifndef ALGEBRA_CACHE_H // Prevents double inclusion of this header
+#define ALGEBRA_CACHE_H
+
+#include "algebra.h"
+#include "algebra_solve.h"
+
+#include <algorithm>     // For std::clamp
+#include <array>         // For std::array
+#include <atomic>        // For std::atomic
+#include <cstdint>       // For std::uint64_t
+#include <cstring>       // For std::memcpy
+#include <iterator>      // For std::prev
+#include <list>          // For std::list
+#include <mutex>         // For std::mutex
+#include <optional>      // For std::optional
+#include <unordered_map> // For std::unordered_map
+
+namespace algebra {
+    // xxHash64 style content hash over the elements of every row, seeded with the shape
+    template<typename T>
+    std::uint64_t content_hash(const MATRIX<T>& matrix) {
+        constexpr std::uint64_t P1 = 11400714785074694791ULL;
+        constexpr std::uint64_t P2 = 14029467366897019727ULL;
+        constexpr std::uint64_t P3 = 1609587929392839161ULL;
+        constexpr std::uint64_t P4 = 9650029242287828579ULL;
+        constexpr std::uint64_t P5 = 2870177450012600261ULL;
+
+        auto rotl = [](std::uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+        auto mix = [&](std::uint64_t acc, std::uint64_t lane) { return rotl(acc + lane * P2, 31) * P1; };
+
+        std::uint64_t columns = matrix.empty() ? 0 : matrix[0].size();
+        std::uint64_t h = P5 + matrix.size() * P3 + columns;
+        for (const auto& row : matrix) {
+            const auto* bytes = reinterpret_cast<const unsigned char*>(row.data());
+            std::size_t length = row.size() * sizeof(T);
+            std::size_t i = 0;
+            for (; i + 8 <= length; i += 8) {
+                std::uint64_t lane;
+                std::memcpy(&lane, bytes + i, 8);
+                h ^= mix(0, lane);
+                h = rotl(h, 27) * P1 + P4;
+            }
+            for (; i < length; ++i) {
+                h ^= bytes[i] * P5;
+                h = rotl(h, 11) * P1;
+            }
+        }
+
+        h ^= h >> 33;
+        h *= P2;
+        h ^= h >> 29;
+        h *= P3;
+        h ^= h >> 32;
+        return h;
+    };
+
+    struct CacheStats {
+        std::size_t hits{0};
+        std::size_t misses{0};
+        std::size_t evictions{0};
+    };
+
+    // Opt-in bounded LRU cache memoizing determinant(), inverse() and the LU factors per matrix content.
+    // Entries are spread over independently locked shards, the key matrix is kept so a
+    // hash collision can never return another matrix's result. A capacity below SHARDS
+    // uses only that many shards, so the cache never holds more than it was given.
+    template<typename T, std::size_t SHARDS = 16>
+    class ResultCache {
+    public:
+        explicit ResultCache(std::size_t capacity) :
+            used_shards(std::clamp<std::size_t>(capacity, 1, SHARDS)) {
+            // The remainder goes one entry each to the first shards
+            for (std::size_t i = 0; i < used_shards; ++i)
+                shard_capacity[i] = capacity / used_shards + (i < capacity % used_shards ? 1 : 0);
+        }
+
+        ResultCache(const ResultCache&) = delete;
+        ResultCache& operator=(const ResultCache&) = delete;
+
+        double determinant(const MATRIX<T>& matrix) {
+            if (auto det = lookup(matrix, &Entry::det))
+                return *det;
+
+            double det = algebra::determinant(matrix);
+            store(matrix, [&](Entry& entry) { entry.det = det; });
+            return det;
+        }
+
+        MATRIX<double> inverse(const MATRIX<T>& matrix) {
+            if (auto inv = lookup(matrix, &Entry::inv))
+                return *inv;
+
+            auto inv = algebra::inverse(matrix);
+            store(matrix, [&](Entry& entry) { entry.inv = inv; });
+            return inv;
+        }
+
+        LUFactors<double> lu_decompose(const MATRIX<T>& matrix) {
+            if (auto factors = lookup(matrix, &Entry::lu))
+                return *factors;
+
+            auto factors = algebra::lu_decompose<double>(matrix);
+            store(matrix, [&](Entry& entry) { entry.lu = factors; });
+            return factors;
+        }
+
+        CacheStats get_stats() const {
+            return {hits.load(std::memory_order_relaxed), misses.load(std::memory_order_relaxed),
+                    evictions.load(std::memory_order_relaxed)};
+        }
+
+        std::size_t size() const {
+            std::size_t result = 0;
+            for (const auto& shard : shards) {
+                std::lock_guard lock(shard.mutex);
+                result += shard.lru.size();
+            }
+            return result;
+        }
+
+        void clear() {
+            for (auto& shard : shards) {
+                std::lock_guard lock(shard.mutex);
+                shard.lru.clear();
+                shard.index.clear();
+            }
+        }
+
+    private:
+        struct Entry {
+            std::uint64_t hash;
+            MATRIX<T> key;
+            std::optional<double> det;
+            std::optional<MATRIX<double>> inv;
+            std::optional<LUFactors<double>> lu;
+        };
+
+        struct Shard {
+            mutable std::mutex mutex;
+            std::list<Entry> lru; // 最近使用的在最前面
+            std::unordered_multimap<std::uint64_t, typename std::list<Entry>::iterator> index;
+        };
+
+        std::size_t index_of(std::uint64_t hash) const {
+            return hash % used_shards;
+        }
+
+        // Must be called with the shard locked
+        typename std::list<Entry>::iterator find(Shard& shard, std::uint64_t hash, const MATRIX<T>& matrix) {
+            auto [first, last] = shard.index.equal_range(hash);
+            for (auto it = first; it != last; ++it)
+                if (it->second->key == matrix)
+                    return it->second;
+            return shard.lru.end();
+        }
+
+        template<typename Value>
+        std::optional<Value> lookup(const MATRIX<T>& matrix, std::optional<Value> Entry::* field) {
+            auto hash = content_hash(matrix);
+            auto& shard = shards[index_of(hash)];
+            std::lock_guard lock(shard.mutex);
+
+            auto it = find(shard, hash, matrix);
+            if (it == shard.lru.end() || !((*it).*field).has_value()) {
+                misses.fetch_add(1, std::memory_order_relaxed);
+                return std::nullopt;
+            }
+
+            shard.lru.splice(shard.lru.begin(), shard.lru, it);
+            hits.fetch_add(1, std::memory_order_relaxed);
+            return (*it).*field;
+        }
+
+        // The result is computed outside the lock, store() only merges it into the entry
+        template<typename Update>
+        void store(const MATRIX<T>& matrix, Update update) {
+            auto hash = content_hash(matrix);
+            auto index = index_of(hash);
+            auto& shard = shards[index];
+            std::lock_guard lock(shard.mutex);
+
+            auto it = find(shard, hash, matrix);
+            if (it == shard.lru.end()) {
+                shard.lru.push_front(Entry{hash, matrix, std::nullopt, std::nullopt, std::nullopt});
+                it = shard.lru.begin();
+                shard.index.emplace(hash, it);
+            } else {
+                shard.lru.splice(shard.lru.begin(), shard.lru, it);
+            }
+            update(*it);
+
+            while (shard.lru.size() > shard_capacity[index]) {
+                auto victim = std::prev(shard.lru.end());
+                auto [first, last] = shard.index.equal_range(victim->hash);
+                for (auto jt = first; jt != last; ++jt)
+                    if (jt->second == victim) {
+                        shard.index.erase(jt);
+                        break;
+                    }
+                shard.lru.erase(victim);
+                evictions.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        const std::size_t used_shards;
+        std::array<std::size_t, SHARDS> shard_capacity{};
+        std::array<Shard, SHARDS> shards;
+        std::atomic<std::size_t> hits{0};
+        std::atomic<std::size_t> misses{0};
+        std::atomic<std::size_t> evictions{0};
+    };
+};
+
+#endif // ALGEBRA_CACHE_H
@@ -0,0 +1,393 @@
+#ifndef ALGEBRA_KRYLOV_H // Prevents double inclusion of this header
+#define ALGEBRA_KRYLOV_H
+
+#include "algebra.h"
+#include "algebra_profile.h"
+
+#include <algorithm>  // For std::min
+#include <cmath>      // For std::sqrt, std::fabs, std::hypot
+#include <cstddef>    // For std::size_t
+#include <functional> // For std::function
+#include <stdexcept>  // For std::invalid_argument
+#include <thread>     // For std::thread
+#include <vector>     // For std::vector
+
+namespace algebra {
+    // Multiply-adds a chunk has to carry before it is worth a thread of its own. The solvers call
+    // apply() once per iteration, so anything smaller would spend most of its time in thread start-up.
+    inline constexpr std::size_t PARALLEL_MIN_WORK = std::size_t{1} << 18;
+
+    // Runs fn(begin, end) over [0, n) split into contiguous chunks, one per thread.
+    // Ranges of at most `grain` elements stay on the calling thread since spawning costs more than the work.
+    inline void parallel_for(std::size_t n, std::size_t threads, const std::function<void(std::size_t, std::size_t)>& fn,
+                             std::size_t grain = 4096) {
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = std::min(threads, (n + grain - 1) / grain);
+
+        if (threads <= 1) {
+            fn(0, n);
+            return;
+        }
+
+        std::vector<std::thread> workers;
+        const std::size_t chunk = (n + threads - 1) / threads;
+        for (std::size_t begin = chunk; begin < n; begin += chunk)
+            workers.emplace_back(fn, begin, std::min(n, begin + chunk));
+        fn(0, std::min(n, chunk));
+
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    // Square operator y = A * x, the solvers only ever touch A through this interface
+    class LinearOperator {
+    public:
+        virtual ~LinearOperator() = default;
+
+        virtual std::size_t size() const = 0;
+        virtual void apply(const std::vector<double>& x, std::vector<double>& y) const = 0;
+        // Main diagonal, used by the Jacobi preconditioner
+        virtual std::vector<double> diagonal() const = 0;
+    };
+
+    // Row-parallel GEMV over an algebra matrix, the matrix is referenced, not copied,
+    // so it has to outlive the operator and temporaries are rejected at compile time
+    template<typename T>
+    class DenseOperator : public LinearOperator {
+    public:
+        explicit DenseOperator(const MATRIX<T>& matrix, std::size_t threads = 0) :
+            matrix(matrix),
+            threads(threads) {
+            if (matrix.size() == 0 || matrix.size() != matrix[0].size())
+                throw std::invalid_argument("The number of rows and columns must be equal.");
+        }
+        DenseOperator(MATRIX<T>&&, std::size_t = 0) = delete;
+
+        std::size_t size() const override {
+            return matrix.size();
+        }
+
+        void apply(const std::vector<double>& x, std::vector<double>& y) const override {
+            ALGEBRA_PROFILE_SCOPE("gemv", matrix.size(), matrix.size(), 2.0 * matrix.size() * matrix.size(),
+                                  static_cast<double>(matrix.size() * (matrix.size() * sizeof(T) + 2 * sizeof(double))));
+
+            y.resize(matrix.size());
+            parallel_for(matrix.size(), threads, [&](std::size_t begin, std::size_t end) {
+                for (std::size_t i = begin; i < end; ++i) {
+                    double sum = 0.0;
+                    for (std::size_t j = 0; j < matrix[i].size(); ++j)
+                        sum += static_cast<double>(matrix[i][j]) * x[j];
+                    y[i] = sum;
+                }
+            }, std::max<std::size_t>(1, PARALLEL_MIN_WORK / matrix.size()));
+        }
+
+        std::vector<double> diagonal() const override {
+            std::vector<double> d(matrix.size());
+            for (std::size_t i = 0; i < matrix.size(); ++i)
+                d[i] = static_cast<double>(matrix[i][i]);
+            return d;
+        }
+
+    private:
+        const MATRIX<T>& matrix;
+        const std::size_t threads;
+    };
+
+    // Compressed sparse row matrix with a row-parallel SpMV
+    class SparseOperator : public LinearOperator {
+    public:
+        explicit SparseOperator(std::size_t n, std::size_t threads = 0) :
+            row_offsets(n + 1, 0),
+            threads(threads) {
+
+        }
+
+        // Keeps only the non-zero elements of a dense matrix
+        template<typename T>
+        static SparseOperator from_dense(const MATRIX<T>& matrix, std::size_t threads = 0) {
+            if (matrix.size() == 0 || matrix.size() != matrix[0].size())
+                throw std::invalid_argument("The number of rows and columns must be equal.");
+
+            SparseOperator op(matrix.size(), threads);
+            for (std::size_t i = 0; i < matrix.size(); ++i) {
+                for (std::size_t j = 0; j < matrix[i].size(); ++j)
+                    if (matrix[i][j] != T{0}) {
+                        op.columns.push_back(j);
+                        op.values.push_back(static_cast<double>(matrix[i][j]));
+                    }
+                op.row_offsets[i + 1] = op.values.size();
+            }
+            return op;
+        }
+
+        // Builds the operator from (row, column, value) triplets sorted by row, duplicates are summed by apply()
+        static SparseOperator from_triplets(std::size_t n, const std::vector<std::size_t>& rows,
+                                            const std::vector<std::size_t>& cols, const std::vector<double>& vals,
+                                            std::size_t threads = 0) {
+            if (rows.size() != cols.size() || rows.size() != vals.size())
+                throw std::invalid_argument("Triplet arrays must have the same length.");
+
+            SparseOperator op(n, threads);
+            for (std::size_t k = 0; k < rows.size(); ++k) {
+                if (rows[k] >= n || cols[k] >= n || (k > 0 && rows[k] < rows[k - 1]))
+                    throw std::invalid_argument("Triplets must be in range and sorted by row.");
+                ++op.row_offsets[rows[k] + 1];
+            }
+            for (std::size_t i = 0; i < n; ++i)
+                op.row_offsets[i + 1] += op.row_offsets[i];
+            op.columns = cols;
+            op.values = vals;
+            return op;
+        }
+
+        std::size_t size() const override {
+            return row_offsets.size() - 1;
+        }
+
+        std::size_t non_zeros() const {
+            return values.size();
+        }
+
+        void apply(const std::vector<double>& x, std::vector<double>& y) const override {
+            ALGEBRA_PROFILE_SCOPE("spmv", size(), size(), 2.0 * values.size(),
+                                  static_cast<double>(values.size() * (sizeof(double) + sizeof(std::size_t)) + 3 * size() * sizeof(double)));
+
+            y.resize(size());
+            parallel_for(size(), threads, [&](std::size_t begin, std::size_t end) {
+                for (std::size_t i = begin; i < end; ++i) {
+                    double sum = 0.0;
+                    for (std::size_t k = row_offsets[i]; k < row_offsets[i + 1]; ++k)
+                        sum += values[k] * x[columns[k]];
+                    y[i] = sum;
+                }
+            }, std::max<std::size_t>(4096, PARALLEL_MIN_WORK * size() / std::max<std::size_t>(1, values.size())));
+        }
+
+        std::vector<double> diagonal() const override {
+            std::vector<double> d(size(), 0.0);
+            for (std::size_t i = 0; i < size(); ++i)
+                for (std::size_t k = row_offsets[i]; k < row_offsets[i + 1]; ++k)
+                    if (columns[k] == i)
+                        d[i] += values[k];
+            return d;
+        }
+
+    private:
+        std::vector<std::size_t> row_offsets;
+        std::vector<std::size_t> columns;
+        std::vector<double> values;
+        std::size_t threads;
+    };
+
+    struct KrylovOptions {
+        double tolerance{1e-10};        // Stop once ||r|| <= tolerance * ||b||
+        std::size_t max_iterations{1000};
+        std::size_t restart{30};        // GMRES only
+        bool jacobi{false};             // Precondition with the inverse diagonal
+        // Called after every iteration with (iteration, relative residual)
+        std::function<void(std::size_t, double)> monitor{};
+    };
+
+    struct KrylovResult {
+        std::vector<double> x;
+        bool converged{false};
+        std::size_t iterations{0};
+        std::vector<double> residuals; // Relative residual norm per iteration, [0] is the initial one
+    };
+
+    inline double dot(const std::vector<double>& a, const std::vector<double>& b) {
+        double sum = 0.0;
+        for (std::size_t i = 0; i < a.size(); ++i)
+            sum += a[i] * b[i];
+        return sum;
+    }
+
+    inline std::vector<double> jacobi_weights(const LinearOperator& op, bool enabled) {
+        std::vector<double> weights(op.size(), 1.0);
+        if (!enabled)
+            return weights;
+
+        auto d = op.diagonal();
+        for (std::size_t i = 0; i < d.size(); ++i) {
+            if (d[i] == 0.0)
+                throw std::invalid_argument("Jacobi preconditioner needs a non-zero diagonal.");
+            weights[i] = 1.0 / d[i];
+        }
+        return weights;
+    }
+
+    // (Preconditioned) conjugate gradient for symmetric positive definite operators
+    inline KrylovResult conjugate_gradient(const LinearOperator& op, const std::vector<double>& b,
+                                           const KrylovOptions& options = {}) {
+        const std::size_t n = op.size();
+        if (b.size() != n)
+            throw std::invalid_argument("The size of b must be equal to the operator size.");
+
+        ALGEBRA_PROFILE_SCOPE("conjugate_gradient", n, n, 0.0, 0.0);
+
+        KrylovResult result{std::vector<double>(n, 0.0), false, 0, {}};
+        const auto weights = jacobi_weights(op, options.jacobi);
+        const double norm_b = std::sqrt(dot(b, b));
+        if (norm_b == 0.0) {
+            result.converged = true;
+            result.residuals.push_back(0.0);
+            return result;
+        }
+
+        std::vector<double> r(b), z(n), p(n), q(n);
+        for (std::size_t i = 0; i < n; ++i)
+            z[i] = weights[i] * r[i];
+        p = z;
+        double rz = dot(r, z);
+        result.residuals.push_back(1.0);
+
+        for (std::size_t k = 1; k <= options.max_iterations; ++k) {
+            op.apply(p, q);
+            const double pq = dot(p, q);
+            if (pq <= 0.0)
+                throw std::invalid_argument("The operator is not positive definite.");
+
+            const double alpha = rz / pq;
+            for (std::size_t i = 0; i < n; ++i) {
+                result.x[i] += alpha * p[i];
+                r[i] -= alpha * q[i];
+            }
+
+            const double relative = std::sqrt(dot(r, r)) / norm_b;
+            result.iterations = k;
+            result.residuals.push_back(relative);
+            if (options.monitor)
+                options.monitor(k, relative);
+            if (relative <= options.tolerance) {
+                result.converged = true;
+                break;
+            }
+
+            for (std::size_t i = 0; i < n; ++i)
+                z[i] = weights[i] * r[i];
+            const double rz_next = dot(r, z);
+            const double beta = rz_next / rz;
+            rz = rz_next;
+            for (std::size_t i = 0; i < n; ++i)
+                p[i] = z[i] + beta * p[i];
+        }
+
+        return result;
+    }
+
+    // Restarted GMRES(m) with Givens rotations, the optional Jacobi preconditioner is applied
+    // from the right so the monitored residual is the true one
+    inline KrylovResult gmres(const LinearOperator& op, const std::vector<double>& b, const KrylovOptions& options = {}) {
+        const std::size_t n = op.size();
+        if (b.size() != n)
+            throw std::invalid_argument("The size of b must be equal to the operator size.");
+        if (options.restart == 0)
+            throw std::invalid_argument("The restart length must be positive.");
+
+        ALGEBRA_PROFILE_SCOPE("gmres", n, n, 0.0, 0.0);
+
+        KrylovResult result{std::vector<double>(n, 0.0), false, 0, {}};
+        const auto weights = jacobi_weights(op, options.jacobi);
+        const double norm_b = std::sqrt(dot(b, b));
+        if (norm_b == 0.0) {
+            result.converged = true;
+            result.residuals.push_back(0.0);
+            return result;
+        }
+
+        const std::size_t m = std::min(options.restart, n);
+        std::vector<std::vector<double>> v(m + 1, std::vector<double>(n));
+        MATRIX<double> h(m + 1, std::vector<double>(m, 0.0));
+        std::vector<double> cs(m), sn(m), g(m + 1), w(n), t(n);
+        result.residuals.push_back(1.0);
+        bool breakdown = false;
+
+        while (result.iterations < options.max_iterations) {
+            // r = b - A * x
+            op.apply(result.x, w);
+            for (std::size_t i = 0; i < n; ++i)
+                v[0][i] = b[i] - w[i];
+            double beta = std::sqrt(dot(v[0], v[0]));
+            if (beta / norm_b <= options.tolerance) {
+                result.converged = true;
+                break;
+            }
+            for (auto& elem : v[0])
+                elem /= beta;
+            std::fill(g.begin(), g.end(), 0.0);
+            g[0] = beta;
+
+            std::size_t j = 0;
+            for (; j < m && result.iterations < options.max_iterations; ++j) {
+                // Arnoldi step with modified Gram-Schmidt on A * M^-1 * v_j
+                for (std::size_t i = 0; i < n; ++i)
+                    t[i] = weights[i] * v[j][i];
+                op.apply(t, w);
+                for (std::size_t i = 0; i <= j; ++i) {
+                    h[i][j] = dot(w, v[i]);
+                    for (std::size_t l = 0; l < n; ++l)
+                        w[l] -= h[i][j] * v[i][l];
+                }
+                h[j + 1][j] = std::sqrt(dot(w, w));
+                if (h[j + 1][j] != 0.0)
+                    for (std::size_t l = 0; l < n; ++l)
+                        v[j + 1][l] = w[l] / h[j + 1][j];
+
+                for (std::size_t i = 0; i < j; ++i) {
+                    const double tmp = cs[i] * h[i][j] + sn[i] * h[i + 1][j];
+                    h[i + 1][j] = -sn[i] * h[i][j] + cs[i] * h[i + 1][j];
+                    h[i][j] = tmp;
+                }
+                const double r = std::hypot(h[j][j], h[j + 1][j]);
+                if (r == 0.0) {
+                    // A * M^-1 is singular on the Krylov space: column j adds nothing to the least
+                    // squares problem and a restart from the same residual would rebuild it
+                    ++result.iterations;
+                    result.residuals.push_back(result.residuals.back());
+                    if (options.monitor)
+                        options.monitor(result.iterations, result.residuals.back());
+                    breakdown = true;
+                    break;
+                }
+                cs[j] = h[j][j] / r;
+                sn[j] = h[j + 1][j] / r;
+                h[j][j] = r;
+                h[j + 1][j] = 0.0;
+                g[j + 1] = -sn[j] * g[j];
+                g[j] = cs[j] * g[j];
+
+                const double relative = std::fabs(g[j + 1]) / norm_b;
+                ++result.iterations;
+                result.residuals.push_back(relative);
+                if (options.monitor)
+                    options.monitor(result.iterations, relative);
+                if (relative <= options.tolerance) {
+                    ++j;
+                    result.converged = true;
+                    break;
+                }
+            }
+
+            // x += M^-1 * V * y, with H * y = g solved by back substitution
+            std::vector<double> y(j);
+            for (std::size_t i = j; i-- > 0;) {
+                double sum = g[i];
+                for (std::size_t l = i + 1; l < j; ++l)
+                    sum -= h[i][l] * y[l];
+                y[i] = sum / h[i][i];
+            }
+            for (std::size_t i = 0; i < j; ++i)
+                for (std::size_t l = 0; l < n; ++l)
+                    result.x[l] += weights[l] * y[i] * v[i][l];
+
+            if (result.converged || breakdown)
+                break;
+        }
+
+        return result;
+    }
+};
+
+#endif // ALGEBRA_KRYLOV_H
@@ -0,0 +1,209 @@
+#ifndef ALGEBRA_PROFILE_H // Prevents double inclusion of this header
+#define ALGEBRA_PROFILE_H
+
+#include <algorithm>  // For std::max
+#include <chrono>     // For std::chrono::steady_clock
+#include <cstddef>    // For std::size_t
+#include <cstdlib>    // For std::atexit
+#include <format>     // For std::format
+#include <fstream>    // For std::ofstream
+#include <functional> // For std::hash
+#include <map>        // For std::map
+#include <mutex>      // For std::mutex
+#include <ostream>    // For std::ostream
+#include <string>     // For std::string
+#include <thread>     // For std::this_thread::get_id
+#include <vector>     // For std::vector
+
+// Instrumentation is compiled in only when ALGEBRA_PROFILE is defined
+// (cmake -DALGEBRA_PROFILE=ON), otherwise every hook expands to nothing.
+#ifdef ALGEBRA_PROFILE
+#define ALGEBRA_PROFILE_CONCAT_(a, b) a##b
+#define ALGEBRA_PROFILE_CONCAT(a, b) ALGEBRA_PROFILE_CONCAT_(a, b)
+#define ALGEBRA_PROFILE_SCOPE(name, rows, columns, flops, bytes) \
+    ::algebra::OpScope ALGEBRA_PROFILE_CONCAT(algebra_profile_scope_, __LINE__)(name, rows, columns, flops, bytes)
+#else
+#define ALGEBRA_PROFILE_SCOPE(name, rows, columns, flops, bytes) ((void)0)
+#endif
+
+namespace algebra {
+    // Accumulated counters of one operation
+    struct OpStats {
+        std::size_t calls{0};
+        std::size_t max_rows{0};
+        std::size_t max_columns{0};
+        double seconds{0.0};
+        double flops{0.0};
+        double bytes{0.0};
+    };
+
+    enum class ProfileFormat { Table, ChromeTrace };
+
+    class Profiler {
+    public:
+        static Profiler& instance() {
+            static Profiler profiler;
+            return profiler;
+        }
+
+        void record(const char* name, std::size_t rows, std::size_t columns, double flops, double bytes,
+                    std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+            std::lock_guard lock(mutex);
+
+            auto& stats = ops[name];
+            ++stats.calls;
+            stats.max_rows = std::max(stats.max_rows, rows);
+            stats.max_columns = std::max(stats.max_columns, columns);
+            stats.seconds += std::chrono::duration<double>(end - start).count();
+            stats.flops += flops;
+            stats.bytes += bytes;
+
+            if (events.size() < MAX_EVENTS)
+                events.push_back({name, rows, columns, flops, bytes, start - origin, end - start,
+                                  std::hash<std::thread::id>{}(std::this_thread::get_id())});
+        }
+
+        std::map<std::string, OpStats> get_stats() const {
+            std::lock_guard lock(mutex);
+            return ops;
+        }
+
+        void reset() {
+            std::lock_guard lock(mutex);
+            ops.clear();
+            events.clear();
+        }
+
+        // Summary table, one line per operation
+        void dump_table(std::ostream& os) const {
+            std::lock_guard lock(mutex);
+
+            os << std::format("{:<18}|{:>10}|{:>11}|{:>12}|{:>12}|{:>12}|{:>10}", "operation", "calls", "max dims",
+                              "time (ms)", "GFLOP", "MB moved", "GFLOP/s") << '\n';
+            for (const auto& [name, stats] : ops) {
+                double gflop = stats.flops / 1e9;
+                os << std::format("{:<18}|{:>10}|{:>11}|{:>12.3f}|{:>12.6f}|{:>12.3f}|{:>10.3f}", name, stats.calls,
+                                  std::format("{}x{}", stats.max_rows, stats.max_columns), stats.seconds * 1e3,
+                                  gflop, stats.bytes / 1e6, stats.seconds > 0 ? gflop / stats.seconds : 0.0) << '\n';
+            }
+            os.flush();
+        }
+
+        // Chrome trace event JSON, loadable in chrome://tracing or Perfetto
+        void dump_chrome_trace(std::ostream& os) const {
+            std::lock_guard lock(mutex);
+
+            os << "{\"traceEvents\":[";
+            for (std::size_t i = 0; i < events.size(); ++i) {
+                const auto& e = events[i];
+                os << (i ? ",\n" : "\n")
+                   << std::format(R"({{"name":"{}","ph":"X","pid":0,"tid":{},"ts":{:.3f},"dur":{:.3f},)",
+                                  e.name, e.thread % 1000000, to_us(e.start), to_us(e.duration))
+                   << std::format(R"("args":{{"rows":{},"columns":{},"flops":{},"bytes":{}}}}})",
+                                  e.rows, e.columns, e.flops, e.bytes);
+            }
+            os << "\n]}" << std::endl;
+        }
+
+        void dump(std::ostream& os, ProfileFormat format) const {
+            if (format == ProfileFormat::ChromeTrace)
+                dump_chrome_trace(os);
+            else
+                dump_table(os);
+        }
+
+        // Writes the report to `file_name` when the program exits
+        void dump_at_exit(const std::string& file_name, ProfileFormat format = ProfileFormat::Table) {
+            {
+                std::lock_guard lock(mutex);
+                exit_file = file_name;
+                exit_format = format;
+            }
+            // A function-local static is initialized exactly once, however many threads get here
+            [[maybe_unused]] static const int registered = std::atexit([] {
+                auto& profiler = Profiler::instance();
+                // Copied under the lock, dump takes it again
+                std::string file_name;
+                ProfileFormat format;
+                {
+                    std::lock_guard lock(profiler.mutex);
+                    file_name = profiler.exit_file;
+                    format = profiler.exit_format;
+                }
+                std::ofstream os(file_name);
+                profiler.dump(os, format);
+            });
+        }
+
+    private:
+        static constexpr std::size_t MAX_EVENTS = 1 << 20;
+
+        struct Event {
+            const char* name;
+            std::size_t rows;
+            std::size_t columns;
+            double flops;
+            double bytes;
+            std::chrono::steady_clock::duration start;
+            std::chrono::steady_clock::duration duration;
+            std::size_t thread;
+        };
+
+        static double to_us(std::chrono::steady_clock::duration d) {
+            return std::chrono::duration<double, std::micro>(d).count();
+        }
+
+        Profiler() : origin(std::chrono::steady_clock::now()) {
+
+        }
+
+        mutable std::mutex mutex;
+        const std::chrono::steady_clock::time_point origin;
+        std::map<std::string, OpStats> ops;
+        std::vector<Event> events;
+        std::string exit_file;
+        ProfileFormat exit_format{ProfileFormat::Table};
+    };
+
+    // RAII hook timing one call of an operation, see ALGEBRA_PROFILE_SCOPE
+    class OpScope {
+    public:
+        OpScope(const char* name, std::size_t rows, std::size_t columns, double flops, double bytes) :
+            name(name),
+            rows(rows),
+            columns(columns),
+            flops(flops),
+            bytes(bytes),
+            start(std::chrono::steady_clock::now()) {
+
+        }
+
+        OpScope(const OpScope&) = delete;
+        OpScope& operator=(const OpScope&) = delete;
+
+        ~OpScope() {
+            Profiler::instance().record(name, rows, columns, flops, bytes, start, std::chrono::steady_clock::now());
+        }
+
+    private:
+        const char* name;
+        std::size_t rows;
+        std::size_t columns;
+        double flops;
+        double bytes;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    // Multiply-adds performed by a cofactor expansion of an n x n matrix
+    inline double cofactor_flops(std::size_t n) {
+        double flops = 0.0;
+        double calls = 1.0;
+        for (std::size_t k = n; k > 2; --k) {
+            flops += calls * 2.0 * static_cast<double>(k);
+            calls *= static_cast<double>(k);
+        }
+        return flops + calls * 3.0;
+    }
+};
+
+#endif // ALGEBRA_PROFILE_H
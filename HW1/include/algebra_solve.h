@@ -0,0 +1,238 @@
+#ifndef ALGEBRA_SOLVE_H // Prevents double inclusion of this header
+#define ALGEBRA_SOLVE_H
+
+#include "algebra.h"
+#include "algebra_profile.h"
+
+#include <algorithm> // For std::fill, std::max
+#include <cmath>     // For std::fabs, std::sqrt
+#include <cstddef>   // For std::size_t
+#include <limits>    // For std::numeric_limits
+#include <numeric>   // For std::iota
+#include <stdexcept> // For std::invalid_argument
+#include <utility>   // For std::swap
+#include <vector>    // For std::vector
+
+namespace algebra {
+    // Row-pivoted LU factors: P * A = L * U, L (unit diagonal) and U share `lu`
+    // and row i of P * A is row pivots[i] of A
+    template<typename T>
+    struct LUFactors {
+        MATRIX<T> lu;
+        std::vector<std::size_t> pivots;
+        bool singular{false};
+        double norm1{0.0}; // ||A||_1, kept for the condition estimate
+    };
+
+    // Gaussian elimination with partial pivoting carried out in precision T
+    template<typename T, typename U>
+    LUFactors<T> lu_decompose(const MATRIX<U>& matrix) {
+        if (matrix.size() == 0 || matrix.size() != matrix[0].size())
+            throw std::invalid_argument("The number of rows and columns must be equal.");
+
+        const std::size_t n = matrix.size();
+        ALGEBRA_PROFILE_SCOPE("lu_decompose", n, n, 2.0 * n * n * n / 3.0, static_cast<double>(n * n * (sizeof(U) + sizeof(T))));
+
+        LUFactors<T> factors{MATRIX<T>(n, std::vector<T>(n, T{0})), std::vector<std::size_t>(n), false, 0.0};
+        std::iota(factors.pivots.begin(), factors.pivots.end(), 0);
+
+        for (std::size_t j = 0; j < n; ++j) {
+            double column = 0.0;
+            for (std::size_t i = 0; i < n; ++i) {
+                factors.lu[i][j] = static_cast<T>(matrix[i][j]);
+                column += std::fabs(static_cast<double>(matrix[i][j]));
+            }
+            factors.norm1 = std::max(factors.norm1, column);
+        }
+
+        auto& lu = factors.lu;
+        for (std::size_t k = 0; k < n; ++k) {
+            std::size_t p = k;
+            for (std::size_t i = k + 1; i < n; ++i)
+                if (std::fabs(lu[i][k]) > std::fabs(lu[p][k]))
+                    p = i;
+
+            if (lu[p][k] == T{0}) {
+                factors.singular = true;
+                continue;
+            }
+
+            if (p != k) {
+                std::swap(lu[p], lu[k]);
+                std::swap(factors.pivots[p], factors.pivots[k]);
+            }
+
+            for (std::size_t i = k + 1; i < n; ++i) {
+                lu[i][k] /= lu[k][k];
+                const T l = lu[i][k];
+                for (std::size_t j = k + 1; j < n; ++j)
+                    lu[i][j] -= l * lu[k][j];
+            }
+        }
+
+        return factors;
+    };
+
+    // Solves A * x = b, or A^T * x = b when `transposed`, from the factors of A
+    template<typename T>
+    std::vector<double> lu_solve(const LUFactors<T>& factors, const std::vector<double>& b, bool transposed = false) {
+        const auto& lu = factors.lu;
+        const std::size_t n = lu.size();
+        if (b.size() != n)
+            throw std::invalid_argument("The size of b must be equal to the number of rows.");
+        if (factors.singular)
+            throw std::invalid_argument("The matrix is singular.");
+
+        std::vector<T> y(n);
+        if (!transposed) {
+            // L * y = P * b, then U * x = y
+            for (std::size_t i = 0; i < n; ++i) {
+                T sum = static_cast<T>(b[factors.pivots[i]]);
+                for (std::size_t j = 0; j < i; ++j)
+                    sum -= lu[i][j] * y[j];
+                y[i] = sum;
+            }
+            for (std::size_t i = n; i-- > 0;) {
+                T sum = y[i];
+                for (std::size_t j = i + 1; j < n; ++j)
+                    sum -= lu[i][j] * y[j];
+                y[i] = sum / lu[i][i];
+            }
+            return std::vector<double>(y.begin(), y.end());
+        }
+
+        // U^T * w = b, then L^T * v = w, then x = P^T * v
+        for (std::size_t i = 0; i < n; ++i) {
+            T sum = static_cast<T>(b[i]);
+            for (std::size_t j = 0; j < i; ++j)
+                sum -= lu[j][i] * y[j];
+            y[i] = sum / lu[i][i];
+        }
+        for (std::size_t i = n; i-- > 0;) {
+            T sum = y[i];
+            for (std::size_t j = i + 1; j < n; ++j)
+                sum -= lu[j][i] * y[j];
+            y[i] = sum;
+        }
+        std::vector<double> x(n);
+        for (std::size_t i = 0; i < n; ++i)
+            x[factors.pivots[i]] = static_cast<double>(y[i]);
+        return x;
+    };
+
+    // Reciprocal 1-norm condition number, ||A^-1||_1 is estimated with Hager's method
+    // (LAPACK xLACON) from a handful of solves instead of forming the inverse
+    template<typename T>
+    double rcond_estimate(const LUFactors<T>& factors) {
+        if (factors.singular || factors.norm1 == 0.0)
+            return 0.0;
+
+        const std::size_t n = factors.lu.size();
+        std::vector<double> x(n, 1.0 / static_cast<double>(n));
+        double estimate = 0.0;
+        std::size_t last = n;
+
+        for (int iteration = 0; iteration < 5; ++iteration) {
+            auto y = lu_solve(factors, x);
+            double norm = 0.0;
+            for (auto& elem : y) {
+                norm += std::fabs(elem);
+                elem = elem >= 0.0 ? 1.0 : -1.0;
+            }
+            estimate = std::max(estimate, norm);
+
+            auto z = lu_solve(factors, y, true);
+            std::size_t j = 0;
+            double ztx = 0.0;
+            for (std::size_t i = 0; i < n; ++i) {
+                ztx += z[i] * x[i];
+                if (std::fabs(z[i]) > std::fabs(z[j]))
+                    j = i;
+            }
+            if (std::fabs(z[j]) <= ztx || j == last)
+                break;
+
+            std::fill(x.begin(), x.end(), 0.0);
+            x[j] = 1.0;
+            last = j;
+        }
+
+        return 1.0 / (factors.norm1 * estimate);
+    };
+
+    // Estimated 1-norm condition number kappa_1(A) = ||A||_1 * ||A^-1||_1
+    template<typename T>
+    double condition_number(const MATRIX<T>& matrix) {
+        double rcond = rcond_estimate(lu_decompose<double>(matrix));
+        return rcond == 0.0 ? std::numeric_limits<double>::infinity() : 1.0 / rcond;
+    };
+
+    // Solves A * x = b to double accuracy: the O(n^3) factorization runs in float and
+    // the O(n^2) residuals r = b - A * x are refined in double. Falls back to a double
+    // factorization when A is too ill-conditioned for float refinement to converge.
+    template<typename T>
+    std::vector<double> solve(const MATRIX<T>& matrix, const std::vector<double>& b, std::size_t max_iterations = 10) {
+        if (matrix.size() == 0 || matrix.size() != matrix[0].size())
+            throw std::invalid_argument("The number of rows and columns must be equal.");
+        if (b.size() != matrix.size())
+            throw std::invalid_argument("The size of b must be equal to the number of rows.");
+
+        const std::size_t n = matrix.size();
+        ALGEBRA_PROFILE_SCOPE("solve", n, n, 2.0 * n * n * n / 3.0 + 4.0 * n * n * max_iterations,
+                              static_cast<double>(n * n * sizeof(T)));
+
+        auto residual = [&](const std::vector<double>& x) {
+            std::vector<double> r(b);
+            for (std::size_t i = 0; i < n; ++i)
+                for (std::size_t j = 0; j < n; ++j)
+                    r[i] -= static_cast<double>(matrix[i][j]) * x[j];
+            return r;
+        };
+
+        double norm_inf = 0.0;
+        for (const auto& row : matrix) {
+            double sum = 0.0;
+            for (const auto& elem : row)
+                sum += std::fabs(static_cast<double>(elem));
+            norm_inf = std::max(norm_inf, sum);
+        }
+        const double tolerance = std::sqrt(static_cast<double>(n)) * std::numeric_limits<double>::epsilon() * norm_inf;
+
+        // Same stopping rule as LAPACK dsgesv: ||r||_inf <= sqrt(n) * eps * ||A||_inf * ||x||_inf
+        auto refine = [&](const auto& factors, std::vector<double>& x) {
+            for (std::size_t iteration = 0; iteration <= max_iterations; ++iteration) {
+                auto r = residual(x);
+                double nr = 0.0, nx = 0.0;
+                for (std::size_t i = 0; i < n; ++i) {
+                    nr = std::max(nr, std::fabs(r[i]));
+                    nx = std::max(nx, std::fabs(x[i]));
+                }
+                if (nr <= tolerance * nx)
+                    return true;
+                if (iteration == max_iterations)
+                    break;
+
+                auto d = lu_solve(factors, r);
+                for (std::size_t i = 0; i < n; ++i)
+                    x[i] += d[i];
+            }
+            return false;
+        };
+
+        auto single = lu_decompose<float>(matrix);
+        if (!single.singular && rcond_estimate(single) > std::numeric_limits<float>::epsilon()) {
+            auto x = lu_solve(single, b);
+            if (refine(single, x))
+                return x;
+        }
+
+        auto full = lu_decompose<double>(matrix);
+        if (full.singular)
+            throw std::invalid_argument("The matrix is singular.");
+        auto x = lu_solve(full, b);
+        refine(full, x);
+        return x;
+    };
+};
+
+#endif // ALGEBRA_SOLVE_H
@@ -1,10 +1,14 @@
 // #include "algebra.h"
+#include "algebra_arena.h"
+#include "algebra_profile.h"
+#include "algebra_solve.h"
 
 #include <stdexcept>
 #include <random>
 #include <format>
 #include <iostream>
 #include <cmath>
+#include <limits>
 
 namespace algebra {
     // Function template for matrix initialization
@@ -14,6 +18,8 @@ namespace algebra {
         if (rows == 0 || columns == 0)
             throw std::invalid_argument("Invalid matrix size");
 
+        ALGEBRA_PROFILE_SCOPE("create_matrix", rows, columns, 0.0, static_cast<double>(rows * columns * sizeof(T)));
+
         MATRIX<T> matrix(rows, std::vector<T>(columns, T{0}));
         switch (type.value()) {
             case MatrixType::Ones : {
@@ -67,6 +73,9 @@ namespace algebra {
         if (matrixA.size() != matrixB.size() || matrixA[0].size() != matrixB[0].size())
             throw std::invalid_argument("The number of rows and columns must be equal.");
 
+        ALGEBRA_PROFILE_SCOPE("sum_sub", matrixA.size(), matrixA[0].size(), static_cast<double>(matrixA.size() * matrixA[0].size()),
+                              static_cast<double>(3 * matrixA.size() * matrixA[0].size() * sizeof(T)));
+
         MATRIX<T> matrix(matrixA.size(), std::vector<T>(matrixA[0].size(), T{0}));
         if (operation.value() == "sub") {
             for (std::size_t i = 0; i < matrixA.size(); ++i)
@@ -85,6 +94,9 @@ namespace algebra {
         if (matrix.size() == 0)
             return MATRIX<T>{};
 
+        ALGEBRA_PROFILE_SCOPE("multiply_scalar", matrix.size(), matrix[0].size(), static_cast<double>(matrix.size() * matrix[0].size()),
+                              static_cast<double>(2 * matrix.size() * matrix[0].size() * sizeof(T)));
+
         MATRIX<T> result(matrix.size(), std::vector<T>(matrix[0].size(), T{0}));
         for (std::size_t i = 0; i < matrix.size(); ++i)
             for (std::size_t j = 0; j < matrix[0].size(); ++j)
@@ -98,6 +110,10 @@ namespace algebra {
         if (matrixA.size() == 0 || matrixB.size() == 0 || matrixA[0].size() != matrixB.size())
             throw std::invalid_argument("The number of A's columns and B's rows must be equal.");
 
+        ALGEBRA_PROFILE_SCOPE("multiply", matrixA.size(), matrixB[0].size(), 2.0 * matrixA.size() * matrixB[0].size() * matrixB.size(),
+                              static_cast<double>((matrixA.size() * matrixB.size() + matrixB.size() * matrixB[0].size() +
+                                                   matrixA.size() * matrixB[0].size()) * sizeof(T)));
+
         MATRIX<T> result(matrixA.size(), std::vector<T>(matrixB[0].size(), T{0}));
         for (std::size_t i = 0; i < matrixA.size(); ++i)
             for (std::size_t j = 0; j < matrixB[0].size(); ++j)
@@ -115,6 +131,9 @@ namespace algebra {
         if (matrixA.size() != matrixB.size() || matrixA[0].size() != matrixB[0].size())
             throw std::invalid_argument("The number of rows and columns must be equal.");
 
+        ALGEBRA_PROFILE_SCOPE("hadamard_product", matrixA.size(), matrixA[0].size(), static_cast<double>(matrixA.size() * matrixA[0].size()),
+                              static_cast<double>(3 * matrixA.size() * matrixA[0].size() * sizeof(T)));
+
         MATRIX<T> matrix(matrixA.size(), std::vector<T>(matrixA[0].size(), T{0}));
         for (std::size_t i = 0; i < matrix.size(); ++i)
             for (std::size_t j = 0; j < matrix[0].size(); ++j)
@@ -128,6 +147,9 @@ namespace algebra {
         if (matrix.size() == 0)
             return MATRIX<T>{};
 
+        ALGEBRA_PROFILE_SCOPE("transpose", matrix.size(), matrix[0].size(), 0.0,
+                              static_cast<double>(2 * matrix.size() * matrix[0].size() * sizeof(T)));
+
         MATRIX<T> result(matrix[0].size(), std::vector<T>(matrix.size(), T{0}));
 
         for (std::size_t i = 0; i < matrix.size(); ++i)
@@ -142,6 +164,9 @@ namespace algebra {
         if (matrix.size() == 0 || matrix.size() != matrix[0].size())
             throw std::invalid_argument("The number of rows and columns must be equal.");
 
+        ALGEBRA_PROFILE_SCOPE("trace", matrix.size(), matrix.size(), static_cast<double>(matrix.size()),
+                              static_cast<double>(matrix.size() * sizeof(T)));
+
         T result{};
         for (std::size_t i = 0; i < matrix.size(); ++i)
             result += matrix[i][i];
@@ -149,10 +174,14 @@ namespace algebra {
         return result;
     };
 
-    template<typename T>
-    double determinant(const MATRIX<T>& matrix) {
-        if (matrix.size() == 0 || matrix.size() != matrix[0].size())
-            throw std::invalid_argument("The number of rows and columns must be equal.");
+    // Cofactor expansion over any row-indexable matrix, every minor is bump-allocated
+    // in the thread arena and released as soon as its term has been accumulated
+    template<typename Matrix>
+    double cofactor_determinant(const Matrix& matrix) {
+        using T = typename Matrix::value_type::value_type;
+
+        if (matrix.size() == 0)
+            return 1.0;
 
         if (matrix.size() == 1)
             return static_cast<double>(matrix[0][0]);
@@ -163,7 +192,8 @@ namespace algebra {
         double result = 0.0;
         int flag = 1;
         for (std::size_t i = 0; i < matrix.size(); ++i) {
-            MATRIX<T> t(matrix.size() - 1, std::vector<T>(matrix[0].size() - 1, T{0}));
+            ArenaScope scope;
+            auto t = make_pmr_matrix<T>(matrix.size() - 1, matrix.size() - 1, scope.resource());
             for (std::size_t k = 1; k < matrix.size(); ++k)
                 for (std::size_t j = 0, v = 0; j < matrix.size(); ++j) {
                     if (j == i)
@@ -173,7 +203,7 @@ namespace algebra {
                     ++v;
                 }
 
-            result += flag * static_cast<double>(matrix[0][i]) * determinant(t);
+            result += flag * static_cast<double>(matrix[0][i]) * cofactor_determinant(t);
             flag *= -1;
         }
 
@@ -181,33 +211,37 @@ namespace algebra {
     };
 
     template<typename T>
-    MATRIX<double> inverse(const MATRIX<T>& matrix) {
+    double determinant(const MATRIX<T>& matrix) {
         if (matrix.size() == 0 || matrix.size() != matrix[0].size())
             throw std::invalid_argument("The number of rows and columns must be equal.");
 
-        double eps = 1e-5;
-        double det = determinant(matrix);
-        if (fabs(det) < eps)
-            throw std::invalid_argument("The matrix is not invertible.");
+        ALGEBRA_PROFILE_SCOPE("determinant", matrix.size(), matrix.size(), cofactor_flops(matrix.size()),
+                              static_cast<double>(matrix.size() * matrix.size() * sizeof(T)));
 
-        MATRIX<double> result(matrix.size(), std::vector<T>(matrix.size(), T{0}));
-        MATRIX<double> t(matrix.size() - 1, std::vector<T>(matrix.size() - 1, T{0}));
-        for (std::size_t i = 0; i < matrix.size(); ++i) {
-            for (std::size_t j = 0; j < matrix[0].size(); ++j) {
+        return cofactor_determinant(matrix);
+    };
 
-                for (std::size_t ii = 0, row = 0; ii < matrix.size(); ++ii) {
-                    if (ii == i) continue;
-                    for (std::size_t jj = 0, col = 0; jj < matrix.size(); ++jj) {
-                        if (jj == j) continue;
+    template<typename T>
+    MATRIX<double> inverse(const MATRIX<T>& matrix) {
+        if (matrix.size() == 0 || matrix.size() != matrix[0].size())
+            throw std::invalid_argument("The number of rows and columns must be equal.");
 
-                        t[row][col] = matrix[ii][jj];
-                        ++col;
-                    }
-                    ++row;
-                }
+        ALGEBRA_PROFILE_SCOPE("inverse", matrix.size(), matrix.size(), 8.0 * matrix.size() * matrix.size() * matrix.size() / 3.0,
+                              static_cast<double>(matrix.size() * matrix.size() * (sizeof(T) + sizeof(double))));
 
-                result[j][i] = pow(-1, i + j) * determinant(t) / det;
-            }
+        // 用条件数而不是行列式判断可逆性, 缩放不会改变结论
+        auto factors = lu_decompose<double>(matrix);
+        if (rcond_estimate(factors) < std::numeric_limits<double>::epsilon())
+            throw std::invalid_argument("The matrix is not invertible.");
+
+        MATRIX<double> result(matrix.size(), std::vector<double>(matrix.size(), 0.0));
+        std::vector<double> e(matrix.size(), 0.0);
+        for (std::size_t j = 0; j < matrix.size(); ++j) {
+            e[j] = 1.0;
+            auto column = lu_solve(factors, e);
+            for (std::size_t i = 0; i < matrix.size(); ++i)
+                result[i][j] = column[i];
+            e[j] = 0.0;
         }
 
         return result;
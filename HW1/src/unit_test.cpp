@@ -1,9 +1,16 @@
 #include "algebra.h"
+#include "algebra_arena.h"
+#include "algebra_cache.h"
+#include "algebra_krylov.h"
+#include "algebra_profile.h"
+#include "algebra_solve.h"
 
 #include <cmath>
 #include <gtest/gtest.h>
 #include <iostream>
 #include <limits>
+#include <sstream>
+#include <type_traits>
 
 using namespace algebra;
 
@@ -508,3 +515,252 @@ TEST(AutAp2024SpringHW1, inverse_EmptyMatrix) {
 	EXPECT_ANY_THROW(inverse(mat))
 		<< "Inverse calculation should throw an error for an empty matrix.";
 }
+
+// "============================================="
+// "                  arena Tests                "
+// "============================================="
+
+// Test that a recursive determinant serves its minors from the thread arena
+TEST(AutAp2024SpringHW1, arena_DeterminantUsesArena) {
+	MATRIX<double> mat = {{2, 0, 1, 3}, {1, 1, 0, 2}, {0, 3, 1, 1}, {4, 1, 2, 0}};
+
+	thread_arena().reset_stats();
+	auto result = determinant(mat);
+	EXPECT_NEAR(result, -32.0, 1e-9)
+		<< "Determinant through the arena should be unchanged.";
+	EXPECT_GT(arena_stats().allocations, 0u)
+		<< "Minors should be allocated from the arena.";
+	EXPECT_GT(arena_stats().avoided(), 0u)
+		<< "Most minors should not reach the heap.";
+}
+
+// Test that rewinding a scope makes the memory reusable
+TEST(AutAp2024SpringHW1, arena_ScopeReleasesInOneShot) {
+	ArenaResource arena(1024);
+	const void* first = nullptr;
+	{
+		ArenaScope scope(arena);
+		auto m = make_pmr_matrix<int>(4, 4, scope.resource());
+		first = m[3].data();
+	}
+	ArenaStats once = arena.get_stats();
+	EXPECT_EQ(once.releases, 1u);
+	{
+		ArenaScope scope(arena);
+		auto m = make_pmr_matrix<int>(4, 4, scope.resource());
+		EXPECT_EQ(m[3].data(), first)
+			<< "The second scope should be handed the bytes the first one released.";
+	}
+	EXPECT_EQ(arena.get_stats().allocations, 2 * once.allocations);
+	EXPECT_EQ(arena.get_stats().bytes, 2 * once.bytes);
+	EXPECT_EQ(arena.get_stats().chunks, 1u)
+		<< "The second scope should reuse the first chunk.";
+	EXPECT_EQ(arena.get_stats().releases, 2u);
+}
+
+// "============================================="
+// "                  cache Tests                "
+// "============================================="
+
+// Test that the content hash depends on values and shape
+TEST(AutAp2024SpringHW1, cache_ContentHash) {
+	MATRIX<double> a = {{1, 2}, {3, 4}};
+	MATRIX<double> b = {{1, 2}, {3, 4}};
+	MATRIX<double> c = {{1, 2, 3, 4}};
+
+	EXPECT_EQ(content_hash(a), content_hash(b));
+	EXPECT_NE(content_hash(a), content_hash(c));
+}
+
+// Test hit/miss accounting of memoized inverse and determinant
+TEST(AutAp2024SpringHW1, cache_MemoizesResults) {
+	ResultCache<double> cache(32);
+	MATRIX<double> mat = {{4, 7}, {2, 6}};
+
+	auto first = cache.inverse(mat);
+	auto second = cache.inverse(mat);
+	EXPECT_EQ(first, second);
+	EXPECT_NEAR(cache.determinant(mat), 10.0, 1e-9);
+
+	auto stats = cache.get_stats();
+	EXPECT_EQ(stats.hits, 1u);
+	EXPECT_EQ(stats.misses, 2u);
+	EXPECT_EQ(cache.size(), 1u) << "Both results should share one entry.";
+}
+
+// Test that the cache never grows past its capacity
+TEST(AutAp2024SpringHW1, cache_EvictsLeastRecentlyUsed) {
+	ResultCache<double, 1> cache(2);
+	for (int i = 1; i <= 3; ++i)
+		cache.determinant(MATRIX<double>{{static_cast<double>(i)}});
+
+	EXPECT_EQ(cache.size(), 2u);
+	EXPECT_EQ(cache.get_stats().evictions, 1u);
+	cache.determinant(MATRIX<double>{{3.0}});
+	EXPECT_EQ(cache.get_stats().hits, 1u) << "The newest entry should survive.";
+
+	// Fewer entries than shards, or a remainder, must not round the capacity up
+	for (std::size_t capacity : {3u, 20u}) {
+		ResultCache<double> small(capacity);
+		for (int i = 1; i <= 100; ++i)
+			small.determinant(MATRIX<double>{{static_cast<double>(i)}});
+		EXPECT_LE(small.size(), capacity);
+	}
+}
+
+// "============================================="
+// "                 profile Tests               "
+// "============================================="
+
+// Test that the profiler accumulates calls, FLOPs and bytes per operation
+TEST(AutAp2024SpringHW1, profile_RecordsOperations) {
+	Profiler::instance().reset();
+	{
+		OpScope scope("multiply", 2, 2, 16.0, 96.0);
+	}
+	{
+		OpScope scope("multiply", 3, 3, 54.0, 216.0);
+	}
+
+	auto stats = Profiler::instance().get_stats();
+	ASSERT_TRUE(stats.contains("multiply"));
+	EXPECT_EQ(stats["multiply"].calls, 2u);
+	EXPECT_EQ(stats["multiply"].max_rows, 3u);
+	EXPECT_DOUBLE_EQ(stats["multiply"].flops, 70.0);
+	EXPECT_DOUBLE_EQ(stats["multiply"].bytes, 312.0);
+
+	std::ostringstream os;
+	Profiler::instance().dump_chrome_trace(os);
+	EXPECT_NE(os.str().find("traceEvents"), std::string::npos);
+	Profiler::instance().reset();
+}
+
+// Test that an algebra call goes through its hook, which only exists in profiling builds
+TEST(AutAp2024SpringHW1, profile_RecordsAlgebraCalls) {
+	Profiler::instance().reset();
+	MATRIX<double> matrixA = {{1, 2, 3}, {4, 5, 6}};
+	MATRIX<double> matrixB = {{1, 2}, {3, 4}, {5, 6}};
+	multiply(matrixA, matrixB);
+
+	auto stats = Profiler::instance().get_stats();
+#ifdef ALGEBRA_PROFILE
+	ASSERT_TRUE(stats.contains("multiply"));
+	EXPECT_EQ(stats["multiply"].calls, 1u);
+	EXPECT_EQ(stats["multiply"].max_rows, 2u);
+	EXPECT_DOUBLE_EQ(stats["multiply"].flops, 24.0);
+#else
+	EXPECT_FALSE(stats.contains("multiply")) << "Without ALGEBRA_PROFILE the hooks compile to nothing.";
+#endif
+	Profiler::instance().reset();
+}
+
+// "============================================="
+// "                  solve Tests                "
+// "============================================="
+
+// Test that a scaled but well-conditioned matrix is invertible
+TEST(AutAp2024SpringHW1, solve_InverseOfScaledMatrix) {
+	MATRIX<double> mat = {{1e-4, 0, 0}, {0, 2e-4, 0}, {0, 0, 4e-4}};
+
+	EXPECT_NEAR(condition_number(mat), 4.0, 1e-9);
+	auto result = inverse(mat);
+	EXPECT_NEAR(result[0][0], 1e4, 1e-6);
+	EXPECT_NEAR(result[2][2], 2.5e3, 1e-6);
+}
+
+// Test that the condition estimate flags a nearly singular matrix
+TEST(AutAp2024SpringHW1, solve_ConditionOfIllConditionedMatrix) {
+	MATRIX<double> mat = {{1, 1}, {1, 1 + 1e-12}};
+
+	EXPECT_GT(condition_number(mat), 1e11);
+	EXPECT_TRUE(std::isinf(condition_number(MATRIX<double>{{1, 2}, {2, 4}})));
+}
+
+// Test that mixed-precision refinement reaches double accuracy
+TEST(AutAp2024SpringHW1, solve_IterativeRefinement) {
+	MATRIX<double> mat = {{4, -1, 0, 0.5}, {-1, 4, -1, 0}, {0, -1, 4, -1}, {0.5, 0, -1, 3}};
+	std::vector<double> expected = {0.1, 1.0 / 3.0, -2.5, 1e3};
+	std::vector<double> b(4, 0.0);
+	for (size_t i = 0; i < 4; ++i)
+		for (size_t j = 0; j < 4; ++j)
+			b[i] += mat[i][j] * expected[j];
+
+	auto x = solve(mat, b);
+	for (size_t i = 0; i < 4; ++i)
+		EXPECT_NEAR(x[i], expected[i], 1e-12 * std::fabs(expected[i]) + 1e-14)
+			<< "Refined solution is not double accurate at index " << i << ".";
+}
+
+// "============================================="
+// "                 krylov Tests                "
+// "============================================="
+
+// 1D Laplacian with a shifted diagonal, symmetric positive definite
+static MATRIX<double> laplacian(size_t n) {
+	MATRIX<double> mat(n, std::vector<double>(n, 0.0));
+	for (size_t i = 0; i < n; ++i) {
+		mat[i][i] = 2.0 + static_cast<double>(i) / n;
+		if (i > 0) mat[i][i - 1] = -1.0;
+		if (i + 1 < n) mat[i][i + 1] = -1.0;
+	}
+	return mat;
+}
+
+// Test CG on dense and sparse operators with per-iteration telemetry
+TEST(AutAp2024SpringHW1, krylov_ConjugateGradient) {
+	auto mat = laplacian(60);
+	std::vector<double> b(60, 1.0);
+	DenseOperator<double> dense(mat);
+	auto sparse = SparseOperator::from_dense(mat);
+	EXPECT_EQ(sparse.non_zeros(), 60u * 3 - 2);
+
+	size_t calls = 0;
+	KrylovOptions options;
+	options.monitor = [&](size_t, double) { ++calls; };
+	auto result = conjugate_gradient(sparse, b, options);
+	ASSERT_TRUE(result.converged);
+	EXPECT_EQ(calls, result.iterations);
+	EXPECT_EQ(result.residuals.size(), result.iterations + 1);
+
+	options.jacobi = true;
+	auto preconditioned = conjugate_gradient(dense, b, options);
+	ASSERT_TRUE(preconditioned.converged);
+
+	std::vector<double> ax;
+	dense.apply(result.x, ax);
+	for (size_t i = 0; i < b.size(); ++i) {
+		EXPECT_NEAR(ax[i], b[i], 1e-8);
+		EXPECT_NEAR(result.x[i], preconditioned.x[i], 1e-8);
+	}
+}
+
+// Test restarted GMRES on a non-symmetric system
+TEST(AutAp2024SpringHW1, krylov_RestartedGmres) {
+	MATRIX<double> mat = {{4, 1, 0, 0}, {2, 5, 1, 0}, {0, 3, 6, 1}, {0, 0, 1, 7}};
+	std::vector<double> b = {1, 2, 3, 4};
+	DenseOperator<double> op(mat);
+
+	KrylovOptions options;
+	options.restart = 2;
+	options.jacobi = true;
+	auto result = gmres(op, b, options);
+	ASSERT_TRUE(result.converged);
+
+	auto expected = solve(mat, b);
+	for (size_t i = 0; i < b.size(); ++i)
+		EXPECT_NEAR(result.x[i], expected[i], 1e-8);
+}
+
+// Test that GMRES stops instead of dividing by zero when the Krylov space hits the null space
+TEST(AutAp2024SpringHW1, krylov_GmresSingularBreakdown) {
+	MATRIX<double> mat = {{0, 1}, {0, 0}};
+	std::vector<double> b = {1, 0};
+	DenseOperator<double> op(mat);
+
+	auto result = gmres(op, b);
+	EXPECT_FALSE(result.converged);
+	EXPECT_EQ(result.iterations, 1u);
+	for (double elem : result.x)
+		EXPECT_TRUE(std::isfinite(elem));
+	static_assert(!std::is_constructible_v<DenseOperator<double>, MATRIX<double>&&>);
+}
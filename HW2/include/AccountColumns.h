@@ -0,0 +1,156 @@
+#ifndef ACCOUNT_COLUMNS_H // Prevents double inclusion of this header
+#define ACCOUNT_COLUMNS_H
+
+#include "Money.h"
+
+#include <array>         // For std::array
+#include <atomic>        // For std::atomic
+#include <cstdint>       // For std::int64_t, std::uint8_t, std::uint32_t, std::uint64_t
+#include <memory>        // For std::shared_ptr
+#include <mutex>         // For std::mutex
+#include <shared_mutex>  // For std::shared_mutex
+#include <unordered_map> // For std::unordered_map
+#include <vector>        // For std::vector
+
+class Account; // Forward declaration of Account
+
+struct StatusCounts {
+    size_t active{0};
+    size_t inactive{0};
+};
+
+struct AccountRow {
+    std::uint64_t account_number;
+    std::uint32_t owner;
+    Money balance;
+    bool status;
+    const Account* account; // may be gone by the time an old View is read
+};
+
+struct CustomerLoan {
+    std::uint32_t owner; // owner id, as in AccountRow
+    Money paid;
+    Money unpaid;
+};
+
+// The Bank's loan maps and totals as of one moment, shared by the Views taken until they change
+struct LoanBook {
+    std::vector<CustomerLoan> customers; // sorted by owner
+    Money total_balance;
+    Money total_loan;
+};
+
+// Balance, status, owner id and number of every account in parallel arrays, one row per account.
+// A report over one field reads one dense array front to back instead of visiting each
+// Account through a pointer, and its loop vectorizes. Rows are removed by moving the
+// last row into the hole, so row order means nothing.
+//
+// The rows are spread over SHARDS shards that are copied on write: a View shares the
+// shards as they were when it was taken, and the first change to a shard after a View
+// was taken copies that shard first, so nothing a View holds is ever written again.
+// A report on a View sees one point in time and needs no lock, writers pay one copy
+// per shard they touch after each View: O(accounts / SHARDS) rows for that shard, and
+// O(accounts) at most between two Views however many writes there are.
+class AccountColumns {
+public:
+    // A power of two
+    static constexpr size_t SHARDS = 64;
+
+private:
+    struct Shard {
+        std::vector<std::int64_t> balances; // minor units
+        std::vector<std::uint8_t> statuses;
+        std::vector<std::uint32_t> owners;
+        std::vector<std::uint64_t> numbers;
+        std::vector<const Account*> accounts;
+    };
+
+public:
+    // Immutable point-in-time copy, cheap to take and safe to read from any thread
+    class View {
+    public:
+        Money sum() const;
+        StatusCounts count_by_status() const;
+        // buckets[i] counts balances in [i * width, (i + 1) * width), the last bucket takes everything above
+        std::vector<size_t> histogram(Money width, size_t buckets) const;
+        size_t size() const;
+        // nullptr when the loans were not set, or changed since, when the View was taken
+        const LoanBook* loans() const;
+
+        template <typename F>
+        void for_each(F&& visit) const;
+
+    private:
+        friend class AccountColumns;
+        std::array<std::shared_ptr<const Shard>, SHARDS> shards;
+        std::shared_ptr<const LoanBook> loan_book;
+    };
+
+    AccountColumns();
+
+    // Appends a row with the account's current number, balance and status
+    void insert(const Account* account, std::uint32_t owner);
+    // Only the address is used, the account may be gone already
+    bool erase(const Account* account);
+    size_t erase_owner(std::uint32_t owner);
+    void clear();
+
+    // Unknown accounts are ignored. add_balance, move_balance and view() may run concurrently
+    // with each other and with readers of Views, everything else needs the columns to themselves.
+    void add_balance(const Account* account, Money amount);
+    // Both sides of a transfer at once, no View sees one without the other
+    void move_balance(const Account* source, const Account* destination, Money amount);
+    void set_owner(const Account* account, std::uint32_t owner);
+    void set_status(const Account* account, bool status);
+    // Loans are copied whole rather than per shard, they change far less often than balances.
+    // Whoever changes them resets the book to nullptr, and sets a fresh one before the next View.
+    void set_loans(std::shared_ptr<const LoanBook> loans);
+    bool has_loans() const;
+
+    // Waits only for the balance updates in flight
+    View view();
+    // Likewise, and when no loans are set `make_loans()` builds them first. It runs while
+    // balance updates are held off, and one at a time.
+    template <typename F>
+    View view(F&& make_loans);
+    size_t size() const;
+
+private:
+    struct Slot {
+        std::mutex mutex; // held by add_balance while it writes the shard
+        std::shared_ptr<Shard> shard;
+        std::uint64_t epoch{0}; // views_taken when the shard was last copied
+    };
+
+    static size_t shard_of(const Account* account);
+    // The shard of `slot`, copied first when a View may share it
+    Shard& writable(Slot& slot);
+    void erase_row(size_t shard, std::uint32_t row);
+    void add_balance_locked(const Account* account, Money amount);
+    // The caller holds views_mutex exclusively
+    View view_locked();
+
+    std::array<Slot, SHARDS> slots;
+    std::unordered_map<const Account*, std::uint32_t> rows; // row within the account's shard
+    std::shared_ptr<const LoanBook> loan_book;
+    std::shared_mutex views_mutex; // shared: balance updates, exclusive: taking a View
+    std::atomic<std::uint64_t> views_taken{0};
+};
+
+template <typename F>
+AccountColumns::View AccountColumns::view(F&& make_loans) {
+    std::unique_lock lock(views_mutex);
+    if (!loan_book)
+        loan_book = make_loans();
+    return view_locked();
+}
+
+template <typename F>
+void AccountColumns::View::for_each(F&& visit) const {
+    for (const auto& shard : shards)
+        for (size_t row = 0; row < shard->numbers.size(); ++row)
+            visit(AccountRow{shard->numbers[row], shard->owners[row], Money(shard->balances[row]), shard->statuses[row] != 0,
+                             shard->accounts[row]});
+}
+
+#endif // ACCOUNT_COLUMNS_H
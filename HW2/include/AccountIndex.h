@@ -0,0 +1,59 @@
+#ifndef ACCOUNT_INDEX_H // Prevents double inclusion of this header
+#define ACCOUNT_INDEX_H
+
+#include <cstdint>     // For std::uint64_t
+#include <optional>    // For std::optional
+#include <string_view>   // For std::string_view
+#include <unordered_map> // For std::unordered_map
+#include <vector>        // For std::vector
+
+class Account; // Forward declaration of Account
+class Person; // Forward declaration of Person
+
+// Open-addressing hash table from account number to account.
+// A 16-digit account number fits a 64-bit integer, keys are kept inline in one
+// flat array probed linearly, so a lookup is one hash and usually one cache line.
+// Erase shifts the following entries back instead of leaving tombstones.
+class AccountIndex {
+public:
+    AccountIndex();
+
+    // Parses a 16-digit account number, std::nullopt for anything else
+    static std::optional<std::uint64_t> parse(std::string_view account_number);
+
+    // A number no indexed account holds, drawn again on a repeat. A restored number
+    // (RestoredAccountNumber) is never redrawn, it throws when already held.
+    std::uint64_t draw_unused() const;
+
+    // Indexes `account` under its number, replacing whatever was there
+    void insert(Account* account);
+    bool erase(std::uint64_t account_number);
+    // Drops every account currently owned by `owner`, a scan of the whole table
+    size_t erase_owned_by(const Person* owner);
+    // Numbers of the accounts owned by `owner`, also a full scan
+    std::vector<std::uint64_t> owned_by(const Person* owner) const;
+    Account* find(std::uint64_t account_number) const;
+    // The number `account` is indexed under, std::nullopt when it isn't indexed.
+    // Only the address is used, so it's safe to ask about an account that may be gone.
+    std::optional<std::uint64_t> number_of(const Account* account) const;
+
+    size_t size() const;
+    size_t capacity() const;
+    void clear();
+
+private:
+    struct Slot {
+        std::uint64_t key;
+        Account* account; // nullptr marks an empty slot
+    };
+
+    size_t home(std::uint64_t key) const;
+    void grow();
+    void erase_slot(size_t slot);
+
+    std::vector<Slot> slots;
+    size_t count{0};
+    std::unordered_map<const Account*, std::uint64_t> numbers; // the other way round
+};
+
+#endif // ACCOUNT_INDEX_H
@@ -0,0 +1,51 @@
+#ifndef ACCOUNT_NUMBERS_H // Prevents double inclusion of this header
+#define ACCOUNT_NUMBERS_H
+
+#include <cstdint>     // For std::uint64_t
+#include <optional>    // For std::optional
+#include <string>      // For std::string
+#include <string_view> // For std::string_view
+
+// Account numbers and CVV2s are drawn from a generator owned by the calling thread,
+// seeded once from std::random_device, so creating an account makes no syscalls.
+// A 16-digit number is a single draw below 10^16.
+
+// Draws a 16-digit account number, the last digit a Luhn check digit when enabled
+std::uint64_t draw_account_number();
+// Zero-padded to 16 digits
+std::string format_account_number(std::uint64_t account_number);
+// Four digits, zero-padded
+std::string draw_CVV2();
+
+// Process-wide switch, off by default
+void set_luhn_account_numbers(bool enabled);
+bool get_luhn_account_numbers();
+// True when the last digit of `number` is the Luhn check digit of the others
+bool luhn_valid(std::string_view number);
+
+// While the scope lives, the next account created on this thread takes `account_number`
+// and `CVV2` instead of fresh draws, so a recovered account keeps the card it had.
+// Scopes nest, each draw takes its value from the innermost scope still holding one.
+class RestoredAccountNumber {
+public:
+    RestoredAccountNumber(std::uint64_t account_number, std::string CVV2);
+    // Only the number, the CVV2 comes from an enclosing scope or a fresh draw
+    explicit RestoredAccountNumber(std::uint64_t account_number);
+    ~RestoredAccountNumber();
+
+    // True when the next draw_account_number() on this thread returns a restored number
+    static bool pending();
+
+    RestoredAccountNumber(const RestoredAccountNumber&) = delete;
+    RestoredAccountNumber& operator=(const RestoredAccountNumber&) = delete;
+
+private:
+    friend std::uint64_t draw_account_number();
+    friend std::string draw_CVV2();
+
+    std::optional<std::uint64_t> account_number; // emptied once an account took it
+    std::optional<std::string> CVV2;
+    RestoredAccountNumber* previous;
+};
+
+#endif // ACCOUNT_NUMBERS_H
@@ -0,0 +1,107 @@
+#ifndef BANK_CLUSTER_H // Prevents double inclusion of this header
+#define BANK_CLUSTER_H
+
+#include "Bank.h"
+#include "CommitStage.h"
+#include "ConcurrentBank.h"
+#include "Money.h"
+
+#include <atomic>        // For std::atomic
+#include <cstdint>       // For std::uint64_t
+#include <memory>        // For std::unique_ptr
+#include <mutex>         // For std::mutex
+#include <shared_mutex>  // For std::shared_mutex
+#include <string>        // For std::string
+#include <unordered_map> // For std::unordered_map
+#include <vector>        // For std::vector
+
+class Account; // Forward declaration of Account
+class Person; // Forward declaration of Person
+
+struct ClusterStats {
+    std::uint64_t local_transfers{0}; // both accounts on one shard, a plain ConcurrentBank::transfer
+    std::uint64_t committed{0};       // cross-shard transfers
+    std::uint64_t aborted{0};         // cross-shard transfers undone after the source was debited
+};
+
+// Customers spread over several Banks, each behind its own ConcurrentBank. A customer lives
+// on the shard their hashed fingerprint picks, with all their accounts.
+// A transfer between shards is a two-phase commit run by the calling thread:
+// - prepare on the source shard checks the card and debits the amount into escrow;
+// - prepare on the destination shard makes sure the account is there and active;
+// - commit credits the destination, abort gives the escrow back to the source.
+// The destination is checked again as it is credited, under the same lock: one blocked since
+// prepare refuses the commit and the source is aborted. Both accounts stay pinned from prepare
+// to commit or abort, delete_account refuses them. Escrow moves on the bank's behalf, through
+// ConcurrentBank::credit and refund with the bank fingerprint the cluster was made with.
+// No lock is held across shards, so money in escrow is counted by in_flight() meanwhile.
+// A committed cross-shard transfer goes to the commit stage of the source shard, like a local one.
+class BankCluster {
+public:
+    BankCluster(size_t shards, const std::string& bank_name, const std::string& bank_fingerprint);
+
+    BankCluster(const BankCluster&) = delete;
+    BankCluster& operator=(const BankCluster&) = delete;
+
+    size_t shard_count() const;
+    size_t shard_of(const Person& customer) const;
+    // Throws std::invalid_argument for an account that wasn't created through the cluster
+    size_t shard_of(const Account& account);
+    ConcurrentBank& shard(size_t index);
+
+    Account* create_account(Person& owner, const std::string& owner_fingerprint, const std::string& password);
+    bool delete_account(Account& account, const std::string& owner_fingerprint);
+    bool deposit(Account& account, const std::string& owner_fingerprint, double amount);
+    bool withdraw(Account& account, const std::string& owner_fingerprint, double amount);
+    bool transfer(Account& source, Account& destination, const std::string& owner_fingerprint,
+                  const std::string& CVV2, const std::string& password, const std::string& exp_date, double amount);
+
+    // Attaches `stage` to every shard, see ConcurrentBank::set_commit_stage. It then sees every
+    // committed transfer of the cluster, within a shard or across two, once.
+    void set_commit_stage(CommitStage* stage);
+
+    // Sum over the shards plus what is in escrow. Transfers don't change it, though with
+    // transfers running it's read piece by piece and can be off by the ones in progress.
+    Money total_balance();
+    Money in_flight() const;
+    ClusterStats stats() const;
+
+private:
+    // The participant side of a shard: its transfers between prepare and commit or abort
+    struct Prepared {
+        Account* account;
+        Money amount;
+        bool debit; // source side, abort refunds it
+    };
+
+    struct Shard {
+        Shard(const std::string& bank_name, const std::string& bank_fingerprint);
+
+        Bank bank;
+        ConcurrentBank front;
+        std::mutex mutex; // prepared and pins, held by delete_account too
+        std::unordered_map<std::uint64_t, Prepared> prepared;
+        std::unordered_map<const Account*, size_t> pins;
+    };
+
+    void prepare_debit(Shard& shard, std::uint64_t transaction, Account& source, const std::string& owner_fingerprint,
+                       const std::string& CVV2, const std::string& password, const std::string& exp_date, Money amount);
+    bool prepare_credit(Shard& shard, std::uint64_t transaction, Account& destination, Money amount);
+    // False when the destination refuses the credit, its side is dropped and the caller aborts
+    bool commit(Shard& shard, std::uint64_t transaction);
+    void abort(Shard& shard, std::uint64_t transaction);
+    // Drops `account`'s pin on `shard`, the caller holds shard.mutex
+    static void unpin(Shard& shard, const Account* account);
+
+    std::string bank_fingerprint;
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::shared_mutex homes_mutex;
+    std::unordered_map<const Account*, size_t> homes; // shard of every account
+    std::atomic<std::uint64_t> next_transaction{1};
+    std::atomic<std::int64_t> escrow{0}; // minor units
+    std::atomic<std::uint64_t> local_transfers{0};
+    std::atomic<std::uint64_t> committed{0};
+    std::atomic<std::uint64_t> aborted{0};
+};
+
+#endif // BANK_CLUSTER_H
@@ -0,0 +1,52 @@
+#ifndef BATCH_H // Prevents double inclusion of this header
+#define BATCH_H
+
+#include <chrono>  // For std::chrono::nanoseconds
+#include <string>  // For std::string
+#include <vector>  // For std::vector
+
+class Account; // Forward declaration of Account
+
+enum class BatchOperationType {
+    Deposit,
+    Withdraw,
+    Transfer,
+};
+
+// One operation of a ConcurrentBank::submit batch, with the same arguments as the single call
+struct BatchOperation {
+    BatchOperationType type;
+    Account* account;              // the source of a transfer
+    Account* destination{nullptr}; // transfers only
+    std::string owner_fingerprint;
+    double amount{0.0};
+    std::string CVV2{};            // transfers only
+    std::string password{};        // transfers only
+    std::string exp_date{};        // transfers only
+};
+
+enum class BatchMode {
+    Atomic,       // every operation is applied or none is
+    PerOperation, // each operation succeeds or fails on its own
+};
+
+enum class BatchStatus {
+    Applied,
+    BadCredentials,
+    InsufficientFunds,
+    BadDestination, // blocked, or not in the account index
+    Aborted, // valid, but another operation of an atomic batch failed
+};
+
+struct BatchResult {
+    std::vector<BatchStatus> statuses; // in submission order
+    size_t applied{0};
+    size_t failed{0};
+    std::chrono::nanoseconds elapsed{0};
+
+    double ops_per_second() const {
+        return elapsed.count() > 0 ? static_cast<double>(statuses.size()) * 1e9 / static_cast<double>(elapsed.count()) : 0.0;
+    }
+};
+
+#endif // BATCH_H
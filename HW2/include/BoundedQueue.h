@@ -0,0 +1,85 @@
+#ifndef BOUNDED_QUEUE_H // Prevents double inclusion of this header
+#define BOUNDED_QUEUE_H
+
+#include <algorithm> // For std::max
+#include <atomic>    // For std::atomic
+#include <bit>       // For std::bit_ceil
+#include <cstddef>   // For std::size_t, std::ptrdiff_t
+#include <memory>    // For std::unique_ptr
+
+// Fixed-size lock-free queue for any number of producers and consumers.
+// Every cell carries a sequence number telling whose turn it is, so a push or pop
+// is one compare-and-swap on the tail or head plus a store to the cell, and a full
+// queue turns a push down instead of making the producer wait.
+template <typename T>
+class BoundedQueue {
+public:
+    // `capacity` is rounded up to a power of two
+    explicit BoundedQueue(std::size_t capacity) :
+        cells(std::make_unique<Cell[]>(std::bit_ceil(std::max<std::size_t>(capacity, 2)))),
+        mask(std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1) {
+        for (std::size_t i = 0; i <= mask; ++i)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    // false when the queue is full
+    bool try_push(const T& value) {
+        std::size_t position = tail.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells[position & mask];
+            auto turn = static_cast<std::ptrdiff_t>(cell.sequence.load(std::memory_order_acquire)) -
+                        static_cast<std::ptrdiff_t>(position);
+            if (turn == 0) {
+                if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    cell.value = value;
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (turn < 0) {
+                return false;
+            } else {
+                position = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // false when the queue is empty
+    bool try_pop(T& value) {
+        std::size_t position = head.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells[position & mask];
+            auto turn = static_cast<std::ptrdiff_t>(cell.sequence.load(std::memory_order_acquire)) -
+                        static_cast<std::ptrdiff_t>(position + 1);
+            if (turn == 0) {
+                if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    value = cell.value;
+                    cell.sequence.store(position + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (turn < 0) {
+                return false;
+            } else {
+                position = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    std::size_t capacity() const { return mask + 1; }
+
+private:
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    std::size_t mask;
+    // Producers and consumers each hammer their own end, one cache line apart
+    alignas(64) std::atomic<std::size_t> tail{0};
+    alignas(64) std::atomic<std::size_t> head{0};
+};
+
+#endif // BOUNDED_QUEUE_H
@@ -0,0 +1,25 @@
+#ifndef COMMIT_STAGE_H // Prevents double inclusion of this header
+#define COMMIT_STAGE_H
+
+#include "Money.h"
+
+#include <cstdint> // For std::uint64_t
+
+// A transfer that went through, accounts named by account number
+struct TransferEvent {
+    std::uint64_t source;
+    std::uint64_t destination;
+    Money amount;
+};
+
+// Something that wants to see every transfer once it has committed, attached with
+// ConcurrentBank::set_commit_stage or BankCluster::set_commit_stage. on_transfer runs on the thread that made the
+// transfer, after any journal wait, and adds to that call's latency, so a stage
+// should only hand the event on and do its work elsewhere.
+class CommitStage {
+public:
+    virtual ~CommitStage() = default;
+    virtual void on_transfer(const TransferEvent& event) noexcept = 0;
+};
+
+#endif // COMMIT_STAGE_H
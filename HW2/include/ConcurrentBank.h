@@ -0,0 +1,223 @@
+#ifndef CONCURRENT_BANK_H // Prevents double inclusion of this header
+#define CONCURRENT_BANK_H
+
+#include "AccountColumns.h"
+#include "AccountIndex.h"
+#include "Batch.h"
+#include "CommitStage.h"
+#include "EndOfDay.h"
+#include "Ledger.h"
+#include "Money.h"
+#include "PackedAccount.h"
+#include "Session.h"
+
+#include <array>        // For std::array
+#include <atomic>       // For std::atomic
+#include <cstdint>      // For std::uint64_t
+#include <mutex>        // For std::mutex
+#include <shared_mutex> // For std::shared_mutex
+#include <string>       // For std::string
+#include <utility>      // For std::swap
+#include <vector>       // For std::vector
+
+class Account; // Forward declaration of Account
+class Bank; // Forward declaration of Bank
+class Journal; // Forward declaration of Journal
+struct SnapshotCapture; // Forward declaration of SnapshotCapture
+struct SnapshotStats; // Forward declaration of SnapshotStats
+class Person; // Forward declaration of Person
+
+// Thread-safe front end of a Bank.
+// Deposits and withdrawals are lock-free compare-and-swap updates of the
+// balance, transfers lock the stripes of the two accounts they touch, so
+// unrelated balance operations run in parallel. Operations
+// that reshape the Bank's containers (create, delete, set_owner) and loans,
+// which read every account of a customer, take the whole Bank exclusively.
+// With a Journal attached every successful change is appended to it in the
+// order it was applied, and the call returns once its record is durable.
+// With a Ledger attached balance and loan operations are also entered there.
+// With a CommitStage attached it sees every transfer once the call has committed,
+// those a BankCluster runs from one of its accounts to another shard included.
+class ConcurrentBank {
+public:
+    // Number of account lock stripes, a power of two
+    static constexpr size_t STRIPES = 1024;
+    // Accounts whose cards snapshot() copies per hold of the lock
+    static constexpr size_t SNAPSHOT_CHUNK = 4096;
+
+    explicit ConcurrentBank(Bank& bank, Journal* journal = nullptr, Ledger* ledger = nullptr);
+
+    ConcurrentBank(const ConcurrentBank&) = delete;
+    ConcurrentBank& operator=(const ConcurrentBank&) = delete;
+
+    // Structural operations, exclusive. create_account never hands out a number already in the index.
+    Account* create_account(Person& owner, const std::string& owner_fingerprint, const std::string& password);
+    bool delete_account(Account& account, const std::string& owner_fingerprint);
+    bool delete_customer(Person& owner, const std::string& owner_fingerprint);
+    bool set_owner(Account& account, Person* new_owner, std::string& owner_fingerprint, std::string& bank_fingerprint);
+    bool set_account_status(Account& account, bool status, std::string& bank_fingerprint);
+    bool set_exp_date(Account& account, std::string& exp_date, std::string& bank_fingerprint);
+
+    // Balance operations, lock-free (deposit, withdraw) or striped (transfer).
+    // Transfers credit only active accounts the index knows, in batches and between the
+    // shards of a BankCluster alike; any other destination throws std::invalid_argument.
+    bool deposit(Account& account, const std::string& owner_fingerprint, double amount);
+    bool withdraw(Account& account, const std::string& owner_fingerprint, double amount);
+    bool transfer(Account& source, Account& destination, const std::string& owner_fingerprint,
+                  const std::string& CVV2, const std::string& password, const std::string& exp_date, double amount);
+
+    // Pay `amount` into an account on behalf of the bank itself, no owner fingerprint: credit
+    // only into an account a transfer may credit, refund into any account the index knows.
+    // Checked and paid under one hold of the lock, a status change can't slip in between.
+    // Throw std::invalid_argument when the bank fingerprint doesn't match or the account is refused.
+    bool credit(Account& destination, double amount, std::string bank_fingerprint);
+    bool refund(Account& account, double amount, std::string bank_fingerprint);
+    // Whether a transfer may credit `destination` now, the account is only read once the index knows it
+    bool accepts_transfers(const Account& destination);
+
+    // Authenticates `person` once, later calls pass the token instead of the fingerprint.
+    // Deleting the customer ends their sessions.
+    SessionToken open_session(const Person& person, const std::string& owner_fingerprint);
+    bool close_session(const SessionToken& session);
+
+    // Same as above for the owner of the session, the fingerprint isn't hashed again
+    bool deposit(Account& account, const SessionToken& session, double amount);
+    bool withdraw(Account& account, const SessionToken& session, double amount);
+    bool transfer(Account& source, Account& destination, const SessionToken& session,
+                  const std::string& CVV2, const std::string& password, const std::string& exp_date, double amount);
+    bool take_loan(Account& account, const SessionToken& session, double amount);
+
+    // Applies many balance operations under one lock acquisition and one journal commit.
+    // Operations run in submission order, a later one may spend what an earlier one brought in.
+    // Credentials are checked once per distinct owner and card rather than once per operation.
+    // Atomic batches are checked in full before anything changes and hold the Bank exclusively;
+    // should applying one still fail, those before it are undone and the batch is aborted, an
+    // error other than the Bank's refusal is rethrown after that.
+    BatchResult submit(const std::vector<BatchOperation>& operations, BatchMode mode);
+
+    // O(1) lookup through the account number index, nullptr when there is no such account.
+    // The index covers accounts created through this object and those picked up by reindex.
+    Account* find_account(std::uint64_t account_number);
+    Account* find_account(const std::string& account_number);
+    // Rebuilds the index and the columns from every account of the Bank, e.g. after a recovery
+    void reindex(std::string bank_fingerprint);
+
+    // Point-in-time view of the columnar copy of balances, statuses and owners (AccountColumns.h),
+    // which covers the same accounts as the index. Taking it waits for the balance updates in
+    // flight only, beside every other reader, and reading it holds nobody off however long a
+    // report runs. Writers then copy each shard they touch first, see AccountColumns.
+    AccountColumns::View read_view();
+    // Likewise, with the loan maps and bank totals in View::loans. Those are copied whole, once
+    // after each loan call or end of day made through this object.
+    AccountColumns::View read_view(std::string bank_fingerprint);
+
+    // Aggregates over a fresh read_view()
+    Money total_balance();
+    StatusCounts count_by_status();
+    std::vector<size_t> balance_histogram(Money width, size_t buckets);
+
+    // Loan operations
+    bool take_loan(Account& account, const std::string& owner_fingerprint, double amount);
+    bool pay_loan(Account& account, double amount);
+    // Interest accrual and rank promotion over every customer (EndOfDay.h), holds the Bank exclusively
+    EndOfDayReport end_of_day(const EndOfDayPolicy& policy, std::string bank_fingerprint);
+
+    // Writes the whole Bank to `path`, see Snapshot.h. Writers are held off while a view of the
+    // columns is taken and the loans are copied, which is O(customers). The cards of the accounts
+    // only change under the exclusive lock, they're copied afterwards SNAPSHOT_CHUNK accounts per
+    // shared hold, and the capture starts over when a structural change slipped in between.
+    // Needs the journal, which knows the ids, and every account must be in the index.
+    SnapshotStats snapshot(const std::string& path, std::string bank_fingerprint);
+
+    // Every committed transfer is handed to `stage` from now on, nullptr detaches it.
+    // Returns once no call is still handing events to the stage it replaced, which may then
+    // be destroyed. Must not be called from on_transfer.
+    void set_commit_stage(CommitStage* stage);
+
+    // The wrapped Bank, only safe to read while no other thread is using this object
+    Bank& get_bank();
+
+private:
+    // Hands its cross-shard transfers to the stage through StageUse and transfer_event
+    friend class BankCluster;
+
+    // One cache line per stripe so neighbouring locks don't false-share
+    struct alignas(64) Stripe {
+        std::mutex mutex;
+    };
+
+    std::mutex& stripe_of(const Account* account);
+    // The balance operations proper, the caller holds structure_mutex shared. They return the journal sequence.
+    std::uint64_t deposit_locked(Account& account, const std::string& owner_fingerprint, double amount);
+    std::uint64_t withdraw_locked(Account& account, const std::string& owner_fingerprint, double amount);
+    std::uint64_t credit_locked(Account& account, std::string& bank_fingerprint, double amount);
+    // transfer_locked fills `event`, when given, while the accounts are still locked.
+    std::uint64_t transfer_locked(Account& source, Account& destination, const std::string& owner_fingerprint,
+                                  const std::string& CVV2, const std::string& password,
+                                  const std::string& exp_date, double amount, TransferEvent* event);
+    // Whether a transfer may credit `destination`: a blocked account takes no money, and one the
+    // index does not know may be gone already. The caller holds structure_mutex.
+    bool accepts(const Account& destination) const;
+    // Runs `apply` holding the stripes of both accounts
+    template <typename F>
+    void with_stripes(const Account* source, const Account* destination, F&& apply);
+    void commit(std::uint64_t sequence);
+    void record(LedgerEntryType type, const Account& account, const Account* counterparty, double amount);
+    static TransferEvent transfer_event(const Account& source, const Account& destination, double amount);
+
+    // The commit stage as one call sees it, set_commit_stage waits for every StageUse of the
+    // stage it replaces to end. Calls count themselves in the counter of the current epoch and
+    // set_commit_stage moves on to the other one, so the old counter drains under any load.
+    class StageUse {
+    public:
+        explicit StageUse(ConcurrentBank& bank);
+        ~StageUse();
+
+        StageUse(const StageUse&) = delete;
+        StageUse& operator=(const StageUse&) = delete;
+
+        CommitStage* get() const;
+
+    private:
+        std::atomic<size_t>* users{nullptr};
+        CommitStage* stage{nullptr};
+    };
+
+    // Copies the cards of capture.accounts[begin, end), the caller holds structure_mutex
+    void capture_cards(SnapshotCapture& capture, size_t begin, size_t end);
+
+    Bank& bank;
+    Journal* journal;
+    Ledger* ledger;
+    std::atomic<CommitStage*> stage{nullptr};
+    std::mutex stage_mutex; // one set_commit_stage at a time
+    std::atomic<size_t> stage_epoch{0};
+    std::array<std::atomic<size_t>, 2> stage_users{}; // StageUses by epoch parity
+    AccountIndex index; // guarded by structure_mutex like the Bank's containers
+    SessionTable sessions; // likewise
+    OwnerIds owner_ids;    // likewise
+    AccountColumns columns; // likewise, but balances also change under the shared lock
+    std::shared_mutex structure_mutex; // exclusive: containers or loans change, shared: balances change
+    std::uint64_t structure_version{0}; // bumped with every exclusive change to accounts, owners or cards
+    std::array<Stripe, STRIPES> stripes;
+};
+
+template <typename F>
+void ConcurrentBank::with_stripes(const Account* source, const Account* destination, F&& apply) {
+    // 两个账户的锁总是按地址顺序获取, 相反方向的转账不会互相等待造成死锁
+    auto* first = &stripe_of(source);
+    auto* second = &stripe_of(destination);
+    if (first == second) {
+        std::lock_guard lock(*first);
+        apply();
+        return;
+    }
+    if (second < first)
+        std::swap(first, second);
+
+    std::lock_guard lock_first(*first);
+    std::lock_guard lock_second(*second);
+    apply();
+}
+
+#endif // CONCURRENT_BANK_H
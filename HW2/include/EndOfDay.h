@@ -0,0 +1,53 @@
+#ifndef END_OF_DAY_H // Prevents double inclusion of this header
+#define END_OF_DAY_H
+
+#include "Money.h"
+
+#include <chrono> // For std::chrono::nanoseconds
+#include <string> // For std::string
+#include <vector> // For std::vector
+
+class Bank; // Forward declaration of Bank
+
+struct EndOfDayPolicy {
+    double daily_rate{0.0}; // interest charged on each unpaid loan, 0.001 is 0.1% a day
+    size_t threads{0};      // 0: one per hardware thread
+    size_t partitions{0};   // 0: four per thread, so a slow partition doesn't hold the others up
+};
+
+struct PartitionReport {
+    size_t first{0};     // position of its first customer in the Bank's customer list
+    size_t customers{0};
+    size_t accrued{0};   // customers charged interest
+    size_t promoted{0};  // customers whose socioeconomic rank went up
+    Money interest;
+    size_t worker{0};    // the thread that ran it
+    std::chrono::nanoseconds elapsed{0};
+};
+
+struct EndOfDayReport {
+    std::vector<PartitionReport> partitions; // in customer order
+    size_t customers{0};
+    size_t accrued{0};
+    size_t promoted{0};
+    Money interest;
+    std::chrono::nanoseconds elapsed{0};
+};
+
+// The end-of-day loan job over every customer of a Bank:
+// - interest of daily_rate on the unpaid loan, rounded to the cent, is added to that loan,
+//   the bank's total loan and its total balance by Bank::accrue_interest, like the interest
+//   take_loan charges;
+// - the socioeconomic rank goes up while paid loans exceed pow(10, rank), the rule of
+//   pay_loan applied until it no longer holds, and stops at 10.
+// Customers are split into contiguous partitions that a pool of threads takes in turn.
+// Each customer only depends on their own loans, so the outcome is the same for any number
+// of threads or partitions. Customers without an account are left out.
+// Nothing else may use the Bank meanwhile, ConcurrentBank::end_of_day takes care of that.
+class EndOfDay {
+public:
+    // Throws std::invalid_argument when the bank fingerprint doesn't match
+    static EndOfDayReport run(Bank& bank, std::string bank_fingerprint, const EndOfDayPolicy& policy);
+};
+
+#endif // END_OF_DAY_H
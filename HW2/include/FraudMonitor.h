@@ -0,0 +1,118 @@
+#ifndef FRAUD_MONITOR_H // Prevents double inclusion of this header
+#define FRAUD_MONITOR_H
+
+#include "BoundedQueue.h"
+#include "CommitStage.h"
+#include "Money.h"
+
+#include <array>         // For std::array
+#include <atomic>        // For std::atomic
+#include <chrono>        // For std::chrono::system_clock
+#include <cstdint>       // For std::uint64_t
+#include <functional>    // For std::function
+#include <thread>        // For std::thread
+#include <unordered_map> // For std::unordered_map
+#include <unordered_set> // For std::unordered_set
+#include <vector>        // For std::vector
+
+struct FraudRules {
+    std::chrono::milliseconds window{std::chrono::minutes(1)};
+    std::uint64_t max_transfers{20};    // from one account within the window
+    Money max_amount{Money(1000000)};   // sent by one account within the window
+    double heavy_hitter_share{0.05};    // of every transfer in the window
+    std::uint64_t heavy_hitter_minimum{1000}; // transfers in the window before shares mean anything
+    size_t queue_capacity{1 << 16};
+};
+
+enum class FraudAlertType {
+    Burst,       // more than max_transfers
+    Amount,      // more than max_amount
+    HeavyHitter, // more than heavy_hitter_share of all transfers
+};
+
+struct FraudAlert {
+    FraudAlertType type;
+    std::uint64_t account;
+    std::uint64_t transfers; // in the window, for HeavyHitter an estimate that is never too low
+    Money amount;            // in the window
+    std::chrono::system_clock::time_point time;
+};
+
+struct FraudStats {
+    std::uint64_t received{0};
+    std::uint64_t dropped{0};   // the queue was full, the transfer went through unwatched
+    std::uint64_t processed{0};
+    std::uint64_t alerts{0};
+};
+
+// Post-commit stage that watches transfers for bursts from one source account.
+// on_transfer stamps the event and pushes it on a lock-free queue, nothing more; one
+// thread of the monitor takes events off and keeps, per source account, counts and
+// amounts over a window sliding in WINDOW_SLICES steps, plus a count-min sketch of
+// the whole window for accounts sending an outsized share of the traffic. Alerts go
+// to the handler from that thread, once when a rule starts to be broken and again
+// only after the account has dropped back under it.
+class FraudMonitor : public CommitStage {
+public:
+    using Clock = std::function<std::chrono::system_clock::time_point()>;
+    using AlertHandler = std::function<void(const FraudAlert&)>;
+
+    static constexpr size_t WINDOW_SLICES = 8;
+    static constexpr size_t SKETCH_DEPTH = 4;
+    static constexpr size_t SKETCH_WIDTH = 4096; // a power of two
+
+    FraudMonitor(FraudRules rules, AlertHandler on_alert, Clock clock = std::chrono::system_clock::now);
+    // Looks at what is still queued, then stops the thread
+    ~FraudMonitor() override;
+
+    FraudMonitor(const FraudMonitor&) = delete;
+    FraudMonitor& operator=(const FraudMonitor&) = delete;
+
+    void on_transfer(const TransferEvent& event) noexcept override;
+
+    // Waits until every event received so far has been looked at
+    void drain();
+    FraudStats stats() const;
+
+private:
+    struct Event {
+        TransferEvent transfer;
+        std::chrono::system_clock::time_point time;
+    };
+
+    struct Window {
+        std::int64_t newest{-1}; // slice number of the latest event
+        std::array<std::uint32_t, WINDOW_SLICES> counts{};
+        std::array<Money, WINDOW_SLICES> amounts{};
+        bool bursting{false};
+        bool over_amount{false};
+    };
+
+    void run();
+    void process(const Event& event);
+    void raise(FraudAlertType type, std::uint64_t account, std::uint64_t transfers, Money amount,
+               std::chrono::system_clock::time_point time);
+    std::uint64_t sketch_add(std::uint64_t account);
+
+    FraudRules rules;
+    AlertHandler on_alert;
+    Clock clock;
+    BoundedQueue<Event> queue;
+
+    // Only the monitor thread touches these
+    std::unordered_map<std::uint64_t, Window> windows;
+    std::vector<std::uint32_t> sketch;   // SKETCH_DEPTH rows of SKETCH_WIDTH counters
+    std::int64_t sketch_epoch{-1};       // whole windows since the clock's epoch
+    std::uint64_t sketch_total{0};
+    std::unordered_set<std::uint64_t> heavy_hitters; // already reported this window
+    std::int64_t last_sweep{0};
+
+    std::atomic<std::uint64_t> received{0};
+    std::atomic<std::uint64_t> dropped{0};
+    std::atomic<std::uint64_t> processed{0};
+    std::atomic<std::uint64_t> alerts{0};
+    std::atomic<bool> stopping{false};
+    std::thread worker;
+};
+
+#endif // FRAUD_MONITOR_H
@@ -0,0 +1,137 @@
+#ifndef JOURNAL_H // Prevents double inclusion of this header
+#define JOURNAL_H
+
+#include <chrono>             // For std::chrono::microseconds
+#include <condition_variable> // For std::condition_variable
+#include <cstdint>            // For std::uint64_t
+#include <memory>             // For std::unique_ptr
+#include <mutex>              // For std::mutex
+#include <string>             // For std::string
+#include <thread>             // For std::thread
+#include <unordered_map>      // For std::unordered_map
+#include <vector>             // For std::vector
+
+class Account; // Forward declaration of Account
+class Bank; // Forward declaration of Bank
+class Person; // Forward declaration of Person
+
+struct JournalOptions {
+    size_t batch_size = 64;                    // flush as soon as this many records are pending
+    std::chrono::microseconds max_delay{200};  // longest a partial batch waits for company
+    bool sync = true;                          // fdatasync every batch, off leaves it to the page cache
+};
+
+struct JournalStats {
+    size_t records{0}; // records made durable
+    size_t batches{0}; // writes (and fsyncs) it took
+    size_t bytes{0};
+};
+
+// What Journal::recover rebuilt. The Bank keeps raw pointers to its customers,
+// so the recovered Person objects are owned here and must outlive the Bank.
+struct JournalRecovery {
+    std::vector<std::unique_ptr<Person>> customers; // by journal customer id, empty when not restored
+    std::vector<Account*> accounts;                 // by journal account id, nullptr once deleted
+    // hashed_secret stand-ins of the fingerprints by journal customer id, they only
+    // authenticate inside a RestoredSecrets scope (Session.h)
+    std::vector<std::string> credentials;
+    std::vector<std::uint64_t> owners;              // customer id of each account id
+    size_t records{0};
+    size_t valid_bytes{0}; // length of the prefix made of whole, intact records
+    bool torn_tail{false}; // the log ended in an incomplete or corrupt record
+};
+
+// Append-only write-ahead log of the state-changing Bank calls.
+// Records are small binary frames (length, checksum, type, payload) that refer to
+// customers and accounts by dense ids instead of pointers. A background thread
+// group-commits them: every write + fsync carries all records pending at that
+// moment, and a caller only returns from wait_durable once its record is on disk.
+// Fingerprints and passwords are logged as their hashes only, recovery replays with
+// stand-ins for them. Account numbers and CVV2s are logged as they are, so the file
+// must still be guarded like the Bank itself.
+class Journal {
+public:
+    explicit Journal(const std::string& path, JournalOptions options = {});
+    // Continues a recovered log: ids carry on and a torn tail is cut off
+    Journal(const std::string& path, JournalOptions options, const JournalRecovery& resume);
+    ~Journal();
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    // Each appends the record of a call that already succeeded, returns its sequence number.
+    // The fingerprint only reads the CVV2, neither it nor the password is written out.
+    std::uint64_t log_create_account(const Account& account, const Person& owner,
+                                     const std::string& owner_fingerprint, const std::string& password);
+    // The Bank has freed the account by now, only its address is looked up
+    std::uint64_t log_delete_account(const Account* account);
+    std::uint64_t log_delete_customer(const Person& owner);
+    std::uint64_t log_deposit(const Account& account, double amount);
+    std::uint64_t log_withdraw(const Account& account, double amount);
+    std::uint64_t log_transfer(const Account& source, const Account& destination, double amount);
+    std::uint64_t log_take_loan(const Account& account, double amount);
+    std::uint64_t log_pay_loan(const Account& account, double amount);
+    std::uint64_t log_set_owner(const Account& account, const Person& new_owner);
+    std::uint64_t log_set_account_status(const Account& account, bool status);
+    std::uint64_t log_set_exp_date(const Account& account, const std::string& exp_date);
+    // Replayed by running EndOfDay with the same rate, which gives the same result
+    std::uint64_t log_end_of_day(double daily_rate);
+
+    // set_owner can only be replayed when the new owner is in the log
+    bool knows(const Person& customer) const;
+
+    // Blocks until every record up to `sequence` is durable
+    void wait_durable(std::uint64_t sequence);
+    // Writes out whatever is pending without waiting for the batch to fill
+    void flush();
+
+    JournalStats get_stats() const;
+
+    // Snapshot support, only meaningful while every writer is held off
+    std::uint64_t customer_id(const Person& customer) const;
+    std::uint64_t account_id(const Account& account) const;
+    std::uint64_t customer_ids_end() const;
+    std::uint64_t account_ids_end() const;
+    // Offset just past the last appended record, written out or not
+    std::uint64_t end_offset() const;
+
+    // Replays the log at `path` into `bank`. `base` is a loaded snapshot: the bank
+    // already holds its state, replay starts at its valid_bytes and carries on its ids.
+    static JournalRecovery recover(const std::string& path, Bank& bank, std::string bank_fingerprint,
+                                   JournalRecovery base = {});
+
+private:
+    std::uint64_t append(const std::string& record);
+    std::uint64_t account_record(std::uint8_t type, const Account& account, double amount);
+    void forget_account(const Account* account, std::uint64_t id);
+    void flush_loop();
+
+    int fd;
+    JournalOptions options;
+
+    mutable std::mutex mutex;
+    std::condition_variable work;    // wakes the flusher: batch full, flush requested or stopping
+    std::condition_variable durable; // wakes writers when durable_sequence moves
+    std::string pending;
+    size_t pending_records{0};
+    std::chrono::steady_clock::time_point oldest_pending;
+    std::uint64_t next_sequence{1};
+    std::uint64_t durable_sequence{0};
+    bool flush_requested{false};
+    bool stopping{false};
+    bool failed{false};
+    JournalStats stats;
+
+    std::unordered_map<const Person*, std::uint64_t> customer_ids;
+    std::unordered_map<const Account*, std::uint64_t> account_ids;
+    std::vector<std::uint64_t> account_owners; // customer id by account id
+    // Live accounts by customer id, deleting a customer drops the ids of all of them
+    std::unordered_map<std::uint64_t, std::vector<const Account*>> customer_accounts;
+    std::uint64_t appended_bytes{0};
+    std::uint64_t next_customer_id{0};
+    std::uint64_t next_account_id{0};
+
+    std::thread flusher; // started last, once everything above is initialised
+};
+
+#endif // JOURNAL_H
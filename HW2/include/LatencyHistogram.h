@@ -0,0 +1,84 @@
+#ifndef LATENCY_HISTOGRAM_H // Prevents double inclusion of this header
+#define LATENCY_HISTOGRAM_H
+
+#include <algorithm> // For std::min, std::max
+#include <bit>       // For std::bit_width
+#include <cstddef>   // For std::size_t
+#include <cstdint>   // For std::uint64_t
+#include <limits>    // For std::numeric_limits
+#include <vector>    // For std::vector
+
+// HDR-style histogram of latencies in nanoseconds: every power of two is cut into
+// SUB_BUCKETS linear buckets, so any recorded value up to 2^64 is kept to within
+// 1 / SUB_BUCKETS (under 1%) in a fixed 60 KB, whatever the number of samples.
+// Recording is a couple of shifts and an increment. Not thread-safe, keep one per
+// thread and merge them at the end.
+class LatencyHistogram {
+public:
+    static constexpr std::uint64_t SUB_BUCKETS = 128;
+
+    LatencyHistogram() : counts(bucket_of(std::numeric_limits<std::uint64_t>::max()) + 1, 0) {}
+
+    void record(std::uint64_t nanoseconds) {
+        counts[bucket_of(nanoseconds)]++;
+        total++;
+        lowest = std::min(lowest, nanoseconds);
+        highest = std::max(highest, nanoseconds);
+        sum += static_cast<double>(nanoseconds);
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (std::size_t i = 0; i < counts.size(); ++i)
+            counts[i] += other.counts[i];
+        total += other.total;
+        lowest = std::min(lowest, other.lowest);
+        highest = std::max(highest, other.highest);
+        sum += other.sum;
+    }
+
+    // Smallest recorded value that `percentile` percent of the samples don't exceed, reported
+    // as the top of its bucket and never above max(). 0 when nothing was recorded.
+    std::uint64_t value_at_percentile(double percentile) const {
+        if (total == 0)
+            return 0;
+        auto wanted = static_cast<std::uint64_t>(percentile / 100.0 * static_cast<double>(total) + 0.5);
+        wanted = std::clamp<std::uint64_t>(wanted, 1, total);
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < counts.size(); ++i) {
+            seen += counts[i];
+            if (seen >= wanted)
+                return std::min(highest, top_of(i));
+        }
+        return highest;
+    }
+
+    std::uint64_t count() const { return total; }
+    std::uint64_t min() const { return total ? lowest : 0; }
+    std::uint64_t max() const { return highest; }
+    double mean() const { return total ? sum / static_cast<double>(total) : 0.0; }
+
+private:
+    // Values below 2 * SUB_BUCKETS have a bucket each, above that the top 8 bits pick it
+    static std::size_t bucket_of(std::uint64_t value) {
+        if (value < 2 * SUB_BUCKETS)
+            return static_cast<std::size_t>(value);
+        auto shift = static_cast<std::uint64_t>(std::bit_width(value)) - std::bit_width(2 * SUB_BUCKETS - 1);
+        return static_cast<std::size_t>(2 * SUB_BUCKETS + (shift - 1) * SUB_BUCKETS + ((value >> shift) - SUB_BUCKETS));
+    }
+
+    static std::uint64_t top_of(std::size_t bucket) {
+        if (bucket < 2 * SUB_BUCKETS)
+            return bucket;
+        std::uint64_t shift = (bucket - 2 * SUB_BUCKETS) / SUB_BUCKETS + 1;
+        std::uint64_t top = (bucket - 2 * SUB_BUCKETS) % SUB_BUCKETS + SUB_BUCKETS;
+        return ((top + 1) << shift) - 1;
+    }
+
+    std::vector<std::uint64_t> counts;
+    std::uint64_t total{0};
+    std::uint64_t lowest{std::numeric_limits<std::uint64_t>::max()};
+    std::uint64_t highest{0};
+    double sum{0};
+};
+
+#endif // LATENCY_HISTOGRAM_H
@@ -0,0 +1,85 @@
+#ifndef LEDGER_H // Prevents double inclusion of this header
+#define LEDGER_H
+
+#include "Money.h"
+
+#include <chrono>        // For std::chrono::system_clock
+#include <cstdint>       // For std::uint64_t
+#include <deque>         // For std::deque
+#include <functional>    // For std::function
+#include <optional>      // For std::optional
+#include <shared_mutex>  // For std::shared_mutex
+#include <unordered_map> // For std::unordered_map
+#include <vector>        // For std::vector
+
+enum class LedgerEntryType {
+    Deposit,
+    Withdraw,
+    Transfer,
+    TakeLoan,
+    PayLoan,
+};
+
+// One completed balance or loan operation. Accounts are named by account number, which
+// is only unique among live accounts: once an account is deleted a new one may draw its
+// number, see Ledger::open.
+struct LedgerEntry {
+    std::uint64_t sequence; // position in the ledger, from 0
+    std::chrono::system_clock::time_point time;
+    LedgerEntryType type;
+    std::uint64_t account;      // the source of a transfer
+    std::uint64_t counterparty; // the destination of a transfer, 0 otherwise
+    Money amount;
+};
+
+struct LedgerQuery {
+    std::chrono::system_clock::time_point from{};                                       // inclusive
+    std::chrono::system_clock::time_point to{std::chrono::system_clock::time_point::max()}; // exclusive
+    std::optional<LedgerEntryType> type{}; // every type when empty
+    size_t limit{100};
+    std::uint64_t cursor{0}; // LedgerPage::next of the previous page
+};
+
+struct LedgerPage {
+    std::vector<LedgerEntry> entries;
+    std::optional<std::uint64_t> next; // cursor of the following page, empty on the last one
+};
+
+// Append-only history of transactions, kept in memory.
+// Entries are stored in the order they were appended and carry non-decreasing
+// times, so a time range is found by binary search rather than a scan. Each account
+// has its own list of the sequence numbers that involve it, searched the same way,
+// so an account's history costs what that account has, not what the ledger has.
+// Safe to use from several threads.
+class Ledger {
+public:
+    using Clock = std::function<std::chrono::system_clock::time_point()>;
+
+    explicit Ledger(Clock clock = std::chrono::system_clock::now);
+
+    Ledger(const Ledger&) = delete;
+    Ledger& operator=(const Ledger&) = delete;
+
+    // Returns the entry's sequence number. A clock that steps back is held at the last time.
+    std::uint64_t append(LedgerEntryType type, std::uint64_t account, std::uint64_t counterparty, Money amount);
+
+    // An account was created under the number `account`. history() of that number starts
+    // here, what earlier holders of the number did is only left to range().
+    void open(std::uint64_t account);
+
+    // Entries of the whole ledger, or those involving the current holder of `account`, oldest first
+    LedgerPage range(const LedgerQuery& query) const;
+    LedgerPage history(std::uint64_t account, const LedgerQuery& query) const;
+
+    std::optional<LedgerEntry> at(std::uint64_t sequence) const;
+    size_t size() const;
+
+private:
+    Clock clock;
+    mutable std::shared_mutex mutex;
+    std::deque<LedgerEntry> entries; // entries[i].sequence == i
+    std::unordered_map<std::uint64_t, std::vector<std::uint64_t>> accounts;
+    std::unordered_map<std::uint64_t, std::uint64_t> opened; // sequence the current holder starts at
+};
+
+#endif // LEDGER_H
@@ -0,0 +1,40 @@
+#ifndef MONEY_H // Prevents double inclusion of this header
+#define MONEY_H
+
+#include <compare>  // For std::strong_ordering
+#include <cstdint>  // For std::int64_t
+#include <string>   // For std::string
+
+// Fixed-point amount stored as a whole number of minor units (cents).
+// Sums and differences are exact, so repeated operations never drift
+// the way accumulating doubles does.
+class Money {
+public:
+    static constexpr std::int64_t MINOR_PER_MAJOR = 100;
+
+    constexpr Money() = default;
+    constexpr explicit Money(std::int64_t minor_units) : minor_units(minor_units) {}
+
+    // Rounds to the nearest minor unit, halves away from zero
+    static Money from_double(double amount);
+    double to_double() const;
+
+    constexpr std::int64_t get_minor_units() const { return minor_units; }
+
+    constexpr Money operator+(Money other) const { return Money(minor_units + other.minor_units); }
+    constexpr Money operator-(Money other) const { return Money(minor_units - other.minor_units); }
+    constexpr Money operator-() const { return Money(-minor_units); }
+    constexpr Money& operator+=(Money other) { minor_units += other.minor_units; return *this; }
+    constexpr Money& operator-=(Money other) { minor_units -= other.minor_units; return *this; }
+
+    constexpr std::strong_ordering operator<=>(const Money& other) const = default;
+    constexpr bool operator==(const Money& other) const = default;
+
+    // "-12.34" style representation
+    std::string to_string() const;
+
+private:
+    std::int64_t minor_units{0};
+};
+
+#endif // MONEY_H
@@ -0,0 +1,57 @@
+#ifndef PACKED_ACCOUNT_H // Prevents double inclusion of this header
+#define PACKED_ACCOUNT_H
+
+#include "Money.h"
+
+#include <cstdint>       // For std::uint16_t, std::uint32_t, std::uint64_t
+#include <optional>      // For std::optional
+#include <string>        // For std::string
+#include <string_view>   // For std::string_view
+#include <unordered_map> // For std::unordered_map
+#include <vector>        // For std::vector
+
+class Account; // Forward declaration of Account
+class Person; // Forward declaration of Person
+
+// Account squeezed into 32 bytes with no heap allocations, for bulk storage of many accounts.
+// An Account holds four std::strings and two back-pointers, the account number alone is one
+// byte past the small-string buffer and goes to the heap. Here every field is a number:
+// the account number as an integer, the balance in cents, the password as its Hash and the
+// owner as an id from OwnerIds.
+struct PackedAccount {
+    std::uint64_t account_number;
+    std::uint64_t password_hash;
+    Money balance;
+    std::uint32_t owner;
+    std::uint16_t CVV2;           // 0000-9999
+    std::uint16_t exp_date : 15;  // months since 00-01, see pack_exp_date
+    std::uint16_t status : 1;
+};
+
+static_assert(sizeof(PackedAccount) == 32, "two PackedAccounts per cache line");
+
+// Interns owners as dense 32-bit ids, the first owner gets 0
+class OwnerIds {
+public:
+    std::uint32_t intern(const Person* owner);
+    std::optional<std::uint32_t> find(const Person* owner) const;
+    const Person* person(std::uint32_t id) const;
+    size_t size() const;
+
+private:
+    std::unordered_map<const Person*, std::uint32_t> ids;
+    std::vector<const Person*> people;
+};
+
+// Throws std::invalid_argument when a field doesn't fit: an account number or CVV2 that
+// isn't all digits, or an expiry date other than "YY-MM"
+PackedAccount pack(const Account& account, OwnerIds& owners, const std::string& owner_fingerprint);
+
+// "YY-MM" as YY * 12 + MM - 1, std::nullopt for anything else
+std::optional<std::uint16_t> pack_exp_date(std::string_view exp_date);
+std::string unpack_exp_date(std::uint16_t exp_date);
+std::string unpack_CVV2(std::uint16_t CVV2);
+
+bool password_matches(const PackedAccount& account, const std::string& password);
+
+#endif // PACKED_ACCOUNT_H
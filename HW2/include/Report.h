@@ -0,0 +1,102 @@
+#ifndef REPORT_H // Prevents double inclusion of this header
+#define REPORT_H
+
+#include <cstddef>     // For std::size_t
+#include <fstream>     // For std::ofstream
+#include <string>      // For std::string
+#include <string_view> // For std::string_view
+
+class Bank; // Forward declaration of Bank
+class Person; // Forward declaration of Person
+
+enum class ReportFormat {
+    Text, // the lines get_info has always printed
+    CSV,  // one row per bank, customer and account, see ReportWriter
+    JSON, // {"bank": ..., "customers": [{..., "accounts": [...]}]}
+};
+
+// .csv and .json pick those formats, anything else is Text
+ReportFormat report_format_for(std::string_view path);
+
+// Where a report goes. ReportWriter hands it large chunks, sinks don't buffer themselves.
+class ReportSink {
+public:
+    virtual ~ReportSink() = default;
+    virtual void write(std::string_view chunk) = 0;
+    virtual void flush() {}
+};
+
+class FileSink : public ReportSink {
+public:
+    // Truncates `path`, throws std::runtime_error when it can't be opened
+    explicit FileSink(const std::string& path);
+    void write(std::string_view chunk) override;
+    void flush() override;
+
+private:
+    std::ofstream os;
+};
+
+// Goes through std::cout, so a redirected std::cout is honoured
+class StdoutSink : public ReportSink {
+public:
+    void write(std::string_view chunk) override;
+    void flush() override;
+};
+
+class MemorySink : public ReportSink {
+public:
+    void write(std::string_view chunk) override;
+    const std::string& str() const;
+
+private:
+    std::string text;
+};
+
+struct ReportAccount {
+    std::string_view account_number;
+    double balance;
+    std::string_view exp_date;
+    bool status;
+};
+
+// Formats a report record by record into a buffer of BUFFER_SIZE bytes that goes to the sink
+// whenever it fills, so memory stays the same however many accounts are written.
+// Calls go bank, then for each customer begin_customer, account..., end_customer, then finish.
+// CSV columns: record,name,age,gender,socioeconomic_rank,is_alive,account_number,balance,
+// exp_date,account_status,paid_loan,unpaid_loan. The bank row has its name, its total balance
+// under balance and its total loan under unpaid_loan.
+class ReportWriter {
+public:
+    static constexpr std::size_t BUFFER_SIZE = 64 * 1024;
+
+    ReportWriter(ReportSink& sink, ReportFormat format);
+    ~ReportWriter();
+
+    ReportWriter(const ReportWriter&) = delete;
+    ReportWriter& operator=(const ReportWriter&) = delete;
+
+    void bank(std::string_view name, double total_balance, double total_loan);
+    void begin_customer(const Person& person, double paid_loan, double unpaid_loan);
+    void account(const ReportAccount& account);
+    void end_customer();
+    // Closes the document and flushes the sink
+    void finish();
+
+private:
+    void drain_if_full();
+
+    ReportSink& sink;
+    ReportFormat format;
+    std::string buffer;
+    double paid_loan{0};
+    double unpaid_loan{0};
+    bool first_customer{true};
+    bool first_account{true};
+    bool finished{false};
+};
+
+// bank.get_info() written to `sink` in `format` rather than to stdout, see Bank::get_info(ReportWriter&)
+void write_report(const Bank& bank, ReportSink& sink, ReportFormat format);
+
+#endif // REPORT_H
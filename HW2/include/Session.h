@@ -0,0 +1,103 @@
+#ifndef SESSION_H // Prevents double inclusion of this header
+#define SESSION_H
+
+#include <cstddef>  // For size_t
+#include <cstdint>  // For std::uint32_t, std::uint64_t
+#include <optional> // For std::optional
+#include <string>   // For std::string
+#include <vector>  // For std::vector
+
+class Person; // Forward declaration of Person
+
+// Opaque handle of an authenticated customer, handed out by SessionTable::open.
+// It names a slot of the table directly, there's no lookup to do, and the
+// random secret is what makes it unforgeable.
+struct SessionToken {
+    std::uint32_t slot;
+    std::uint32_t generation; // bumped every time the slot is reused
+    std::uint64_t secret;
+};
+
+// Customers that proved their fingerprint once.
+// Not thread-safe by itself, ConcurrentBank guards it like its account index.
+class SessionTable {
+public:
+    // Checks `fingerprint` against the hash Person keeps, throws std::invalid_argument on mismatch
+    SessionToken open(const Person& person, const std::string& fingerprint);
+    bool close(const SessionToken& token);
+    // Ends every session of `person`, e.g. once the customer is deleted
+    size_t close_all(const Person& person);
+
+    // A hashed_secret stand-in for the fingerprint `owner` opened the session with, the table
+    // keeps no plaintext. It passes Bank's checks only inside a VerifiedFingerprint for `owner`.
+    // Throws std::invalid_argument when the token is stale, forged or belongs to someone else.
+    // The secret is compared in constant time, a mismatch takes as long as a match whatever bits differ.
+    const std::string& authenticate(const SessionToken& token, const Person& owner) const;
+
+    size_t size() const;
+
+private:
+    struct Slot {
+        const Person* person; // nullptr marks a free slot
+        std::uint32_t generation;
+        std::uint64_t secret;
+        std::string credential; // hashed_secret of the fingerprint
+    };
+
+    std::vector<Slot> slots;
+    std::vector<std::uint32_t> free_slots;
+    size_t count{0};
+};
+
+// Tells the Bank that `fingerprint` was already checked against `owner`.
+// While the scope lives, Bank calls made by this thread with that very string
+// object and an account of that owner skip hashing it again. The string must
+// not change in the meantime.
+// Whoever opens a scope vouches for the owner, so only the classes that checked
+// the fingerprint themselves (or act for the bank) may.
+class VerifiedFingerprint {
+public:
+    ~VerifiedFingerprint();
+
+    VerifiedFingerprint(const VerifiedFingerprint&) = delete;
+    VerifiedFingerprint& operator=(const VerifiedFingerprint&) = delete;
+
+    static bool covers(const Person* owner, const std::string& fingerprint);
+
+private:
+    friend class ConcurrentBank;
+    friend class BankCluster;
+
+    VerifiedFingerprint(const Person& owner, const std::string& fingerprint);
+
+    const Person* previous_owner;
+    const std::string* previous_fingerprint;
+};
+
+// Stand-in for a fingerprint or password of which only the hash is kept, as the journal and
+// snapshots do. Outside a RestoredSecrets scope it is an ordinary string that matches nothing.
+std::string hashed_secret(size_t hash);
+// The hash a hashed_secret carries, std::nullopt for any other string
+std::optional<size_t> hashed_secret_value(const std::string& secret);
+// Hash of a password as an Account stores it, a recovered account holds a hashed_secret
+size_t password_hash(const std::string& stored);
+// True when `given` hashes to the password `stored` holds, plain or as a hashed_secret
+bool password_matches(const std::string& stored, const std::string& given);
+
+// While the scope lives, Hash() of a hashed_secret on this thread yields the hash it carries.
+// Recovery rebuilds customers and replays their calls with the stand-ins, never the secrets.
+class RestoredSecrets {
+public:
+    RestoredSecrets();
+    ~RestoredSecrets();
+
+    RestoredSecrets(const RestoredSecrets&) = delete;
+    RestoredSecrets& operator=(const RestoredSecrets&) = delete;
+
+    static bool active();
+
+private:
+    bool previous;
+};
+
+#endif // SESSION_H
@@ -0,0 +1,132 @@
+#ifndef SLAB_POOL_H // Prevents double inclusion of this header
+#define SLAB_POOL_H
+
+#include <cstddef>  // For std::byte, std::size_t
+#include <cstdint>  // For std::uint32_t
+#include <memory>   // For std::unique_ptr
+#include <new>      // For placement new
+#include <utility>  // For std::forward
+#include <vector>   // For std::vector
+
+// Storage for many objects of one type, carved out of slabs of SLAB_SLOTS slots.
+// An object never moves, so a pointer stays valid until the object is destroyed.
+// Destroyed slots go on a free list and are handed out again newest first, while
+// they are still in cache. A Handle names a slot plus the generation that was
+// live in it, it goes stale instead of dangling once the object is destroyed.
+template <typename T, std::size_t SLAB_SLOTS = 1024>
+class SlabPool {
+public:
+    struct Handle {
+        std::uint32_t index;
+        std::uint32_t generation;
+    };
+
+    SlabPool() = default;
+    ~SlabPool() { clear(); }
+
+    SlabPool(const SlabPool&) = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+
+    template <typename... Args>
+    T* create(Args&&... args);
+    // `object` must have come from this pool
+    void destroy(T* object);
+    // Destroys every live object, the slabs are kept for reuse
+    void clear();
+
+    Handle handle(const T* object) const;
+    // nullptr once the object has been destroyed
+    T* get(Handle handle) const;
+
+    std::size_t size() const { return live; }
+    std::size_t capacity() const { return slabs.size() * SLAB_SLOTS; }
+
+private:
+    // storage comes first, a T* is also a Slot*
+    struct Slot {
+        alignas(T) std::byte storage[sizeof(T)];
+        std::uint32_t index;
+        std::uint32_t generation; // odd while an object lives here
+        Slot* next_free;
+    };
+
+    static Slot* slot_of(const T* object) {
+        return reinterpret_cast<Slot*>(const_cast<T*>(object));
+    }
+    static T* object_of(Slot* slot) {
+        return std::launder(reinterpret_cast<T*>(slot->storage));
+    }
+    Slot* slot_at(std::uint32_t index) const {
+        return &slabs[index / SLAB_SLOTS][index % SLAB_SLOTS];
+    }
+    void grow();
+
+    std::vector<std::unique_ptr<Slot[]>> slabs;
+    Slot* free_list{nullptr};
+    std::size_t live{0};
+};
+
+template <typename T, std::size_t SLAB_SLOTS>
+template <typename... Args>
+T* SlabPool<T, SLAB_SLOTS>::create(Args&&... args) {
+    if (!free_list)
+        grow();
+    Slot* slot = free_list;
+    // A throwing constructor leaves the slot on the free list
+    T* object = new (slot->storage) T(std::forward<Args>(args)...);
+    free_list = slot->next_free;
+    slot->generation++;
+    live++;
+    return object;
+}
+
+template <typename T, std::size_t SLAB_SLOTS>
+void SlabPool<T, SLAB_SLOTS>::destroy(T* object) {
+    Slot* slot = slot_of(object);
+    object->~T();
+    slot->generation++;
+    slot->next_free = free_list;
+    free_list = slot;
+    live--;
+}
+
+template <typename T, std::size_t SLAB_SLOTS>
+void SlabPool<T, SLAB_SLOTS>::clear() {
+    for (std::uint32_t index = 0; live > 0 && index < capacity(); ++index) {
+        Slot* slot = slot_at(index);
+        if (slot->generation % 2 == 1)
+            destroy(object_of(slot));
+    }
+}
+
+template <typename T, std::size_t SLAB_SLOTS>
+typename SlabPool<T, SLAB_SLOTS>::Handle SlabPool<T, SLAB_SLOTS>::handle(const T* object) const {
+    const Slot* slot = slot_of(object);
+    return Handle{slot->index, slot->generation};
+}
+
+template <typename T, std::size_t SLAB_SLOTS>
+T* SlabPool<T, SLAB_SLOTS>::get(Handle handle) const {
+    if (handle.index >= capacity())
+        return nullptr;
+    Slot* slot = slot_at(handle.index);
+    if (slot->generation != handle.generation || slot->generation % 2 == 0)
+        return nullptr;
+    return object_of(slot);
+}
+
+template <typename T, std::size_t SLAB_SLOTS>
+void SlabPool<T, SLAB_SLOTS>::grow() {
+    auto first = static_cast<std::uint32_t>(capacity());
+    slabs.push_back(std::make_unique_for_overwrite<Slot[]>(SLAB_SLOTS));
+    Slot* slab = slabs.back().get();
+    // Threaded back to front so the lowest address is handed out first
+    for (std::size_t i = SLAB_SLOTS; i-- > 0;) {
+        slab[i].index = first + static_cast<std::uint32_t>(i);
+        slab[i].generation = 0;
+        slab[i].next_free = free_list;
+        free_list = &slab[i];
+    }
+}
+
+#endif // SLAB_POOL_H
@@ -0,0 +1,75 @@
+#ifndef SNAPSHOT_H // Prevents double inclusion of this header
+#define SNAPSHOT_H
+
+#include "Journal.h"
+
+#include <chrono>  // For std::chrono::microseconds
+#include <cstdint> // For std::uint64_t
+#include <string>  // For std::string
+#include <vector>  // For std::vector
+
+class Account; // Forward declaration of Account
+class Bank; // Forward declaration of Bank
+
+// Snapshot file version written by write_snapshot, load_snapshot rejects any other
+constexpr std::uint32_t SNAPSHOT_VERSION = 2;
+
+struct SnapshotCustomer {
+    std::uint64_t id;          // journal customer id
+    std::string name;
+    std::string gender;
+    size_t age;
+    size_t hashed_fingerprint;
+    size_t rank;
+    bool is_alive;
+    bool has_loan;             // present in the Bank's loan maps
+    double paid_loan;
+    double unpaid_loan;
+};
+
+struct SnapshotAccount {
+    const Account* account;
+    std::uint64_t number;
+    double balance;
+    bool status;
+    // Copied after the rest, see ConcurrentBank::snapshot
+    std::uint64_t id{0};       // journal account id
+    std::uint64_t owner{0};    // journal customer id
+    std::string CVV2{};
+    std::string password{};    // as the Account holds it, only its hash is written out
+    std::string exp_date{};
+};
+
+// Everything the snapshot file holds, copied while ConcurrentBank's writers are held off.
+// write_snapshot reads nothing else, the customers and accounts may be gone by then.
+struct SnapshotCapture {
+    std::vector<SnapshotCustomer> customers;
+    std::vector<SnapshotAccount> accounts;
+    double total_balance{0.0};
+    double total_loan{0.0};
+    std::uint64_t journal_offset{0}; // the journal from here on holds what came after
+    std::uint64_t customer_ids_end{0};
+    std::uint64_t account_ids_end{0};
+};
+
+struct SnapshotStats {
+    size_t customers{0};
+    size_t accounts{0};
+    size_t bytes{0};
+    std::chrono::microseconds pause{0}; // how long writers were held off
+};
+
+// Writes `capture` as a versioned binary file: a header, fixed-size customer and
+// account rows, then one blob with every string. The file is replaced atomically.
+// Fingerprints and passwords are stored as their hashes only.
+SnapshotStats write_snapshot(const std::string& path, const SnapshotCapture& capture);
+
+// Maps the snapshot at `path` and rebuilds its state into an empty Bank.
+// Rows are decoded and customers constructed on `threads` threads (0: one per core);
+// the Bank itself is filled on the calling thread, through create_account and then
+// Bank::restore_loans. Customers get their hashed fingerprints back, accounts their numbers,
+// CVV2s and hashed passwords, and loans and bank totals are set to what was captured.
+// Pass the result to Journal::recover to replay what the journal holds beyond it.
+JournalRecovery load_snapshot(const std::string& path, Bank& bank, std::string bank_fingerprint, size_t threads = 0);
+
+#endif // SNAPSHOT_H
@@ -1,12 +1,21 @@
 #include "Account.h"
+#include "AccountNumbers.h"
 #include "Bank.h"
 #include "Person.h"
+#include "Session.h"
 #include "Utils.h"
-#include <sstream>
+#include <atomic>
 #include <iostream>
 #include <fstream>
 #include <format>
 
+namespace {
+// A fingerprint already verified on this thread (Session.h) isn't hashed again
+bool fingerprint_matches(const Person* owner, const std::string& fingerprint) {
+    return VerifiedFingerprint::covers(owner, fingerprint) || owner->get_hashed_fingerprint() == Hash(fingerprint);
+}
+}
+
 Account::Account(Person *const owner, const Bank *const bank, const std::string &password) :
     owner(owner),
     bank(bank),
@@ -23,7 +32,8 @@ const Person* Account::get_owner() const {
     return owner;
 }
 double Account::get_balance() const {
-    return balance;
+    // Bank updates the balance with atomic compare-and-swap, read it the same way
+    return std::atomic_ref<double>(const_cast<double&>(balance)).load(std::memory_order_acquire);
 }
 
 std::string Account::get_account_number() const {
@@ -35,28 +45,28 @@ bool Account::get_status() const {
 }
 
 std::string Account::get_CVV2(const std::string& owner_fingerprint) const {
-    if (owner->get_hashed_fingerprint() != Hash(owner_fingerprint))
+    if (!fingerprint_matches(owner, owner_fingerprint))
         throw std::invalid_argument("Input fingerprint doesn't match owner fingerprint");
 
     return CVV2;
 }
 
 std::string Account::get_password(const std::string& owner_fingerprint) const {
-    if (owner->get_hashed_fingerprint() != Hash(owner_fingerprint))
+    if (!fingerprint_matches(owner, owner_fingerprint))
         throw std::invalid_argument("Input fingerprint doesn't match owner fingerprint");
 
     return password;
 }
 
 std::string Account::get_exp_date(const std::string& owner_fingerprint) const {
-    if (owner->get_hashed_fingerprint() != Hash(owner_fingerprint))
+    if (!fingerprint_matches(owner, owner_fingerprint))
         throw std::invalid_argument("Input fingerprint doesn't match owner fingerprint");
 
     return exp_date;
 }
 
 bool Account::set_password(const std::string &password, const std::string &owner_fingerprint) {
-    if (owner->get_hashed_fingerprint() != Hash(owner_fingerprint))
+    if (!fingerprint_matches(owner, owner_fingerprint))
         throw std::invalid_argument("Input fingerprint doesn't match owner fingerprint");
 
     this->password = password;
@@ -87,17 +97,9 @@ void Account::get_info(std::optional<std::string> file_name) const {
 }
 
 std::string Account::gen_account_number() {
-    std::stringstream ss("");
-
-    for (size_t i = 0; i < 16; ++i)
-        ss << Rand(0, 9);
-
-    return ss.str();
+    // One draw from a per-thread generator instead of sixteen freshly seeded ones
+    return format_account_number(draw_account_number());
 }
 std::string Account::gen_CVV2() {
-    std::stringstream ss("");
-
-    ss << Rand(0, 9) << Rand(0, 9) << Rand(0, 9) << Rand(0, 9);
-
-    return ss.str();
+    return draw_CVV2();
 }
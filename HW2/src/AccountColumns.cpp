@@ -0,0 +1,190 @@
+#include "AccountColumns.h"
+#include "Account.h"
+#include "AccountIndex.h"
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+Money AccountColumns::View::sum() const {
+  std::int64_t total = 0;
+  for (const auto& shard : shards)
+    for (auto balance : shard->balances)
+      total += balance;
+  return Money(total);
+}
+
+StatusCounts AccountColumns::View::count_by_status() const {
+  size_t active = 0;
+  for (const auto& shard : shards)
+    for (auto status : shard->statuses)
+      active += status;
+  return StatusCounts{active, size() - active};
+}
+
+std::vector<size_t> AccountColumns::View::histogram(Money width, size_t buckets) const {
+  if (width <= Money() || buckets == 0)
+    throw std::invalid_argument("Histogram needs a positive width and at least one bucket.");
+
+  std::vector<size_t> counts(buckets, 0);
+  auto last = static_cast<std::int64_t>(buckets - 1);
+  auto step = width.get_minor_units();
+  for (const auto& shard : shards)
+    for (auto balance : shard->balances)
+      counts[std::clamp<std::int64_t>(balance / step, 0, last)]++;
+  return counts;
+}
+
+size_t AccountColumns::View::size() const {
+  size_t count = 0;
+  for (const auto& shard : shards)
+    count += shard->numbers.size();
+  return count;
+}
+
+const LoanBook* AccountColumns::View::loans() const {
+  return loan_book.get();
+}
+
+AccountColumns::AccountColumns() {
+  for (auto& slot : slots)
+    slot.shard = std::make_shared<Shard>();
+}
+
+void AccountColumns::insert(const Account* account, std::uint32_t owner) {
+  auto index = shard_of(account);
+  auto& shard = writable(slots[index]);
+  if (!rows.try_emplace(account, static_cast<std::uint32_t>(shard.accounts.size())).second)
+    return;
+  shard.balances.push_back(Money::from_double(account->get_balance()).get_minor_units());
+  shard.statuses.push_back(account->get_status() ? 1 : 0);
+  shard.owners.push_back(owner);
+  shard.numbers.push_back(AccountIndex::parse(account->get_account_number()).value_or(0));
+  shard.accounts.push_back(account);
+}
+
+bool AccountColumns::erase(const Account* account) {
+  auto found = rows.find(account);
+  if (found == rows.end())
+    return false;
+  erase_row(shard_of(account), found->second);
+  return true;
+}
+
+size_t AccountColumns::erase_owner(std::uint32_t owner) {
+  size_t erased = 0;
+  for (size_t index = 0; index < SHARDS; ++index) {
+    // Only shards holding the owner are copied
+    const auto& owners = slots[index].shard->owners;
+    if (std::find(owners.begin(), owners.end(), owner) == owners.end())
+      continue;
+    for (std::uint32_t row = 0; row < slots[index].shard->owners.size();) {
+      // the last row moves into this one, look at it again
+      if (slots[index].shard->owners[row] == owner) {
+        erase_row(index, row);
+        ++erased;
+      } else {
+        ++row;
+      }
+    }
+  }
+  return erased;
+}
+
+void AccountColumns::clear() {
+  for (auto& slot : slots)
+    slot.shard = std::make_shared<Shard>();
+  rows.clear();
+  loan_book.reset();
+}
+
+void AccountColumns::add_balance(const Account* account, Money amount) {
+  std::shared_lock views(views_mutex);
+  add_balance_locked(account, amount);
+}
+
+void AccountColumns::move_balance(const Account* source, const Account* destination, Money amount) {
+  std::shared_lock views(views_mutex);
+  add_balance_locked(source, -amount);
+  add_balance_locked(destination, amount);
+}
+
+void AccountColumns::add_balance_locked(const Account* account, Money amount) {
+  // rows only changes while nobody else uses the columns, the lookup needs no lock
+  auto found = rows.find(account);
+  if (found == rows.end())
+    return;
+  auto& slot = slots[shard_of(account)];
+  std::lock_guard lock(slot.mutex);
+  writable(slot).balances[found->second] += amount.get_minor_units();
+}
+
+void AccountColumns::set_owner(const Account* account, std::uint32_t owner) {
+  if (auto found = rows.find(account); found != rows.end())
+    writable(slots[shard_of(account)]).owners[found->second] = owner;
+}
+
+void AccountColumns::set_status(const Account* account, bool status) {
+  if (auto found = rows.find(account); found != rows.end())
+    writable(slots[shard_of(account)]).statuses[found->second] = status ? 1 : 0;
+}
+
+AccountColumns::View AccountColumns::view() {
+  std::unique_lock lock(views_mutex);
+  return view_locked();
+}
+
+AccountColumns::View AccountColumns::view_locked() {
+  views_taken.fetch_add(1, std::memory_order_relaxed);
+  View view;
+  for (size_t index = 0; index < SHARDS; ++index)
+    view.shards[index] = slots[index].shard;
+  view.loan_book = loan_book;
+  return view;
+}
+
+void AccountColumns::set_loans(std::shared_ptr<const LoanBook> loans) {
+  loan_book = std::move(loans);
+}
+
+bool AccountColumns::has_loans() const {
+  return loan_book != nullptr;
+}
+
+size_t AccountColumns::size() const {
+  return rows.size();
+}
+
+size_t AccountColumns::shard_of(const Account* account) {
+  // Accounts come from a slab, neighbouring ones differ in the low bits of their address
+  auto address = reinterpret_cast<std::uintptr_t>(account);
+  return (address >> 6) & (SHARDS - 1);
+}
+
+AccountColumns::Shard& AccountColumns::writable(Slot& slot) {
+  // A View is never taken while a writer runs, views_taken can't move under us
+  auto epoch = views_taken.load(std::memory_order_relaxed);
+  if (slot.epoch != epoch) {
+    slot.shard = std::make_shared<Shard>(*slot.shard);
+    slot.epoch = epoch;
+  }
+  return *slot.shard;
+}
+
+void AccountColumns::erase_row(size_t index, std::uint32_t row) {
+  auto& shard = writable(slots[index]);
+  rows.erase(shard.accounts[row]);
+  auto last = static_cast<std::uint32_t>(shard.accounts.size() - 1);
+  if (row != last) {
+    shard.balances[row] = shard.balances[last];
+    shard.statuses[row] = shard.statuses[last];
+    shard.owners[row] = shard.owners[last];
+    shard.numbers[row] = shard.numbers[last];
+    shard.accounts[row] = shard.accounts[last];
+    rows[shard.accounts[row]] = row;
+  }
+  shard.balances.pop_back();
+  shard.statuses.pop_back();
+  shard.owners.pop_back();
+  shard.numbers.pop_back();
+  shard.accounts.pop_back();
+}
@@ -0,0 +1,167 @@
+#include "AccountIndex.h"
+#include "Account.h"
+#include "AccountNumbers.h"
+#include <charconv>
+#include <stdexcept>
+
+namespace {
+constexpr size_t INITIAL_CAPACITY = 16; // a power of two, masks replace modulo
+
+// splitmix64 finalizer, account numbers are random digits but their low bits aren't uniform
+std::uint64_t mix(std::uint64_t key) {
+  key ^= key >> 30;
+  key *= 0xbf58476d1ce4e5b9ULL;
+  key ^= key >> 27;
+  key *= 0x94d049bb133111ebULL;
+  key ^= key >> 31;
+  return key;
+}
+}
+
+AccountIndex::AccountIndex() :
+    slots(INITIAL_CAPACITY, Slot{0, nullptr}) {
+
+}
+
+std::optional<std::uint64_t> AccountIndex::parse(std::string_view account_number) {
+  std::uint64_t value = 0;
+  if (account_number.size() != 16)
+    return std::nullopt;
+  auto [end, error] = std::from_chars(account_number.data(), account_number.data() + account_number.size(), value);
+  if (error != std::errc() || end != account_number.data() + account_number.size())
+    return std::nullopt;
+  return value;
+}
+
+std::uint64_t AccountIndex::draw_unused() const {
+  bool restored = RestoredAccountNumber::pending();
+  auto number = draw_account_number();
+  if (restored && find(number))
+    throw std::invalid_argument("Restored account number is already taken.");
+  while (find(number))
+    number = draw_account_number();
+  return number;
+}
+
+void AccountIndex::insert(Account* account) {
+  auto key = parse(account->get_account_number());
+  if (!key)
+    throw std::invalid_argument("Account number isn't 16 digits.");
+
+  // Keep the load factor under 3/4, probe sequences stay short
+  if ((count + 1) * 4 > slots.size() * 3)
+    grow();
+
+  size_t mask = slots.size() - 1;
+  for (size_t slot = home(*key);; slot = (slot + 1) & mask) {
+    if (!slots[slot].account) {
+      slots[slot] = Slot{*key, account};
+      numbers[account] = *key;
+      ++count;
+      return;
+    }
+    if (slots[slot].key == *key) {
+      numbers.erase(slots[slot].account);
+      slots[slot].account = account;
+      numbers[account] = *key;
+      return;
+    }
+  }
+}
+
+bool AccountIndex::erase(std::uint64_t account_number) {
+  size_t mask = slots.size() - 1;
+  for (size_t slot = home(account_number); slots[slot].account; slot = (slot + 1) & mask) {
+    if (slots[slot].key == account_number) {
+      erase_slot(slot);
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t AccountIndex::erase_owned_by(const Person* owner) {
+  size_t erased = 0;
+  for (size_t slot = 0; slot < slots.size();) {
+    // erase_slot may shift a later entry into this slot, look at it again
+    if (slots[slot].account && slots[slot].account->get_owner() == owner) {
+      erase_slot(slot);
+      ++erased;
+    } else {
+      ++slot;
+    }
+  }
+  return erased;
+}
+
+std::vector<std::uint64_t> AccountIndex::owned_by(const Person* owner) const {
+  std::vector<std::uint64_t> numbers;
+  for (const auto& slot : slots)
+    if (slot.account && slot.account->get_owner() == owner)
+      numbers.push_back(slot.key);
+  return numbers;
+}
+
+Account* AccountIndex::find(std::uint64_t account_number) const {
+  size_t mask = slots.size() - 1;
+  for (size_t slot = home(account_number); slots[slot].account; slot = (slot + 1) & mask)
+    if (slots[slot].key == account_number)
+      return slots[slot].account;
+  return nullptr;
+}
+
+std::optional<std::uint64_t> AccountIndex::number_of(const Account* account) const {
+  auto found = numbers.find(account);
+  if (found == numbers.end())
+    return std::nullopt;
+  return found->second;
+}
+
+size_t AccountIndex::size() const {
+  return count;
+}
+
+size_t AccountIndex::capacity() const {
+  return slots.size();
+}
+
+void AccountIndex::clear() {
+  slots.assign(INITIAL_CAPACITY, Slot{0, nullptr});
+  numbers.clear();
+  count = 0;
+}
+
+size_t AccountIndex::home(std::uint64_t key) const {
+  return mix(key) & (slots.size() - 1);
+}
+
+void AccountIndex::grow() {
+  std::vector<Slot> old(slots.size() * 2, Slot{0, nullptr});
+  old.swap(slots);
+  size_t mask = slots.size() - 1;
+  for (const auto& entry : old) {
+    if (!entry.account)
+      continue;
+    size_t slot = home(entry.key);
+    while (slots[slot].account)
+      slot = (slot + 1) & mask;
+    slots[slot] = entry;
+  }
+}
+
+void AccountIndex::erase_slot(size_t slot) {
+  // Backward-shift deletion: pull later entries of the cluster into the hole
+  // unless that would move them in front of their home slot
+  numbers.erase(slots[slot].account);
+  size_t mask = slots.size() - 1;
+  size_t hole = slot;
+  for (size_t next = (hole + 1) & mask; slots[next].account; next = (next + 1) & mask) {
+    size_t ideal = home(slots[next].key);
+    if (((next - ideal) & mask) >= ((next - hole) & mask)) {
+      slots[hole] = slots[next];
+      hole = next;
+    }
+  }
+  slots[hole] = Slot{0, nullptr};
+  --count;
+}
@@ -0,0 +1,111 @@
+#include "AccountNumbers.h"
+#include <atomic>
+#include <format>
+#include <random>
+#include <utility>
+
+namespace {
+constexpr std::uint64_t ACCOUNT_NUMBER_LIMIT = 10'000'000'000'000'000ULL; // 10^16
+
+std::atomic<bool> luhn_enabled{false};
+thread_local RestoredAccountNumber* restored = nullptr;
+
+std::mt19937_64& generator() {
+  thread_local std::mt19937_64 engine = [] {
+    std::random_device rd;
+    std::seed_seq seed{rd(), rd(), rd(), rd()};
+    return std::mt19937_64(seed);
+  }();
+  return engine;
+}
+
+// Check digit that makes payload * 10 + digit pass the Luhn test
+std::uint64_t luhn_digit(std::uint64_t payload) {
+  std::uint64_t sum = 0;
+  for (bool doubled = true; payload > 0; payload /= 10, doubled = !doubled) {
+    std::uint64_t digit = payload % 10;
+    if (doubled)
+      digit = digit * 2 > 9 ? digit * 2 - 9 : digit * 2;
+    sum += digit;
+  }
+  return (10 - sum % 10) % 10;
+}
+}
+
+std::uint64_t draw_account_number() {
+  for (auto* scope = restored; scope; scope = scope->previous) {
+    if (!scope->account_number)
+      continue;
+    auto account_number = *scope->account_number;
+    scope->account_number.reset();
+    return account_number;
+  }
+  if (!luhn_enabled.load(std::memory_order_relaxed))
+    return std::uniform_int_distribution<std::uint64_t>(0, ACCOUNT_NUMBER_LIMIT - 1)(generator());
+
+  std::uint64_t payload = std::uniform_int_distribution<std::uint64_t>(0, ACCOUNT_NUMBER_LIMIT / 10 - 1)(generator());
+  return payload * 10 + luhn_digit(payload);
+}
+
+std::string format_account_number(std::uint64_t account_number) {
+  return std::format("{:016}", account_number);
+}
+
+std::string draw_CVV2() {
+  for (auto* scope = restored; scope; scope = scope->previous) {
+    if (!scope->CVV2)
+      continue;
+    auto CVV2 = std::move(*scope->CVV2);
+    scope->CVV2.reset();
+    return CVV2;
+  }
+  return std::format("{:04}", std::uniform_int_distribution<unsigned>(0, 9999)(generator()));
+}
+
+void set_luhn_account_numbers(bool enabled) {
+  luhn_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool get_luhn_account_numbers() {
+  return luhn_enabled.load(std::memory_order_relaxed);
+}
+
+bool luhn_valid(std::string_view number) {
+  if (number.empty())
+    return false;
+  std::uint64_t sum = 0;
+  bool doubled = false;
+  for (auto it = number.rbegin(); it != number.rend(); ++it, doubled = !doubled) {
+    if (*it < '0' || *it > '9')
+      return false;
+    std::uint64_t digit = static_cast<std::uint64_t>(*it - '0');
+    if (doubled)
+      digit = digit * 2 > 9 ? digit * 2 - 9 : digit * 2;
+    sum += digit;
+  }
+  return sum % 10 == 0;
+}
+
+RestoredAccountNumber::RestoredAccountNumber(std::uint64_t account_number, std::string CVV2) :
+    account_number(account_number),
+    CVV2(std::move(CVV2)),
+    previous(restored) {
+  restored = this;
+}
+
+RestoredAccountNumber::RestoredAccountNumber(std::uint64_t account_number) :
+    account_number(account_number),
+    previous(restored) {
+  restored = this;
+}
+
+RestoredAccountNumber::~RestoredAccountNumber() {
+  restored = previous;
+}
+
+bool RestoredAccountNumber::pending() {
+  for (const auto* scope = restored; scope; scope = scope->previous)
+    if (scope->account_number)
+      return true;
+  return false;
+}
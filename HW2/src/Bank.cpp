@@ -1,13 +1,170 @@
 #include "Bank.h"
 #include "Person.h"
 #include "Account.h"
+#include "AccountIndex.h"
+#include "AccountNumbers.h"
 #include "Utils.h"
+#include "Money.h"
+#include "Session.h"
+#include "SlabPool.h"
+#include "Report.h"
+#include <atomic>
 #include <stdexcept>
 #include <algorithm>
 #include <cmath>
-#include <fstream>
-#include <iostream>
 #include <format>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+// A fingerprint that a session already verified on this thread isn't hashed again, see Session.h
+bool fingerprint_matches(const Person* owner, const std::string& fingerprint) {
+  return VerifiedFingerprint::covers(owner, fingerprint) || owner->get_hashed_fingerprint() == Hash(fingerprint);
+}
+
+// Balances are only touched through std::atomic_ref, so a single-account deposit or
+// withdrawal is one compare-and-swap and needs no lock. Every value written lies on
+// the cent grid of Money, sums are done in integer minor units and never drift.
+void add_balance(double& balance, Money amount) {
+  std::atomic_ref<double> ref(balance);
+  double expected = ref.load(std::memory_order_relaxed);
+  while (!ref.compare_exchange_weak(expected, (Money::from_double(expected) + amount).to_double(),
+                                    std::memory_order_acq_rel, std::memory_order_relaxed)) {
+  }
+}
+
+// The overdraft check is part of the CAS loop, a concurrent withdrawal can't slip in between
+bool sub_balance(double& balance, Money amount) {
+  std::atomic_ref<double> ref(balance);
+  double expected = ref.load(std::memory_order_relaxed);
+  do {
+    if (Money::from_double(expected) < amount)
+      return false;
+  } while (!ref.compare_exchange_weak(expected, (Money::from_double(expected) - amount).to_double(),
+                                      std::memory_order_acq_rel, std::memory_order_relaxed));
+  return true;
+}
+
+double add_money(double total, double amount) {
+  return (Money::from_double(total) + Money::from_double(amount)).to_double();
+}
+
+// Where each element sits in its vector, so removal swaps the last element into the
+// hole instead of scanning. A stale or missing position (a copied Bank starts without
+// any) is noticed on use and the positions of that vector are rebuilt once.
+template<typename T>
+using Positions = std::unordered_map<const T*, size_t>;
+
+template<typename T>
+void track(const std::vector<T*>& items, Positions<T>& positions) {
+  positions[items.back()] = items.size() - 1;
+}
+
+template<typename T>
+void swap_remove(std::vector<T*>& items, Positions<T>& positions, const T* item) {
+  auto found = positions.find(item);
+  if (found == positions.end() || found->second >= items.size() || items[found->second] != item) {
+    for (size_t i = 0; i < items.size(); ++i)
+      positions[items[i]] = i;
+    found = positions.find(item);
+    if (found == positions.end() || found->second >= items.size() || items[found->second] != item)
+      return;
+  }
+
+  size_t hole = found->second;
+  positions.erase(found);
+  items[hole] = items.back();
+  items.pop_back();
+  if (hole < items.size())
+    positions[items[hole]] = hole;
+}
+
+// Everything a customer's loan decision needs, in one record kept up to date by every
+// balance and loan change. The loan maps of Bank mirror paid_loan and unpaid_loan.
+struct CustomerTotals {
+  std::atomic<std::int64_t> balance{0}; // minor units over all accounts, updated lock-free
+  Money paid_loan;
+  Money unpaid_loan;
+};
+
+// Bank's members are fixed by its header, this state lives beside each Bank
+struct BankState {
+  Positions<Account> accounts;          // in bank_accounts
+  Positions<Person> customers;          // in bank_customers
+  Positions<Account> customer_accounts; // in the owner's customer_2_accounts vector
+  std::unordered_map<const Person*, CustomerTotals> totals;
+  SlabPool<Account> pool;               // every Account of the Bank lives here
+  AccountIndex numbers;                 // of bank_accounts, new numbers are drawn against it
+};
+
+std::mutex states_mutex;
+std::unordered_map<const Bank*, std::unique_ptr<BankState>> states;
+std::atomic<std::uint64_t> states_generation{0}; // moves whenever a Bank drops its state
+
+BankState& state_of(const Bank* bank) {
+  // Balance operations look the state up on every call, a thread remembers the last one
+  // it used and only takes the mutex when it switches Bank or some Bank went away
+  struct Cached {
+    const Bank* bank;
+    BankState* state;
+    std::uint64_t generation;
+  };
+  thread_local Cached cached{nullptr, nullptr, 0};
+  auto generation = states_generation.load(std::memory_order_acquire);
+  if (cached.bank == bank && cached.generation == generation)
+    return *cached.state;
+
+  std::lock_guard lock(states_mutex);
+  auto& state = states[bank];
+  if (!state)
+    state = std::make_unique<BankState>();
+  cached = Cached{bank, state.get(), generation};
+  return *state;
+}
+
+// The record of `owner`, built from their accounts and loan maps when missing (a new
+// customer, or any customer of a copied Bank)
+CustomerTotals& totals_of(BankState& state, Person* owner, const std::map<Person*, std::vector<Account*>>& accounts,
+                          const std::map<Person*, double>& paid, const std::map<Person*, double>& unpaid) {
+  auto [found, inserted] = state.totals.try_emplace(owner);
+  auto& totals = found->second;
+  if (inserted) {
+    if (auto held = accounts.find(owner); held != accounts.end())
+      for (const auto* account : held->second)
+        totals.balance.fetch_add(Money::from_double(account->get_balance()).get_minor_units());
+    if (auto loan = paid.find(owner); loan != paid.end())
+      totals.paid_loan = Money::from_double(loan->second);
+    if (auto loan = unpaid.find(owner); loan != unpaid.end())
+      totals.unpaid_loan = Money::from_double(loan->second);
+  }
+  return totals;
+}
+
+// Balance operations only adjust records that exist, a missing one is built from scratch later
+void adjust_balance(BankState& state, const Person* owner, Money amount) {
+  if (auto found = state.totals.find(owner); found != state.totals.end())
+    found->second.balance.fetch_add(amount.get_minor_units(), std::memory_order_relaxed);
+}
+
+// End-of-day interest on an existing loan, see Bank::accrue_interest. Several threads book it at
+// once but each for its own customers, so nothing is inserted and only the bank totals are shared.
+// A missing totals record picks the map up later.
+void book_interest(BankState& state, std::map<Person*, double>& unpaid_loans, Person* owner, Money interest,
+                     double& bank_total_loan, double& bank_total_balance) {
+  if (!(interest > Money()))
+    throw std::invalid_argument("accrued interest must be positive.");
+  auto unpaid = unpaid_loans.find(owner);
+  if (unpaid == unpaid_loans.end())
+    throw std::invalid_argument("customer has no loan to accrue interest on.");
+
+  if (auto found = state.totals.find(owner); found != state.totals.end())
+    found->second.unpaid_loan += interest;
+  unpaid->second = (Money::from_double(unpaid->second) + interest).to_double();
+  add_balance(bank_total_loan, interest);
+  add_balance(bank_total_balance, interest);
+}
+}
 
 Bank::Bank(const std::string& bank_name, const std::string& bank_fingerprint) :
     bank_name(bank_name),
@@ -16,25 +173,42 @@ Bank::Bank(const std::string& bank_name, const std::string& bank_fingerprint) :
 }
 
 Bank::~Bank() {
-  for(auto& account : bank_accounts) {
-     delete account;
-   }
+  // Dropping the state destroys the pool and with it every account still open
+  std::lock_guard lock(states_mutex);
+  states.erase(this);
+  states_generation.fetch_add(1, std::memory_order_release);
 }
 
 Account* Bank::create_account(Person& owner, const std::string& owner_fingerprint, const std::string password) {
   if(owner.get_hashed_fingerprint() != Hash(owner_fingerprint) )
        throw std::invalid_argument("Hashed fingerprint don't match");
 
+  auto& state = state_of(this);
+  // Numbers are random, the repeat is drawn again before the account exists. A copied Bank
+  // starts without the index and builds it here once.
+  if (state.numbers.size() != bank_accounts.size()) {
+    state.numbers.clear();
+    for (auto* held : bank_accounts)
+      state.numbers.insert(held);
+  }
+  RestoredAccountNumber number(state.numbers.draw_unused());
+
   // 没有当前客户
-  if(!customer_2_accounts.contains(&owner))
+  if(!customer_2_accounts.contains(&owner)) {
       bank_customers.push_back(&owner);
+      track(bank_customers, state.customers);
+  }
 
   // 创建账户
-  auto* account = new Account(&owner, this, password);
+  auto* account = state.pool.create(&owner, this, password);
+  state.numbers.insert(account);
   bank_accounts.push_back(account);
+  track(bank_accounts, state.accounts);
 
   account_2_customer[account] = &owner;
   customer_2_accounts[&owner].push_back(account);
+  track(customer_2_accounts[&owner], state.customer_accounts);
+  totals_of(state, &owner, customer_2_accounts, customer_2_paid_loan, customer_2_unpaid_loan);
 
   return account;
 }
@@ -45,13 +219,21 @@ bool Bank::delete_account(Account& account, const std::string& owner_fingerprint
         throw std::invalid_argument("Input fingerprint don't match.");
     }
 
-  if(account.get_balance() != 0.0) {
+  std::atomic_ref<double> balance(account.balance);
+  if(balance.load(std::memory_order_acquire) != 0.0) {
     throw std::invalid_argument("Input fingerprint don't match.");
   }
 
-  std::erase(bank_accounts, &account);
+  auto& state = state_of(this);
+  swap_remove(bank_accounts, state.accounts, &account);
   account_2_customer.erase(&account);
-  std::erase(customer_2_accounts[owner], &account);
+  swap_remove(customer_2_accounts[owner], state.customer_accounts, &account);
+  if (auto number = state.numbers.number_of(&account))
+    state.numbers.erase(*number);
+  // Whatever the account still holds leaves the owner's loan limit with it, a deposit
+  // that slipped in after the check included
+  adjust_balance(state, owner, -Money::from_double(balance.load(std::memory_order_acquire)));
+  state.pool.destroy(&account);
 
   return true;
 }
@@ -61,15 +243,21 @@ bool Bank::delete_customer(Person& owner, const std::string& owner_fingerprint)
     throw std::invalid_argument("Input fingerprint don't match.");
   }
 
-  std::erase(bank_customers, &owner);
+  auto& state = state_of(this);
+  swap_remove(bank_customers, state.customers, &owner);
   for(auto& elem : customer_2_accounts[&owner]) {
-    std::erase(bank_accounts, elem);
+    swap_remove(bank_accounts, state.accounts, elem);
+    state.customer_accounts.erase(elem);
     account_2_customer.erase(elem);
+    if (auto number = state.numbers.number_of(elem))
+      state.numbers.erase(*number);
+    state.pool.destroy(elem);
   }
 
   customer_2_accounts.erase(&owner);
   customer_2_paid_loan.erase(&owner);
   customer_2_unpaid_loan.erase(&owner);
+  state.totals.erase(&owner);
 
   return true;
 }
@@ -77,25 +265,39 @@ bool Bank::delete_customer(Person& owner, const std::string& owner_fingerprint)
 
 bool Bank::deposit(Account& account, const std::string& owner_fingerprint, double amount) {
   auto owner = account.owner;
-  if(owner->get_hashed_fingerprint() != Hash(owner_fingerprint) ) {
+  if(!fingerprint_matches(owner, owner_fingerprint)) {
     throw std::invalid_argument("Input fingerprint don't match.");
   }
 
-  account.balance += amount;
+  Money money = Money::from_double(amount);
+  add_balance(account.balance, money);
+  adjust_balance(state_of(this), owner, money);
+  return true;
+}
+
+bool Bank::credit(Account& account, double amount, std::string& bank_fingerprint) {
+  if(Hash(bank_fingerprint) != hashed_bank_fingerprint)
+    throw std::invalid_argument("bank fingerprint don't match.");
+
+  // Money the bank itself pays in, e.g. the far side of a transfer between two Banks
+  Money money = Money::from_double(amount);
+  add_balance(account.balance, money);
+  adjust_balance(state_of(this), account.owner, money);
   return true;
 }
 
 bool Bank::withdraw(Account& account, const std::string& owner_fingerprint, double amount) {
   auto owner = account.owner;
-  if(owner->get_hashed_fingerprint() != Hash(owner_fingerprint) ) {
+  if(!fingerprint_matches(owner, owner_fingerprint)) {
     throw std::invalid_argument("Input fingerprint don't match.");
   }
 
-  if(account.balance < amount) {
+  Money money = Money::from_double(amount);
+  if(!sub_balance(account.balance, money)) {
    throw std::invalid_argument("Input fingerprint don't match.");
   }
+  adjust_balance(state_of(this), owner, -money);
 
-  account.balance -= amount;
   return true;
 }
 
@@ -103,63 +305,105 @@ bool Bank::transfer(Account& source, Account& destination, const std::string& ow
                     const std::string& CVV2, const std::string& password,
                     const std::string& exp_date, double amount) {
   auto owner = source.owner;
-  if(owner->get_hashed_fingerprint() != Hash(owner_fingerprint) ||
+  Money money = Money::from_double(amount);
+  if(!fingerprint_matches(owner, owner_fingerprint) ||
      source.CVV2 != CVV2 ||
-     source.password != password ||
+     !password_matches(source.password, password) ||
      source.exp_date != exp_date ||
-     source.balance < amount) {
+     !sub_balance(source.balance, money)) {
     throw std::invalid_argument("Input fingerprint don't match.");
   }
 
-  source.balance -= amount;
-  destination.balance += amount;
+  add_balance(destination.balance, money);
+  auto& state = state_of(this);
+  adjust_balance(state, owner, -money);
+  adjust_balance(state, destination.owner, money);
 
   return true;
 }
 
 bool Bank::take_loan(Account& account, const std::string& owner_fingerprint, double amount) {
   auto owner = account.owner;
-  if(owner->get_hashed_fingerprint() != Hash(owner_fingerprint))
+  if(!fingerprint_matches(owner, owner_fingerprint))
     throw std::invalid_argument("Input fingerprint don't match.");
 
+  // O(1) whatever the number of accounts, the record is kept current by every balance change
   size_t rank = owner->get_socioeconomic_rank();
-  double total_balance = 0.0;
-  for(const auto& elem : customer_2_accounts[owner])
-    total_balance += elem->balance;
-  double total_loan = static_cast<double>(rank) / 10 * total_balance;
+  auto& totals = totals_of(state_of(this), owner, customer_2_accounts, customer_2_paid_loan, customer_2_unpaid_loan);
+  Money total_balance(totals.balance.load(std::memory_order_relaxed));
+  double total_loan = static_cast<double>(rank) / 10 * total_balance.to_double();
 
-  double current_loan{0.0};
-  if (customer_2_unpaid_loan.contains(owner))
-    current_loan = customer_2_unpaid_loan[owner];
+  double current_loan = totals.unpaid_loan.to_double();
 
   if(total_loan < amount + current_loan)
       throw std::invalid_argument("Input fingerprint don't match.");
 
-  if (!customer_2_unpaid_loan.contains(owner)) {
-    customer_2_unpaid_loan[owner] = 0.0;
-    customer_2_paid_loan[owner] = 0.0;
-  }
-  double interst = static_cast<double>(amount) / rank / 10;
-  customer_2_unpaid_loan[owner] += amount + interst;
-  bank_total_loan += amount + interst;
-  bank_total_balance += interst;
+  double interst = Money::from_double(static_cast<double>(amount) / rank / 10).to_double();
+  totals.unpaid_loan += Money::from_double(add_money(amount, interst));
+  customer_2_paid_loan[owner] = totals.paid_loan.to_double();
+  customer_2_unpaid_loan[owner] = totals.unpaid_loan.to_double();
+  bank_total_loan = add_money(bank_total_loan, add_money(amount, interst));
+  bank_total_balance = add_money(bank_total_balance, interst);
   return true;
 }
 
 bool Bank::pay_loan(Account& account, double amount) {
   auto owner = account.owner;
 
-  customer_2_paid_loan[owner] += amount;
-  customer_2_unpaid_loan[owner] -= amount;
-  bank_total_loan -= amount;
+  auto& totals = totals_of(state_of(this), owner, customer_2_accounts, customer_2_paid_loan, customer_2_unpaid_loan);
+  totals.paid_loan += Money::from_double(amount);
+  totals.unpaid_loan -= Money::from_double(amount);
+  customer_2_paid_loan[owner] = totals.paid_loan.to_double();
+  customer_2_unpaid_loan[owner] = totals.unpaid_loan.to_double();
+  bank_total_loan = add_money(bank_total_loan, -amount);
 
   size_t rank = owner->get_socioeconomic_rank();
-  if(customer_2_paid_loan[owner] > pow(10, rank))
+  if(totals.paid_loan.to_double() > pow(10, rank))
       owner->set_socioeconomic_rank(rank + 1);
 
   return true;
 }
 
+bool Bank::accrue_interest(Account& account, double amount, std::string& bank_fingerprint) {
+  if(Hash(bank_fingerprint) != hashed_bank_fingerprint)
+    throw std::invalid_argument("bank fingerprint don't match.");
+
+  // Interest on the loan the owner already has: no owner fingerprint, limit or origination interest
+  book_interest(state_of(this), customer_2_unpaid_loan, account.owner, Money::from_double(amount), bank_total_loan,
+                bank_total_balance);
+  return true;
+}
+
+bool Bank::restore_loans(const std::vector<Person*>& customers, const std::map<Person*, double>& paid_loans,
+                         const std::map<Person*, double>& unpaid_loans, double total_balance, double total_loan,
+                         std::string& bank_fingerprint) {
+  if(Hash(bank_fingerprint) != hashed_bank_fingerprint)
+    throw std::invalid_argument("bank fingerprint don't match.");
+
+  // Customers whose accounts are all gone still belong to the Bank, with an empty account list
+  auto& state = state_of(this);
+  for (auto* customer : customers) {
+    if (customer_2_accounts.contains(customer))
+      continue;
+    bank_customers.push_back(customer);
+    track(bank_customers, state.customers);
+    customer_2_accounts[customer];
+  }
+
+  // Set as they were, not lent again: nothing is checked, charged or ranked
+  for (const auto& [customer, unpaid] : unpaid_loans) {
+    auto paid = paid_loans.find(customer);
+    auto& totals = totals_of(state, customer, customer_2_accounts, customer_2_paid_loan, customer_2_unpaid_loan);
+    totals.paid_loan = Money::from_double(paid == paid_loans.end() ? 0.0 : paid->second);
+    totals.unpaid_loan = Money::from_double(unpaid);
+    customer_2_paid_loan[customer] = totals.paid_loan.to_double();
+    customer_2_unpaid_loan[customer] = totals.unpaid_loan.to_double();
+  }
+  bank_total_balance = total_balance;
+  bank_total_loan = total_loan;
+  return true;
+}
+
 const std::string& Bank::get_bank_name() const {
   return bank_name;
 }
@@ -233,15 +477,24 @@ bool Bank::set_owner(Account& account, Person* new_owner, std::string& owner_fin
   }
 
   account.owner = new_owner;
-  std::erase(customer_2_accounts[owner], &account);
+  auto& state = state_of(this);
+  swap_remove(customer_2_accounts[owner], state.customer_accounts, &account);
+  // The balance of the account moves with it
+  adjust_balance(state, owner, -Money::from_double(account.get_balance()));
 
   if (!customer_2_accounts.contains(owner)) {
     bank_customers.push_back(owner);
+    track(bank_customers, state.customers);
     customer_2_paid_loan[owner] = 0.0;
     customer_2_unpaid_loan[owner] = 0.0;
+    state.totals.erase(owner);
   }
   account_2_customer[&account] = new_owner;
+  bool known = state.totals.contains(new_owner);
   customer_2_accounts[new_owner].push_back(&account);
+  track(customer_2_accounts[new_owner], state.customer_accounts);
+  if (known)
+    adjust_balance(state, new_owner, Money::from_double(account.get_balance()));
 
   return true;
 }
@@ -263,34 +516,33 @@ bool Bank::set_exp_date(Account& account, std::string& exp_date, std::string& ba
 }
 
 void Bank::get_info(std::optional<std::string> file_name) const {
+  // One pass through one buffered sink. Person/Account::get_info reopened and truncated the
+  // file for every record, the report now streams however many accounts there are.
+  std::unique_ptr<ReportSink> sink;
+  ReportFormat format = ReportFormat::Text;
   if (file_name.has_value()) {
-    std::ofstream os(file_name.value());
-
-    os << std::format("bank name: {} | ", bank_name)
-       << std::format("bank total balance: {} | ", bank_total_balance)
-       << std::format("bank total loan: {} | ", bank_total_loan) << std::endl;
-
-    for (const auto&[fst, snd] : customer_2_accounts) {
-      fst->get_info(file_name);
-      for (const auto& account : snd) {
-        account->get_info(file_name);
-      }
-      os << std::format("paid loan: {} |", customer_2_paid_loan.at(fst))
-         << std::format("unpaid loan : {} ", customer_2_unpaid_loan.at(fst)) << std::endl;
-    }
+    sink = std::make_unique<FileSink>(file_name.value());
+    format = report_format_for(file_name.value());
+  } else {
+    sink = std::make_unique<StdoutSink>();
   }
-  else {
-    std::cout << std::format("bank name: {} | ", bank_name)
-       << std::format("bank total balance: {} | ", bank_total_balance)
-       << std::format("bank total loan: {} | ", bank_total_loan) << std::endl;
-
-    for (const auto&[fst, snd] : customer_2_accounts) {
-      fst->get_info(file_name);
-      for (const auto& account : snd) {
-        account->get_info(file_name);
-      }
-      std::cout << std::format("paid loan: {} |", customer_2_paid_loan.at(fst))
-         << std::format("unpaid loan : {} ", customer_2_unpaid_loan.at(fst)) << std::endl;
+  ReportWriter writer(*sink, format);
+  get_info(writer);
+}
+
+void Bank::get_info(ReportWriter& writer) const {
+  // Customers who never took a loan have no entry in the loan maps
+  auto loan = [](const auto& loans, Person* customer) {
+    auto it = loans.find(customer);
+    return it == loans.end() ? 0.0 : it->second;
+  };
+  writer.bank(bank_name, bank_total_balance, bank_total_loan);
+  for (const auto&[fst, snd] : customer_2_accounts) {
+    writer.begin_customer(*fst, loan(customer_2_paid_loan, fst), loan(customer_2_unpaid_loan, fst));
+    for (const auto& account : snd) {
+      writer.account({account->account_number, account->get_balance(), account->exp_date, account->account_status});
     }
+    writer.end_customer();
   }
-}
\ No newline at end of file
+  writer.finish();
+}
@@ -0,0 +1,199 @@
+#include "BankCluster.h"
+#include "Account.h"
+#include "Person.h"
+#include "Session.h"
+#include "Utils.h"
+#include <format>
+#include <stdexcept>
+
+BankCluster::Shard::Shard(const std::string& bank_name, const std::string& bank_fingerprint) :
+    bank(bank_name, bank_fingerprint),
+    front(bank) {
+
+}
+
+BankCluster::BankCluster(size_t shards, const std::string& bank_name, const std::string& bank_fingerprint) :
+    bank_fingerprint(bank_fingerprint) {
+  if (shards == 0)
+    throw std::invalid_argument("a cluster needs at least one shard.");
+  for (size_t i = 0; i < shards; ++i)
+    this->shards.push_back(std::make_unique<Shard>(std::format("{}-{}", bank_name, i), bank_fingerprint));
+}
+
+size_t BankCluster::shard_count() const {
+  return shards.size();
+}
+
+size_t BankCluster::shard_of(const Person& customer) const {
+  return customer.get_hashed_fingerprint() % shards.size();
+}
+
+size_t BankCluster::shard_of(const Account& account) {
+  std::shared_lock lock(homes_mutex);
+  auto home = homes.find(&account);
+  if (home == homes.end())
+    throw std::invalid_argument("account is not in this cluster.");
+  return home->second;
+}
+
+ConcurrentBank& BankCluster::shard(size_t index) {
+  return shards.at(index)->front;
+}
+
+Account* BankCluster::create_account(Person& owner, const std::string& owner_fingerprint, const std::string& password) {
+  size_t index = shard_of(owner);
+  Account* account = shards[index]->front.create_account(owner, owner_fingerprint, password);
+  std::unique_lock lock(homes_mutex);
+  homes[account] = index;
+  return account;
+}
+
+bool BankCluster::delete_account(Account& account, const std::string& owner_fingerprint) {
+  auto& shard = *shards[shard_of(account)];
+  {
+    std::lock_guard lock(shard.mutex);
+    if (shard.pins.contains(&account))
+      throw std::invalid_argument("account has a transfer in progress.");
+    shard.front.delete_account(account, owner_fingerprint);
+  }
+  // The pool hands the address out again, so it leaves the map before anyone can reuse it
+  std::unique_lock lock(homes_mutex);
+  homes.erase(&account);
+  return true;
+}
+
+bool BankCluster::deposit(Account& account, const std::string& owner_fingerprint, double amount) {
+  return shards[shard_of(account)]->front.deposit(account, owner_fingerprint, amount);
+}
+
+bool BankCluster::withdraw(Account& account, const std::string& owner_fingerprint, double amount) {
+  return shards[shard_of(account)]->front.withdraw(account, owner_fingerprint, amount);
+}
+
+bool BankCluster::transfer(Account& source, Account& destination, const std::string& owner_fingerprint,
+                           const std::string& CVV2, const std::string& password, const std::string& exp_date,
+                           double amount) {
+  auto& from = *shards[shard_of(source)];
+  auto& to = *shards[shard_of(destination)];
+  if (&from == &to) {
+    from.front.transfer(source, destination, owner_fingerprint, CVV2, password, exp_date, amount);
+    local_transfers.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Counted in from the start, as ConcurrentBank::transfer does, so detaching the stage waits for it
+  ConcurrentBank::StageUse after(from.front);
+  TransferEvent event{};
+
+  // A failed prepare on the source leaves nothing behind, the exception is the no vote
+  auto transaction = next_transaction.fetch_add(1, std::memory_order_relaxed);
+  auto money = Money::from_double(amount);
+  prepare_debit(from, transaction, source, owner_fingerprint, CVV2, password, exp_date, money);
+  bool prepared = prepare_credit(to, transaction, destination, money);
+  // Both accounts are pinned until their commit, their numbers can still be read
+  if (prepared && after.get())
+    event = ConcurrentBank::transfer_event(source, destination, amount);
+  if (!prepared || !commit(to, transaction)) {
+    abort(from, transaction);
+    aborted.fetch_add(1, std::memory_order_relaxed);
+    throw std::invalid_argument("destination account refused the transfer.");
+  }
+  commit(from, transaction);
+  committed.fetch_add(1, std::memory_order_relaxed);
+  if (after.get())
+    after.get()->on_transfer(event);
+  return true;
+}
+
+void BankCluster::set_commit_stage(CommitStage* stage) {
+  for (auto& shard : shards)
+    shard->front.set_commit_stage(stage);
+}
+
+Money BankCluster::total_balance() {
+  Money total;
+  for (auto& shard : shards)
+    total += shard->front.total_balance();
+  return total + in_flight();
+}
+
+Money BankCluster::in_flight() const {
+  return Money(escrow.load(std::memory_order_acquire));
+}
+
+ClusterStats BankCluster::stats() const {
+  return ClusterStats{local_transfers.load(std::memory_order_relaxed), committed.load(std::memory_order_relaxed),
+                      aborted.load(std::memory_order_relaxed)};
+}
+
+void BankCluster::prepare_debit(Shard& shard, std::uint64_t transaction, Account& source,
+                                const std::string& owner_fingerprint, const std::string& CVV2,
+                                const std::string& password, const std::string& exp_date, Money amount) {
+  // The card is what Bank::transfer checks on top of withdraw. The fingerprint is hashed once
+  // here, the getters and the withdrawal below take it as verified.
+  if (source.get_owner()->get_hashed_fingerprint() != Hash(owner_fingerprint))
+    throw std::invalid_argument("Input fingerprint don't match.");
+  VerifiedFingerprint verified(*source.get_owner(), owner_fingerprint);
+  if (source.get_CVV2(owner_fingerprint) != CVV2 || !password_matches(source.get_password(owner_fingerprint), password) ||
+      source.get_exp_date(owner_fingerprint) != exp_date)
+    throw std::invalid_argument("Input fingerprint don't match.");
+
+  // Pinned before the debit, an account emptied by it could otherwise be deleted before a refund
+  {
+    std::lock_guard lock(shard.mutex);
+    shard.pins[&source]++;
+  }
+  try {
+    shard.front.withdraw(source, owner_fingerprint, amount.to_double());
+  } catch (...) {
+    std::lock_guard lock(shard.mutex);
+    unpin(shard, &source);
+    throw;
+  }
+  escrow.fetch_add(amount.get_minor_units(), std::memory_order_acq_rel);
+  std::lock_guard lock(shard.mutex);
+  shard.prepared.emplace(transaction, Prepared{&source, amount, true});
+}
+
+bool BankCluster::prepare_credit(Shard& shard, std::uint64_t transaction, Account& destination, Money amount) {
+  // Checked by address before the account is read, it may be gone already. Pinned right
+  // away, so it stays until commit, though its status may still change meanwhile.
+  std::lock_guard lock(shard.mutex);
+  if (!shard.front.accepts_transfers(destination))
+    return false;
+  shard.prepared.emplace(transaction, Prepared{&destination, amount, false});
+  shard.pins[&destination]++;
+  return true;
+}
+
+bool BankCluster::commit(Shard& shard, std::uint64_t transaction) {
+  std::lock_guard lock(shard.mutex);
+  auto prepared = shard.prepared.extract(transaction).mapped();
+  bool credited = true;
+  if (!prepared.debit) {
+    try {
+      shard.front.credit(*prepared.account, prepared.amount.to_double(), bank_fingerprint);
+      escrow.fetch_sub(prepared.amount.get_minor_units(), std::memory_order_acq_rel);
+    } catch (const std::invalid_argument&) {
+      credited = false;
+    }
+  }
+  unpin(shard, prepared.account);
+  return credited;
+}
+
+void BankCluster::abort(Shard& shard, std::uint64_t transaction) {
+  std::lock_guard lock(shard.mutex);
+  auto prepared = shard.prepared.extract(transaction).mapped();
+  if (prepared.debit) {
+    // The source is pinned, the index still has it whatever its status now
+    shard.front.refund(*prepared.account, prepared.amount.to_double(), bank_fingerprint);
+    escrow.fetch_sub(prepared.amount.get_minor_units(), std::memory_order_acq_rel);
+  }
+  unpin(shard, prepared.account);
+}
+
+void BankCluster::unpin(Shard& shard, const Account* account) {
+  if (--shard.pins[account] == 0)
+    shard.pins.erase(account);
+}
@@ -0,0 +1,826 @@
+#include "ConcurrentBank.h"
+#include "Bank.h"
+#include "Account.h"
+#include "Journal.h"
+#include "Person.h"
+#include "Money.h"
+#include "Session.h"
+#include "Snapshot.h"
+#include "Utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+ConcurrentBank::ConcurrentBank(Bank& bank, Journal* journal, Ledger* ledger) :
+    bank(bank),
+    journal(journal),
+    ledger(ledger) {
+
+}
+
+Account* ConcurrentBank::create_account(Person& owner, const std::string& owner_fingerprint, const std::string& password) {
+  Account* account;
+  std::uint64_t sequence = 0;
+  {
+    std::unique_lock lock(structure_mutex);
+    ++structure_version;
+    // The Bank hands out numbers no other of its accounts holds
+    account = bank.create_account(owner, owner_fingerprint, password);
+    index.insert(account);
+    if (ledger)
+      ledger->open(*AccountIndex::parse(account->get_account_number()));
+    columns.insert(account, owner_ids.intern(&owner));
+    if (journal)
+      sequence = journal->log_create_account(*account, owner, owner_fingerprint, password);
+  }
+  commit(sequence);
+  return account;
+}
+
+bool ConcurrentBank::delete_account(Account& account, const std::string& owner_fingerprint) {
+  std::uint64_t sequence = 0;
+  {
+    std::unique_lock lock(structure_mutex);
+    ++structure_version;
+    // The Bank frees the account, read what's needed of it first
+    auto number = *AccountIndex::parse(account.get_account_number());
+    bank.delete_account(account, owner_fingerprint);
+    index.erase(number);
+    columns.erase(&account);
+    if (journal)
+      sequence = journal->log_delete_account(&account);
+  }
+  commit(sequence);
+  return true;
+}
+
+bool ConcurrentBank::delete_customer(Person& owner, const std::string& owner_fingerprint) {
+  std::uint64_t sequence = 0;
+  {
+    std::unique_lock lock(structure_mutex);
+    ++structure_version;
+    auto numbers = index.owned_by(&owner);
+    // The Bank touches the loan maps even when it refuses
+    columns.set_loans(nullptr);
+    bank.delete_customer(owner, owner_fingerprint);
+    for (auto number : numbers)
+      index.erase(number);
+    if (auto id = owner_ids.find(&owner))
+      columns.erase_owner(*id);
+    sessions.close_all(owner);
+    if (journal)
+      sequence = journal->log_delete_customer(owner);
+  }
+  commit(sequence);
+  return true;
+}
+
+bool ConcurrentBank::set_owner(Account& account, Person* new_owner, std::string& owner_fingerprint, std::string& bank_fingerprint) {
+  std::uint64_t sequence = 0;
+  {
+    std::unique_lock lock(structure_mutex);
+    ++structure_version;
+    // The log has no fingerprint for someone who never opened an account, replay couldn't act for them
+    if (journal && !journal->knows(*new_owner))
+      throw std::invalid_argument("New owner has no account in the journaled bank.");
+    // The index maps to the account itself, a new owner leaves it untouched
+    bank.set_owner(account, new_owner, owner_fingerprint, bank_fingerprint);
+    columns.set_owner(&account, owner_ids.intern(new_owner));
+    if (journal)
+      sequence = journal->log_set_owner(account, *new_owner);
+  }
+  commit(sequence);
+  return true;
+}
+
+bool ConcurrentBank::set_account_status(Account& account, bool status, std::string& bank_fingerprint) {
+  std::uint64_t sequence = 0;
+  {
+    std::unique_lock lock(structure_mutex);
+    ++structure_version;
+    bank.set_account_status(account, status, bank_fingerprint);
+    columns.set_status(&account, status);
+    if (journal)
+      sequence = journal->log_set_account_status(account, status);
+  }
+  commit(sequence);
+  return true;
+}
+
+bool ConcurrentBank::set_exp_date(Account& account, std::string& exp_date, std::string& bank_fingerprint) {
+  std::uint64_t sequence = 0;
+  {
+    std::unique_lock lock(structure_mutex);
+    ++structure_version;
+    bank.set_exp_date(account, exp_date, bank_fingerprint);
+    if (journal)
+      sequence = journal->log_set_exp_date(account, exp_date);
+  }
+  commit(sequence);
+  return true;
+}
+
+bool ConcurrentBank::deposit(Account& account, const std::string& owner_fingerprint, double amount) {
+  std::uint64_t sequence;
+  {
+    std::shared_lock structure(structure_mutex);
+    sequence = deposit_locked(account, owner_fingerprint, amount);
+  }
+  commit(sequence);
+  return true;
+}
+
+bool ConcurrentBank::withdraw(Account& account, const std::string& owner_fingerprint, double amount) {
+  std::uint64_t sequence;
+  {
+    std::shared_lock structure(structure_mutex);
+    sequence = withdraw_locked(account, owner_fingerprint, amount);
+  }
+  commit(sequence);
+  return true;
+}
+
+bool ConcurrentBank::transfer(Account& source, Account& destination, const std::string& owner_fingerprint,
+                              const std::string& CVV2, const std::string& password,
+                              const std::string& exp_date, double amount) {
+  StageUse after(*this);
+  TransferEvent event{};
+  std::uint64_t sequence;
+  {
+    std::shared_lock structure(structure_mutex);
+    sequence = transfer_locked(source, destination, owner_fingerprint, CVV2, password, exp_date, amount,
+                               after.get() ? &event : nullptr);
+  }
+  commit(sequence);
+  if (after.get())
+    after.get()->on_transfer(event);
+  return true;
+}
+
+bool ConcurrentBank::credit(Account& destination, double amount, std::string bank_fingerprint) {
+  std::uint64_t sequence;
+  {
+    std::shared_lock structure(structure_mutex);
+    if (!accepts(destination))
+      throw std::invalid_argument("destination account refused the transfer.");
+    sequence = credit_locked(destination, bank_fingerprint, amount);
+  }
+  commit(sequence);
+  return true;
+}
+
+bool ConcurrentBank::refund(Account& account, double amount, std::string bank_fingerprint) {
+  std::uint64_t sequence;
+  {
+    std::shared_lock structure(structure_mutex);
+    if (!index.number_of(&account))
+      throw std::invalid_argument("account is not in this bank.");
+    sequence = credit_locked(account, bank_fingerprint, amount);
+  }
+  commit(sequence);
+  return true;
+}
+
+bool ConcurrentBank::accepts_transfers(const Account& destination) {
+  std::shared_lock structure(structure_mutex);
+  return accepts(destination);
+}
+
+SessionToken ConcurrentBank::open_session(const Person& person, const std::string& owner_fingerprint) {
+  std::unique_lock lock(structure_mutex);
+  return sessions.open(person, owner_fingerprint);
+}
+
+bool ConcurrentBank::close_session(const SessionToken& session) {
+  std::unique_lock lock(structure_mutex);
+  return sessions.close(session);
+}
+
+bool ConcurrentBank::deposit(Account& account, const SessionToken& session, double amount) {
+  std::uint64_t sequence;
+  {
+    // Sessions only close under the exclusive lock, the fingerprint stays put while this one is held
+    std::shared_lock structure(structure_mutex);
+    const auto& fingerprint = sessions.authenticate(session, *account.get_owner());
+    VerifiedFingerprint verified(*account.get_owner(), fingerprint);
+    sequence = deposit_locked(account, fingerprint, amount);
+  }
+  commit(sequence);
+  return true;
+}
+
+bool ConcurrentBank::withdraw(Account& account, const SessionToken& session, double amount) {
+  std::uint64_t sequence;
+  {
+    std::shared_lock structure(structure_mutex);
+    const auto& fingerprint = sessions.authenticate(session, *account.get_owner());
+    VerifiedFingerprint verified(*account.get_owner(), fingerprint);
+    sequence = withdraw_locked(account, fingerprint, amount);
+  }
+  commit(sequence);
+  return true;
+}
+
+bool ConcurrentBank::transfer(Account& source, Account& destination, const SessionToken& session,
+                              const std::string& CVV2, const std::string& password,
+                              const std::string& exp_date, double amount) {
+  StageUse after(*this);
+  TransferEvent event{};
+  std::uint64_t sequence;
+  {
+    std::shared_lock structure(structure_mutex);
+    const auto& fingerprint = sessions.authenticate(session, *source.get_owner());
+    VerifiedFingerprint verified(*source.get_owner(), fingerprint);
+    sequence = transfer_locked(source, destination, fingerprint, CVV2, password, exp_date, amount,
+                               after.get() ? &event : nullptr);
+  }
+  commit(sequence);
+  if (after.get())
+    after.get()->on_transfer(event);
+  return true;
+}
+
+bool ConcurrentBank::take_loan(Account& account, const SessionToken& session, double amount) {
+  std::uint64_t sequence = 0;
+  {
+    std::unique_lock lock(structure_mutex);
+    const auto& fingerprint = sessions.authenticate(session, *account.get_owner());
+    VerifiedFingerprint verified(*account.get_owner(), fingerprint);
+    columns.set_loans(nullptr);
+    bank.take_loan(account, fingerprint, amount);
+    record(LedgerEntryType::TakeLoan, account, nullptr, amount);
+    if (journal)
+      sequence = journal->log_take_loan(account, amount);
+  }
+  commit(sequence);
+  return true;
+}
+
+BatchResult ConcurrentBank::submit(const std::vector<BatchOperation>& operations, BatchMode mode) {
+  auto start = std::chrono::steady_clock::now();
+  BatchResult result;
+  result.statuses.assign(operations.size(), BatchStatus::Applied);
+
+  // A fingerprint or card that matched once is compared as a string afterwards, not hashed again
+  std::unordered_map<const Person*, const std::string*> owners;
+  std::unordered_map<const Account*, const BatchOperation*> cards;
+  auto authorized = [&](const BatchOperation& operation) {
+    const Person* owner = operation.account->get_owner();
+    auto& known = owners.try_emplace(owner, nullptr).first->second;
+    if (!known || *known != operation.owner_fingerprint) {
+      if (owner->get_hashed_fingerprint() != Hash(operation.owner_fingerprint))
+        return false;
+      known = &operation.owner_fingerprint;
+    }
+    if (operation.type != BatchOperationType::Transfer)
+      return true;
+
+    auto& card = cards.try_emplace(operation.account, nullptr).first->second;
+    if (card && card->CVV2 == operation.CVV2 && card->password == operation.password &&
+        card->exp_date == operation.exp_date)
+      return true;
+    // The fingerprint matched above, the getters need not hash it again
+    VerifiedFingerprint verified(*owner, operation.owner_fingerprint);
+    if (operation.account->get_CVV2(operation.owner_fingerprint) != operation.CVV2 ||
+        !password_matches(operation.account->get_password(operation.owner_fingerprint), operation.password) ||
+        operation.account->get_exp_date(operation.owner_fingerprint) != operation.exp_date)
+      return false;
+    card = &operation;
+    return true;
+  };
+
+  auto deliverable = [&](const BatchOperation& operation) {
+    return operation.type != BatchOperationType::Transfer || (operation.destination && accepts(*operation.destination));
+  };
+
+  // Why the Bank turned down an operation that passed the checks above: they are made again
+  // without what was cached, and a balance that changed under the operation is left over
+  auto refusal = [&](const BatchOperation& operation) {
+    owners.erase(operation.account->get_owner());
+    cards.erase(operation.account);
+    if (!authorized(operation))
+      return BatchStatus::BadCredentials;
+    if (!deliverable(operation))
+      return BatchStatus::BadDestination;
+    return BatchStatus::InsufficientFunds;
+  };
+
+  std::uint64_t sequence = 0;
+  StageUse stage_use(*this);
+  auto* after = stage_use.get();
+  std::vector<TransferEvent> transfers; // for the commit stage once the batch is durable
+  // `steps` counts what's done of the operation: the Bank, the columns, the ledger, the journal
+  auto apply = [&](const BatchOperation& operation, int& steps) {
+    // authorized() already checked it
+    VerifiedFingerprint verified(*operation.account->get_owner(), operation.owner_fingerprint);
+    auto amount = Money::from_double(operation.amount);
+    switch (operation.type) {
+    case BatchOperationType::Deposit:
+      bank.deposit(*operation.account, operation.owner_fingerprint, operation.amount);
+      ++steps;
+      columns.add_balance(operation.account, amount);
+      ++steps;
+      record(LedgerEntryType::Deposit, *operation.account, nullptr, operation.amount);
+      ++steps;
+      if (journal)
+        sequence = journal->log_deposit(*operation.account, operation.amount);
+      ++steps;
+      break;
+    case BatchOperationType::Withdraw:
+      bank.withdraw(*operation.account, operation.owner_fingerprint, operation.amount);
+      ++steps;
+      columns.add_balance(operation.account, -amount);
+      ++steps;
+      record(LedgerEntryType::Withdraw, *operation.account, nullptr, operation.amount);
+      ++steps;
+      if (journal)
+        sequence = journal->log_withdraw(*operation.account, operation.amount);
+      ++steps;
+      break;
+    case BatchOperationType::Transfer:
+      bank.transfer(*operation.account, *operation.destination, operation.owner_fingerprint,
+                    operation.CVV2, operation.password, operation.exp_date, operation.amount);
+      ++steps;
+      columns.move_balance(operation.account, operation.destination, amount);
+      ++steps;
+      record(LedgerEntryType::Transfer, *operation.account, operation.destination, operation.amount);
+      ++steps;
+      if (journal)
+        sequence = journal->log_transfer(*operation.account, *operation.destination, operation.amount);
+      ++steps;
+      if (after)
+        transfers.push_back(transfer_event(*operation.account, *operation.destination, operation.amount));
+      break;
+    }
+  };
+
+  // Takes back the first `steps` steps of apply(). The money moves the other way as operations of
+  // their own, so the ledger and the journal keep what happened and a replay ends up where this did.
+  // A transfer is undone by a withdrawal and a deposit, the card of its destination isn't known.
+  auto undo = [&](const BatchOperation& operation, int steps) {
+    auto amount = Money::from_double(operation.amount);
+    auto* source = operation.account;
+    auto* target = operation.type == BatchOperationType::Transfer ? operation.destination : nullptr;
+    bool credited = operation.type == BatchOperationType::Deposit;
+    if (steps >= 1) {
+      if (target) {
+        // The destination's owner isn't the caller, the money only goes back where it came from
+        const std::string trusted;
+        VerifiedFingerprint verified(*target->get_owner(), trusted);
+        bank.withdraw(*target, trusted, operation.amount);
+      }
+      VerifiedFingerprint verified(*source->get_owner(), operation.owner_fingerprint);
+      if (credited)
+        bank.withdraw(*source, operation.owner_fingerprint, operation.amount);
+      else
+        bank.deposit(*source, operation.owner_fingerprint, operation.amount);
+    }
+    if (steps >= 2) {
+      if (target)
+        columns.move_balance(target, source, amount);
+      else
+        columns.add_balance(source, credited ? -amount : amount);
+    }
+    if (steps >= 3) {
+      if (target)
+        record(LedgerEntryType::Transfer, *target, source, operation.amount);
+      else
+        record(credited ? LedgerEntryType::Withdraw : LedgerEntryType::Deposit, *source, nullptr, operation.amount);
+    }
+    if (steps >= 4 && journal) {
+      if (target)
+        journal->log_withdraw(*target, operation.amount);
+      sequence = credited ? journal->log_withdraw(*source, operation.amount) : journal->log_deposit(*source, operation.amount);
+    }
+  };
+
+  if (mode == BatchMode::Atomic) {
+    std::unique_lock lock(structure_mutex);
+
+    // Dry run on copies of the balances in submission order, so an operation may spend what an
+    // earlier one brought in. Nothing else can change them while the lock is held.
+    std::unordered_map<const Account*, Money> balances;
+    auto balance_of = [&](const Account* account) -> Money& {
+      auto [entry, inserted] = balances.try_emplace(account);
+      if (inserted)
+        entry->second = Money::from_double(account->get_balance());
+      return entry->second;
+    };
+    bool valid = true;
+    for (size_t i = 0; i < operations.size(); ++i) {
+      const auto& operation = operations[i];
+      if (!authorized(operation)) {
+        result.statuses[i] = BatchStatus::BadCredentials;
+        valid = false;
+        continue;
+      }
+      if (!deliverable(operation)) {
+        result.statuses[i] = BatchStatus::BadDestination;
+        valid = false;
+        continue;
+      }
+      auto amount = Money::from_double(operation.amount);
+      auto& source = balance_of(operation.account);
+      if (operation.type == BatchOperationType::Deposit) {
+        source += amount;
+        continue;
+      }
+      if (source < amount) {
+        result.statuses[i] = BatchStatus::InsufficientFunds;
+        valid = false;
+        continue;
+      }
+      source -= amount;
+      if (operation.type == BatchOperationType::Transfer)
+        balance_of(operation.destination) += amount;
+    }
+
+    if (valid) {
+      // The dry run checked everything Bank could refuse. Should anything still fail, what was
+      // applied is undone in reverse before the batch reports it, or passes the error on.
+      size_t current = 0;
+      int steps = 0;
+      auto roll_back = [&] {
+        undo(operations[current], steps);
+        for (size_t i = current; i-- > 0;)
+          undo(operations[i], 4);
+        transfers.clear();
+        for (auto& status : result.statuses)
+          status = BatchStatus::Aborted;
+      };
+      try {
+        for (; current < operations.size(); ++current) {
+          steps = 0;
+          apply(operations[current], steps);
+        }
+      } catch (const std::invalid_argument&) {
+        roll_back();
+        result.statuses[current] = refusal(operations[current]);
+      } catch (...) {
+        roll_back();
+        commit(sequence);
+        throw;
+      }
+    } else {
+      for (auto& status : result.statuses)
+        if (status == BatchStatus::Applied)
+          status = BatchStatus::Aborted;
+    }
+  } else {
+    std::shared_lock structure(structure_mutex);
+    for (size_t i = 0; i < operations.size(); ++i) {
+      const auto& operation = operations[i];
+      if (!authorized(operation)) {
+        result.statuses[i] = BatchStatus::BadCredentials;
+        continue;
+      }
+      if (!deliverable(operation)) {
+        result.statuses[i] = BatchStatus::BadDestination;
+        continue;
+      }
+      auto* destination = operation.type == BatchOperationType::Transfer ? operation.destination : operation.account;
+      try {
+        int steps = 0;
+        with_stripes(operation.account, destination, [&] { apply(operation, steps); });
+      } catch (const std::invalid_argument&) {
+        result.statuses[i] = refusal(operation);
+      }
+    }
+  }
+  // One durability wait for the whole batch
+  commit(sequence);
+  for (const auto& transfer : transfers)
+    after->on_transfer(transfer);
+
+  for (auto status : result.statuses)
+    (status == BatchStatus::Applied ? result.applied : result.failed)++;
+  result.elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+  return result;
+}
+
+Account* ConcurrentBank::find_account(std::uint64_t account_number) {
+  std::shared_lock structure(structure_mutex);
+  return index.find(account_number);
+}
+
+Account* ConcurrentBank::find_account(const std::string& account_number) {
+  auto number = AccountIndex::parse(account_number);
+  return number ? find_account(*number) : nullptr;
+}
+
+void ConcurrentBank::reindex(std::string bank_fingerprint) {
+  std::unique_lock lock(structure_mutex);
+  ++structure_version;
+  index.clear();
+  columns.clear();
+  for (auto* account : bank.get_bank_accounts(bank_fingerprint)) {
+    index.insert(account);
+    columns.insert(account, owner_ids.intern(account->get_owner()));
+  }
+}
+
+AccountColumns::View ConcurrentBank::read_view() {
+  // Shared: accounts and owners stay put, and the columns keep each transfer whole
+  std::shared_lock lock(structure_mutex);
+  return columns.view();
+}
+
+AccountColumns::View ConcurrentBank::read_view(std::string bank_fingerprint) {
+  // Loans only change under the exclusive lock, the book is built while views are held off,
+  // which also keeps owner_ids to one reader at a time
+  std::shared_lock lock(structure_mutex);
+  return columns.view([&] {
+    auto book = std::make_shared<LoanBook>();
+    const auto& paid = bank.get_customer_2_paid_loan_map(bank_fingerprint);
+    for (const auto& [customer, unpaid] : bank.get_customer_2_unpaid_loan_map(bank_fingerprint)) {
+      auto repaid = paid.find(customer);
+      book->customers.push_back({owner_ids.intern(customer),
+                                 repaid != paid.end() ? Money::from_double(repaid->second) : Money(),
+                                 Money::from_double(unpaid)});
+    }
+    std::sort(book->customers.begin(), book->customers.end(),
+              [](const CustomerLoan& a, const CustomerLoan& b) { return a.owner < b.owner; });
+    book->total_balance = Money::from_double(bank.get_bank_total_balance(bank_fingerprint));
+    book->total_loan = Money::from_double(bank.get_bank_total_loan(bank_fingerprint));
+    return std::shared_ptr<const LoanBook>(std::move(book));
+  });
+}
+
+Money ConcurrentBank::total_balance() {
+  return read_view().sum();
+}
+
+StatusCounts ConcurrentBank::count_by_status() {
+  return read_view().count_by_status();
+}
+
+std::vector<size_t> ConcurrentBank::balance_histogram(Money width, size_t buckets) {
+  return read_view().histogram(width, buckets);
+}
+
+bool ConcurrentBank::take_loan(Account& account, const std::string& owner_fingerprint, double amount) {
+  std::uint64_t sequence = 0;
+  {
+    // Eligibility sums the balances of every account of the owner
+    std::unique_lock lock(structure_mutex);
+    columns.set_loans(nullptr);
+    bank.take_loan(account, owner_fingerprint, amount);
+    record(LedgerEntryType::TakeLoan, account, nullptr, amount);
+    if (journal)
+      sequence = journal->log_take_loan(account, amount);
+  }
+  commit(sequence);
+  return true;
+}
+
+bool ConcurrentBank::pay_loan(Account& account, double amount) {
+  std::uint64_t sequence = 0;
+  {
+    // The loan maps rehash and gain entries, like take_loan this needs the Bank alone
+    std::unique_lock lock(structure_mutex);
+    columns.set_loans(nullptr);
+    bank.pay_loan(account, amount);
+    record(LedgerEntryType::PayLoan, account, nullptr, amount);
+    if (journal)
+      sequence = journal->log_pay_loan(account, amount);
+  }
+  commit(sequence);
+  return true;
+}
+
+EndOfDayReport ConcurrentBank::end_of_day(const EndOfDayPolicy& policy, std::string bank_fingerprint) {
+  EndOfDayReport report;
+  std::uint64_t sequence = 0;
+  {
+    std::unique_lock structure(structure_mutex);
+    columns.set_loans(nullptr);
+    report = EndOfDay::run(bank, bank_fingerprint, policy);
+    if (journal)
+      sequence = journal->log_end_of_day(policy.daily_rate);
+  }
+  commit(sequence);
+  return report;
+}
+
+SnapshotStats ConcurrentBank::snapshot(const std::string& path, std::string bank_fingerprint) {
+  if (!journal)
+    throw std::invalid_argument("Snapshots need a journaled bank.");
+
+  SnapshotCapture capture;
+  std::chrono::microseconds pause{0};
+  // A capture that loses the race with structural changes this often holds the lock throughout
+  constexpr size_t ATTEMPTS = 4;
+  for (size_t attempt = 1;; ++attempt) {
+    bool throughout = attempt == ATTEMPTS;
+    capture = SnapshotCapture();
+    AccountColumns::View view;
+    std::uint64_t version;
+    std::unique_lock lock(structure_mutex);
+    auto start = std::chrono::steady_clock::now();
+    {
+      if (columns.size() != bank.get_bank_accounts(bank_fingerprint).size())
+        throw std::invalid_argument("Snapshots need every account in the index, reindex first.");
+      view = columns.view();
+      version = structure_version;
+
+      const auto& paid = bank.get_customer_2_paid_loan_map(bank_fingerprint);
+      const auto& unpaid = bank.get_customer_2_unpaid_loan_map(bank_fingerprint);
+      const auto& customers = bank.get_bank_customers(bank_fingerprint);
+      capture.customers.reserve(customers.size());
+      for (const auto* customer : customers) {
+        auto owes = unpaid.find(const_cast<Person*>(customer));
+        auto repaid = paid.find(const_cast<Person*>(customer));
+        capture.customers.push_back({journal->customer_id(*customer), customer->get_name(), customer->get_gender(),
+                                     customer->get_age(), customer->get_hashed_fingerprint(),
+                                     customer->get_socioeconomic_rank(), customer->get_is_alive(), owes != unpaid.end(),
+                                     repaid != paid.end() ? repaid->second : 0.0, owes != unpaid.end() ? owes->second : 0.0});
+      }
+
+      capture.total_balance = bank.get_bank_total_balance(bank_fingerprint);
+      capture.total_loan = bank.get_bank_total_loan(bank_fingerprint);
+      capture.journal_offset = journal->end_offset();
+      capture.customer_ids_end = journal->customer_ids_end();
+      capture.account_ids_end = journal->account_ids_end();
+    }
+    if (!throughout) {
+      pause += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+      lock.unlock();
+    }
+
+    // Balances, statuses and numbers as of the view, nothing in it changes any more
+    capture.accounts.reserve(view.size());
+    view.for_each([&](const AccountRow& row) {
+      capture.accounts.push_back({row.account, row.account_number, row.balance.to_double(), row.status});
+    });
+
+    bool complete = true;
+    for (size_t begin = 0; begin < capture.accounts.size(); begin += SNAPSHOT_CHUNK) {
+      std::shared_lock chunk(structure_mutex, std::defer_lock);
+      if (!throughout)
+        chunk.lock();
+      if (structure_version != version) {
+        complete = false;
+        break;
+      }
+      capture_cards(capture, begin, std::min(capture.accounts.size(), begin + SNAPSHOT_CHUNK));
+    }
+    if (throughout)
+      pause += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    if (complete)
+      break;
+  }
+
+  // Recovery replays the journal from journal_offset, it has to reach the disk first
+  journal->flush();
+  auto stats = write_snapshot(path, capture);
+  stats.pause = pause;
+  return stats;
+}
+
+void ConcurrentBank::capture_cards(SnapshotCapture& capture, size_t begin, size_t end) {
+  // The bank fingerprint was checked when the capture began, the cards are read without the owners' secrets
+  const std::string trusted;
+  for (size_t i = begin; i < end; ++i) {
+    auto& copy = capture.accounts[i];
+    const auto* owner = copy.account->get_owner();
+    VerifiedFingerprint verified(*owner, trusted);
+    copy.id = journal->account_id(*copy.account);
+    copy.owner = journal->customer_id(*owner);
+    copy.CVV2 = copy.account->get_CVV2(trusted);
+    copy.password = copy.account->get_password(trusted);
+    copy.exp_date = copy.account->get_exp_date(trusted);
+  }
+}
+
+void ConcurrentBank::set_commit_stage(CommitStage* stage) {
+  std::lock_guard lock(stage_mutex);
+  // Sequentially consistent: a call that counted itself in the old epoch after the wait below
+  // read zero is bound to load the new stage
+  this->stage.store(stage);
+  auto old = stage_epoch.fetch_add(1) & 1;
+  while (stage_users[old].load() != 0)
+    std::this_thread::yield();
+}
+
+ConcurrentBank::StageUse::StageUse(ConcurrentBank& bank) {
+  // Nothing attached, most calls stop here; a stage attached meanwhile sees later transfers
+  if (!bank.stage.load(std::memory_order_relaxed))
+    return;
+  for (;;) {
+    auto epoch = bank.stage_epoch.load();
+    users = &bank.stage_users[epoch & 1];
+    users->fetch_add(1);
+    // Counted before the epoch moved on, the set_commit_stage that moves it waits for this call
+    if (bank.stage_epoch.load() == epoch)
+      break;
+    users->fetch_sub(1);
+  }
+  stage = bank.stage.load();
+}
+
+ConcurrentBank::StageUse::~StageUse() {
+  if (users)
+    users->fetch_sub(1, std::memory_order_release);
+}
+
+CommitStage* ConcurrentBank::StageUse::get() const {
+  return stage;
+}
+
+Bank& ConcurrentBank::get_bank() {
+  return bank;
+}
+
+std::mutex& ConcurrentBank::stripe_of(const Account* account) {
+  // Accounts are heap objects, the low bits of their address carry no information
+  auto address = reinterpret_cast<std::uintptr_t>(account);
+  return stripes[(address >> 6) & (STRIPES - 1)].mutex;
+}
+
+std::uint64_t ConcurrentBank::deposit_locked(Account& account, const std::string& owner_fingerprint, double amount) {
+  // Bank::deposit is a single compare-and-swap on the balance, no stripe needed
+  if (!journal) {
+    bank.deposit(account, owner_fingerprint, amount);
+    columns.add_balance(&account, Money::from_double(amount));
+    record(LedgerEntryType::Deposit, account, nullptr, amount);
+    return 0;
+  }
+
+  // but the journal must see the changes of one account in the order they were applied
+  std::lock_guard lock(stripe_of(&account));
+  bank.deposit(account, owner_fingerprint, amount);
+  columns.add_balance(&account, Money::from_double(amount));
+  record(LedgerEntryType::Deposit, account, nullptr, amount);
+  return journal->log_deposit(account, amount);
+}
+
+std::uint64_t ConcurrentBank::withdraw_locked(Account& account, const std::string& owner_fingerprint, double amount) {
+  if (!journal) {
+    bank.withdraw(account, owner_fingerprint, amount);
+    columns.add_balance(&account, -Money::from_double(amount));
+    record(LedgerEntryType::Withdraw, account, nullptr, amount);
+    return 0;
+  }
+
+  std::lock_guard lock(stripe_of(&account));
+  bank.withdraw(account, owner_fingerprint, amount);
+  columns.add_balance(&account, -Money::from_double(amount));
+  record(LedgerEntryType::Withdraw, account, nullptr, amount);
+  return journal->log_withdraw(account, amount);
+}
+
+std::uint64_t ConcurrentBank::credit_locked(Account& account, std::string& bank_fingerprint, double amount) {
+  // Journaled as a deposit, which is what it does to the account
+  std::lock_guard lock(stripe_of(&account));
+  bank.credit(account, amount, bank_fingerprint);
+  columns.add_balance(&account, Money::from_double(amount));
+  record(LedgerEntryType::Deposit, account, nullptr, amount);
+  return journal ? journal->log_deposit(account, amount) : 0;
+}
+
+std::uint64_t ConcurrentBank::transfer_locked(Account& source, Account& destination, const std::string& owner_fingerprint,
+                                              const std::string& CVV2, const std::string& password,
+                                              const std::string& exp_date, double amount, TransferEvent* event) {
+  if (!accepts(destination))
+    throw std::invalid_argument("destination account refused the transfer.");
+  std::uint64_t sequence = 0;
+  with_stripes(&source, &destination, [&] {
+    bank.transfer(source, destination, owner_fingerprint, CVV2, password, exp_date, amount);
+    columns.move_balance(&source, &destination, Money::from_double(amount));
+    record(LedgerEntryType::Transfer, source, &destination, amount);
+    if (journal)
+      sequence = journal->log_transfer(source, destination, amount);
+    if (event)
+      *event = transfer_event(source, destination, amount);
+  });
+  return sequence;
+}
+
+bool ConcurrentBank::accepts(const Account& destination) const {
+  // The index answers by address, the account is only read once it's known to be alive
+  return index.number_of(&destination) && destination.get_status();
+}
+
+void ConcurrentBank::record(LedgerEntryType type, const Account& account, const Account* counterparty, double amount) {
+  if (!ledger)
+    return;
+  auto number = AccountIndex::parse(account.get_account_number()).value_or(0);
+  auto other = counterparty ? AccountIndex::parse(counterparty->get_account_number()).value_or(0) : 0;
+  ledger->append(type, number, other, Money::from_double(amount));
+}
+
+TransferEvent ConcurrentBank::transfer_event(const Account& source, const Account& destination, double amount) {
+  return TransferEvent{AccountIndex::parse(source.get_account_number()).value_or(0),
+                       AccountIndex::parse(destination.get_account_number()).value_or(0), Money::from_double(amount)};
+}
+
+void ConcurrentBank::commit(std::uint64_t sequence) {
+  // Waits outside every lock, so the fsync of one batch covers many callers
+  if (journal && sequence != 0)
+    journal->wait_durable(sequence);
+}
@@ -0,0 +1,102 @@
+#include "EndOfDay.h"
+#include "Bank.h"
+#include "Person.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace {
+constexpr size_t MAX_RANK = 10; // Person::set_socioeconomic_rank refuses anything higher
+}
+
+EndOfDayReport EndOfDay::run(Bank& bank, std::string bank_fingerprint, const EndOfDayPolicy& policy) {
+  auto start = std::chrono::steady_clock::now();
+  const auto& customers = bank.get_bank_customers(bank_fingerprint);
+  const auto& accounts = bank.get_customer_2_accounts_map(bank_fingerprint);
+  const auto& paid = bank.get_customer_2_paid_loan_map(bank_fingerprint);
+  const auto& unpaid = bank.get_customer_2_unpaid_loan_map(bank_fingerprint);
+
+  size_t threads = policy.threads ? policy.threads : std::max(1u, std::thread::hardware_concurrency());
+  size_t partitions = policy.partitions ? policy.partitions : 4 * threads;
+  partitions = std::max<size_t>(1, std::min(partitions, customers.size()));
+  threads = std::min(threads, partitions);
+
+  EndOfDayReport report;
+  report.customers = customers.size();
+  report.partitions.resize(partitions);
+  for (size_t i = 0; i < partitions; ++i) {
+    report.partitions[i].first = i * customers.size() / partitions;
+    report.partitions[i].customers = (i + 1) * customers.size() / partitions - report.partitions[i].first;
+  }
+
+  // Workers only read the maps and write their own customers' entries, never insert
+  auto process = [&](PartitionReport& partition) {
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = partition.first; i < partition.first + partition.customers; ++i) {
+      Person* customer = customers[i];
+      auto held = accounts.find(customer);
+      if (held == accounts.end() || held->second.empty())
+        continue;
+
+      auto loan = unpaid.find(customer);
+      if (loan != unpaid.end() && Money::from_double(loan->second) > Money()) {
+        auto interest = Money::from_double(loan->second * policy.daily_rate);
+        if (interest > Money()) {
+          bank.accrue_interest(*held->second.front(), interest.to_double(), bank_fingerprint);
+          partition.interest += interest;
+          partition.accrued++;
+        }
+      }
+
+      auto repaid = paid.find(customer);
+      if (repaid == paid.end())
+        continue;
+      size_t rank = customer->get_socioeconomic_rank();
+      size_t promoted = rank;
+      while (promoted < MAX_RANK && repaid->second > pow(10, promoted))
+        promoted++;
+      if (promoted != rank) {
+        customer->set_socioeconomic_rank(promoted);
+        partition.promoted++;
+      }
+    }
+    partition.elapsed = std::chrono::steady_clock::now() - begin;
+  };
+
+  std::atomic<size_t> next{0};
+  std::mutex failure_mutex;
+  std::exception_ptr failure;
+  auto work = [&](size_t worker) {
+    try {
+      for (size_t i = next.fetch_add(1); i < partitions; i = next.fetch_add(1)) {
+        report.partitions[i].worker = worker;
+        process(report.partitions[i]);
+      }
+    } catch (...) {
+      std::lock_guard lock(failure_mutex);
+      if (!failure)
+        failure = std::current_exception();
+      next = partitions;
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (size_t worker = 1; worker < threads; ++worker)
+    pool.emplace_back(work, worker);
+  work(0);
+  for (auto& thread : pool)
+    thread.join();
+  if (failure)
+    std::rethrow_exception(failure);
+
+  for (const auto& partition : report.partitions) {
+    report.accrued += partition.accrued;
+    report.promoted += partition.promoted;
+    report.interest += partition.interest;
+  }
+  report.elapsed = std::chrono::steady_clock::now() - start;
+  return report;
+}
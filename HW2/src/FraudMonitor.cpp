@@ -0,0 +1,160 @@
+#include "FraudMonitor.h"
+#include <algorithm>
+#include <numeric>
+
+namespace {
+std::uint64_t mix(std::uint64_t value) {
+  // splitmix64 finalizer, account numbers are far from uniform in their low bits
+  value += 0x9e3779b97f4a7c15ULL;
+  value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+  return value ^ (value >> 31);
+}
+
+std::int64_t milliseconds_of(std::chrono::system_clock::time_point time) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+}
+}
+
+FraudMonitor::FraudMonitor(FraudRules rules, AlertHandler on_alert, Clock clock) :
+    rules(rules),
+    on_alert(std::move(on_alert)),
+    clock(std::move(clock)),
+    queue(rules.queue_capacity),
+    sketch(SKETCH_DEPTH * SKETCH_WIDTH, 0) {
+  this->rules.window = std::max(this->rules.window, std::chrono::milliseconds(static_cast<std::int64_t>(WINDOW_SLICES)));
+  worker = std::thread(&FraudMonitor::run, this);
+}
+
+FraudMonitor::~FraudMonitor() {
+  stopping.store(true, std::memory_order_release);
+  worker.join();
+}
+
+void FraudMonitor::on_transfer(const TransferEvent& event) noexcept {
+  // Never waits: a full queue costs the event, not the transfer
+  if (queue.try_push(Event{event, clock()}))
+    received.fetch_add(1, std::memory_order_release);
+  else
+    dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+void FraudMonitor::drain() {
+  auto target = received.load(std::memory_order_acquire);
+  while (processed.load(std::memory_order_acquire) < target)
+    std::this_thread::yield();
+}
+
+FraudStats FraudMonitor::stats() const {
+  return FraudStats{received.load(std::memory_order_acquire), dropped.load(std::memory_order_relaxed),
+                    processed.load(std::memory_order_acquire), alerts.load(std::memory_order_relaxed)};
+}
+
+void FraudMonitor::run() {
+  size_t idle = 0;
+  Event event;
+  for (;;) {
+    bool stop = stopping.load(std::memory_order_acquire);
+    bool any = false;
+    while (queue.try_pop(event)) {
+      process(event);
+      processed.fetch_add(1, std::memory_order_release);
+      any = true;
+    }
+    if (stop)
+      return;
+    // Spins a little while transfers are flowing, then backs off so an idle bank costs no CPU
+    if (any)
+      idle = 0;
+    else if (++idle < 64)
+      std::this_thread::yield();
+    else
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+}
+
+void FraudMonitor::process(const Event& event) {
+  auto now = milliseconds_of(event.time);
+  auto slice_length = rules.window.count() / static_cast<std::int64_t>(WINDOW_SLICES);
+  std::int64_t slice = now / slice_length;
+  const auto slices = static_cast<std::int64_t>(WINDOW_SLICES);
+
+  // Slide the account's window up to this event, slices that fell out start over
+  auto& window = windows[event.transfer.source];
+  if (window.newest >= 0 && slice <= window.newest - slices)
+    return; // older than anything the window still holds
+  for (auto s = std::max(window.newest + 1, slice - slices + 1); s <= slice; ++s) {
+    window.counts[static_cast<size_t>(s % slices)] = 0;
+    window.amounts[static_cast<size_t>(s % slices)] = Money();
+  }
+  window.newest = std::max(window.newest, slice);
+  window.counts[static_cast<size_t>(slice % slices)]++;
+  window.amounts[static_cast<size_t>(slice % slices)] += event.transfer.amount;
+
+  std::uint64_t transfers = std::accumulate(window.counts.begin(), window.counts.end(), std::uint64_t{0});
+  Money amount = std::accumulate(window.amounts.begin(), window.amounts.end(), Money());
+  if (transfers > rules.max_transfers) {
+    if (!window.bursting)
+      raise(FraudAlertType::Burst, event.transfer.source, transfers, amount, event.time);
+    window.bursting = true;
+  } else {
+    window.bursting = false;
+  }
+  if (amount > rules.max_amount) {
+    if (!window.over_amount)
+      raise(FraudAlertType::Amount, event.transfer.source, transfers, amount, event.time);
+    window.over_amount = true;
+  } else {
+    window.over_amount = false;
+  }
+
+  // The sketch covers whole windows, it starts over when a new one begins
+  std::int64_t epoch = now / rules.window.count();
+  if (epoch > sketch_epoch) {
+    std::fill(sketch.begin(), sketch.end(), 0);
+    sketch_epoch = epoch;
+    sketch_total = 0;
+    heavy_hitters.clear();
+  }
+  if (epoch == sketch_epoch) {
+    auto estimate = sketch_add(event.transfer.source);
+    sketch_total++;
+    if (sketch_total >= rules.heavy_hitter_minimum &&
+        static_cast<double>(estimate) > rules.heavy_hitter_share * static_cast<double>(sketch_total) &&
+        heavy_hitters.insert(event.transfer.source).second)
+      raise(FraudAlertType::HeavyHitter, event.transfer.source, estimate, amount, event.time);
+  }
+
+  // Accounts that went quiet for a whole window are forgotten, so memory follows the active ones
+  if (slice - last_sweep >= slices) {
+    std::erase_if(windows, [&](const auto& entry) { return entry.second.newest <= slice - slices; });
+    last_sweep = slice;
+  }
+}
+
+void FraudMonitor::raise(FraudAlertType type, std::uint64_t account, std::uint64_t transfers, Money amount,
+                         std::chrono::system_clock::time_point time) {
+  alerts.fetch_add(1, std::memory_order_relaxed);
+  if (!on_alert)
+    return;
+  // A throwing handler must not take the monitor thread down with it
+  try {
+    on_alert(FraudAlert{type, account, transfers, amount, time});
+  } catch (...) {
+  }
+}
+
+std::uint64_t FraudMonitor::sketch_add(std::uint64_t account) {
+  std::uint64_t estimate = UINT64_MAX;
+  std::uint64_t hash = mix(account);
+  for (size_t row = 0; row < SKETCH_DEPTH; ++row) {
+    // Each row takes its own bits of one 64-bit hash, remixed when they run out
+    if (row == 2)
+      hash = mix(hash);
+    auto column = static_cast<size_t>((row % 2 ? hash >> 32 : hash) & (SKETCH_WIDTH - 1));
+    auto& counter = sketch[row * SKETCH_WIDTH + column];
+    counter++;
+    estimate = std::min<std::uint64_t>(estimate, counter);
+  }
+  return estimate;
+}
@@ -0,0 +1,541 @@
+#include "Journal.h"
+#include "Bank.h"
+#include "Account.h"
+#include "AccountIndex.h"
+#include "AccountNumbers.h"
+#include "Person.h"
+#include "EndOfDay.h"
+#include "Session.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <format>
+#include <iterator>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+// File layout: MAGIC, then frames of [u32 size][u32 checksum][u8 type][payload],
+// size and checksum covering type + payload. Integers are stored in host order.
+constexpr char MAGIC[8] = {'B', 'A', 'N', 'K', 'W', 'A', 'L', '1'};
+constexpr size_t FRAME_HEADER = 2 * sizeof(std::uint32_t);
+
+enum RecordType : std::uint8_t {
+  CUSTOMER = 1,
+  CREATE_ACCOUNT,
+  DELETE_ACCOUNT,
+  DELETE_CUSTOMER,
+  DEPOSIT,
+  WITHDRAW,
+  TRANSFER,
+  TAKE_LOAN,
+  PAY_LOAN,
+  SET_OWNER,
+  END_OF_DAY,
+  SET_ACCOUNT_STATUS,
+  SET_EXP_DATE,
+};
+
+std::uint32_t checksum(const char* data, size_t size) {
+  // FNV-1a, catches torn and half-written frames
+  std::uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+class Encoder {
+public:
+  explicit Encoder(std::uint8_t type) : body(1, static_cast<char>(type)) {}
+
+  Encoder& u64(std::uint64_t value) {
+    body.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    return *this;
+  }
+  Encoder& f64(double value) { return u64(std::bit_cast<std::uint64_t>(value)); }
+  Encoder& str(const std::string& value) {
+    u64(value.size());
+    body += value;
+    return *this;
+  }
+
+  std::string frame() const {
+    std::uint32_t size = static_cast<std::uint32_t>(body.size());
+    std::uint32_t sum = checksum(body.data(), body.size());
+    std::string out(FRAME_HEADER, '\0');
+    std::memcpy(out.data(), &size, sizeof(size));
+    std::memcpy(out.data() + sizeof(size), &sum, sizeof(sum));
+    return out + body;
+  }
+
+private:
+  std::string body;
+};
+
+class Decoder {
+public:
+  Decoder(const char* data, size_t size) : data(data), size(size) {}
+
+  std::uint64_t u64() {
+    std::uint64_t value;
+    take(&value, sizeof(value));
+    return value;
+  }
+  double f64() { return std::bit_cast<double>(u64()); }
+  std::string str() {
+    std::string value(u64(), '\0');
+    take(value.data(), value.size());
+    return value;
+  }
+
+private:
+  void take(void* out, size_t count) {
+    if (count > size - offset)
+      throw std::runtime_error("journal record is shorter than its type requires");
+    std::memcpy(out, data + offset, count);
+    offset += count;
+  }
+
+  const char* data;
+  size_t size;
+  size_t offset{0};
+};
+
+void write_all(int fd, const std::string& bytes) {
+  const char* data = bytes.data();
+  size_t left = bytes.size();
+  while (left > 0) {
+    ssize_t written = ::write(fd, data, left);
+    if (written < 0)
+      throw std::runtime_error("journal write failed");
+    data += written;
+    left -= static_cast<size_t>(written);
+  }
+}
+}
+
+Journal::Journal(const std::string& path, JournalOptions options) :
+    fd(::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0600)),
+    options(options) {
+  if (fd < 0)
+    throw std::runtime_error(std::format("can't open journal {}", path));
+
+  if (::lseek(fd, 0, SEEK_END) == 0)
+    write_all(fd, std::string(MAGIC, sizeof(MAGIC)));
+  appended_bytes = static_cast<std::uint64_t>(::lseek(fd, 0, SEEK_END));
+  flusher = std::thread(&Journal::flush_loop, this);
+}
+
+Journal::Journal(const std::string& path, JournalOptions options, const JournalRecovery& resume) :
+    fd(::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0600)),
+    options(options) {
+  if (fd < 0)
+    throw std::runtime_error(std::format("can't open journal {}", path));
+
+  // Anything after the last whole record would hide the records appended from now on
+  if (::ftruncate(fd, static_cast<off_t>(resume.valid_bytes)) != 0)
+    throw std::runtime_error(std::format("can't truncate journal {}", path));
+  if (::lseek(fd, 0, SEEK_END) == 0)
+    write_all(fd, std::string(MAGIC, sizeof(MAGIC)));
+  appended_bytes = static_cast<std::uint64_t>(::lseek(fd, 0, SEEK_END));
+
+  for (const auto& customer : resume.customers) {
+    if (customer)
+      customer_ids[customer.get()] = next_customer_id;
+    ++next_customer_id;
+  }
+  account_owners = resume.owners;
+  for (const auto* account : resume.accounts) {
+    if (account) {
+      account_ids[account] = next_account_id;
+      customer_accounts[resume.owners.at(next_account_id)].push_back(account);
+    }
+    ++next_account_id;
+  }
+  flusher = std::thread(&Journal::flush_loop, this);
+}
+
+Journal::~Journal() {
+  {
+    std::lock_guard lock(mutex);
+    stopping = true;
+  }
+  work.notify_one();
+  flusher.join();
+  ::close(fd);
+}
+
+std::uint64_t Journal::log_create_account(const Account& account, const Person& owner,
+                                          const std::string& owner_fingerprint, const std::string& password) {
+  std::lock_guard lock(mutex);
+  if (!customer_ids.contains(&owner)) {
+    customer_ids[&owner] = next_customer_id++;
+    append(Encoder(CUSTOMER)
+             .str(owner.get_name())
+             .u64(owner.get_age())
+             .str(owner.get_gender())
+             .u64(owner.get_hashed_fingerprint())
+             .u64(owner.get_socioeconomic_rank())
+             .u64(owner.get_is_alive())
+             .frame());
+  }
+  auto owner_id = customer_ids.at(&owner);
+  account_ids[&account] = next_account_id++;
+  account_owners.push_back(owner_id);
+  customer_accounts[owner_id].push_back(&account);
+  // Recovery hands the account its number and card back, replaying the call alone would draw new ones
+  return append(Encoder(CREATE_ACCOUNT)
+                  .u64(owner_id)
+                  .u64(AccountIndex::parse(account.get_account_number()).value_or(0))
+                  .str(account.get_CVV2(owner_fingerprint))
+                  .u64(password_hash(password))
+                  .frame());
+}
+
+std::uint64_t Journal::log_delete_account(const Account* account) {
+  std::lock_guard lock(mutex);
+  auto id = account_ids.at(account);
+  forget_account(account, id);
+  return append(Encoder(DELETE_ACCOUNT).u64(id).frame());
+}
+
+std::uint64_t Journal::log_delete_customer(const Person& owner) {
+  std::lock_guard lock(mutex);
+  auto id = customer_ids.at(&owner);
+  customer_ids.erase(&owner);
+  // The Bank freed their accounts too, a new account in a reused slot must not inherit an id
+  if (auto owned = customer_accounts.find(id); owned != customer_accounts.end()) {
+    for (const auto* account : owned->second)
+      account_ids.erase(account);
+    customer_accounts.erase(owned);
+  }
+  return append(Encoder(DELETE_CUSTOMER).u64(id).frame());
+}
+
+std::uint64_t Journal::log_deposit(const Account& account, double amount) {
+  return account_record(DEPOSIT, account, amount);
+}
+
+std::uint64_t Journal::log_withdraw(const Account& account, double amount) {
+  return account_record(WITHDRAW, account, amount);
+}
+
+std::uint64_t Journal::log_transfer(const Account& source, const Account& destination, double amount) {
+  std::lock_guard lock(mutex);
+  return append(Encoder(TRANSFER).u64(account_ids.at(&source)).u64(account_ids.at(&destination)).f64(amount).frame());
+}
+
+std::uint64_t Journal::log_take_loan(const Account& account, double amount) {
+  return account_record(TAKE_LOAN, account, amount);
+}
+
+std::uint64_t Journal::log_pay_loan(const Account& account, double amount) {
+  return account_record(PAY_LOAN, account, amount);
+}
+
+std::uint64_t Journal::log_set_owner(const Account& account, const Person& new_owner) {
+  std::lock_guard lock(mutex);
+  auto id = account_ids.at(&account);
+  auto owner_id = customer_ids.at(&new_owner);
+  forget_account(&account, id);
+  account_ids[&account] = id;
+  account_owners[id] = owner_id;
+  customer_accounts[owner_id].push_back(&account);
+  return append(Encoder(SET_OWNER).u64(id).u64(owner_id).frame());
+}
+
+std::uint64_t Journal::log_set_account_status(const Account& account, bool status) {
+  std::lock_guard lock(mutex);
+  return append(Encoder(SET_ACCOUNT_STATUS).u64(account_ids.at(&account)).u64(status).frame());
+}
+
+std::uint64_t Journal::log_set_exp_date(const Account& account, const std::string& exp_date) {
+  std::lock_guard lock(mutex);
+  return append(Encoder(SET_EXP_DATE).u64(account_ids.at(&account)).str(exp_date).frame());
+}
+
+std::uint64_t Journal::log_end_of_day(double daily_rate) {
+  std::lock_guard lock(mutex);
+  return append(Encoder(END_OF_DAY).f64(daily_rate).frame());
+}
+
+bool Journal::knows(const Person& customer) const {
+  std::lock_guard lock(mutex);
+  return customer_ids.contains(&customer);
+}
+
+void Journal::wait_durable(std::uint64_t sequence) {
+  std::unique_lock lock(mutex);
+  durable.wait(lock, [&] { return durable_sequence >= sequence || failed; });
+  if (durable_sequence < sequence)
+    throw std::runtime_error("journal write failed");
+}
+
+void Journal::flush() {
+  std::uint64_t sequence;
+  {
+    std::lock_guard lock(mutex);
+    sequence = next_sequence - 1;
+    flush_requested = true;
+  }
+  work.notify_one();
+  wait_durable(sequence);
+}
+
+std::uint64_t Journal::customer_id(const Person& customer) const {
+  std::lock_guard lock(mutex);
+  return customer_ids.at(&customer);
+}
+
+std::uint64_t Journal::account_id(const Account& account) const {
+  std::lock_guard lock(mutex);
+  return account_ids.at(&account);
+}
+
+std::uint64_t Journal::customer_ids_end() const {
+  std::lock_guard lock(mutex);
+  return next_customer_id;
+}
+
+std::uint64_t Journal::account_ids_end() const {
+  std::lock_guard lock(mutex);
+  return next_account_id;
+}
+
+std::uint64_t Journal::end_offset() const {
+  std::lock_guard lock(mutex);
+  return appended_bytes;
+}
+
+JournalStats Journal::get_stats() const {
+  std::lock_guard lock(mutex);
+  return stats;
+}
+
+std::uint64_t Journal::append(const std::string& record) {
+  // Called with the mutex held
+  if (pending_records == 0)
+    oldest_pending = std::chrono::steady_clock::now();
+  pending += record;
+  appended_bytes += record.size();
+  // The flusher sleeps until a batch opens, then until it fills or lingered long enough
+  if (++pending_records == 1 || pending_records == options.batch_size)
+    work.notify_one();
+  return next_sequence++;
+}
+
+std::uint64_t Journal::account_record(std::uint8_t type, const Account& account, double amount) {
+  std::lock_guard lock(mutex);
+  return append(Encoder(type).u64(account_ids.at(&account)).f64(amount).frame());
+}
+
+void Journal::forget_account(const Account* account, std::uint64_t id) {
+  // Called with the mutex held
+  account_ids.erase(account);
+  auto owned = customer_accounts.find(account_owners.at(id));
+  if (owned == customer_accounts.end())
+    return;
+  auto& accounts = owned->second;
+  accounts.erase(std::remove(accounts.begin(), accounts.end(), account), accounts.end());
+  if (accounts.empty())
+    customer_accounts.erase(owned);
+}
+
+void Journal::flush_loop() {
+  std::unique_lock lock(mutex);
+  while (true) {
+    work.wait(lock, [&] { return stopping || pending_records > 0; });
+    // A partial batch lingers so that concurrent writers can share its fsync
+    work.wait_until(lock, oldest_pending + options.max_delay, [&] {
+      return stopping || flush_requested || pending_records >= options.batch_size;
+    });
+    if (pending_records == 0) {
+      if (stopping)
+        return;
+      continue;
+    }
+
+    std::string batch;
+    batch.swap(pending);
+    size_t records = pending_records;
+    std::uint64_t sequence = next_sequence - 1;
+    pending_records = 0;
+    flush_requested = false;
+
+    lock.unlock();
+    bool ok = true;
+    try {
+      write_all(fd, batch);
+      if (options.sync && ::fdatasync(fd) != 0)
+        ok = false;
+    } catch (const std::runtime_error&) {
+      ok = false;
+    }
+    lock.lock();
+
+    if (ok) {
+      durable_sequence = sequence;
+      stats.records += records;
+      stats.batches += 1;
+      stats.bytes += batch.size();
+    } else {
+      failed = true;
+    }
+    durable.notify_all();
+  }
+}
+
+JournalRecovery Journal::recover(const std::string& path, Bank& bank, std::string bank_fingerprint,
+                                 JournalRecovery base) {
+  JournalRecovery recovery = std::move(base);
+  recovery.records = 0;
+  recovery.torn_tail = false;
+
+  std::ifstream is(path, std::ios::binary);
+  char magic[sizeof(MAGIC)] = {};
+  is.read(magic, sizeof(magic));
+  size_t read = static_cast<size_t>(is.gcount());
+  if (read == 0 && recovery.valid_bytes == 0)
+    return recovery;
+  if (read < sizeof(MAGIC) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+    if (read == sizeof(MAGIC))
+      throw std::runtime_error(std::format("{} is not a bank journal", path));
+    if (recovery.valid_bytes > 0)
+      throw std::runtime_error(std::format("{} ends before the snapshot position", path));
+    recovery.torn_tail = true;
+    return recovery;
+  }
+
+  // Everything before valid_bytes is already in the Bank (a snapshot), only the rest is replayed
+  size_t start = std::max(recovery.valid_bytes, sizeof(MAGIC));
+  is.seekg(0, std::ios::end);
+  if (static_cast<size_t>(is.tellg()) < start)
+    throw std::runtime_error(std::format("{} ends before the snapshot position", path));
+  is.seekg(static_cast<std::streamoff>(start));
+  std::string file((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+
+  auto& fingerprints = recovery.credentials;
+  auto& owners = recovery.owners;
+  auto credentials = [&](std::uint64_t account) -> const std::string& { return fingerprints.at(owners.at(account)); };
+  // Customers and calls are rebuilt from hashes, the stand-ins authenticate while this lives
+  RestoredSecrets restored;
+
+  size_t offset = 0;
+  recovery.valid_bytes = start;
+  while (offset < file.size()) {
+    std::uint32_t size, sum;
+    if (file.size() - offset < FRAME_HEADER) {
+      recovery.torn_tail = true;
+      break;
+    }
+    std::memcpy(&size, file.data() + offset, sizeof(size));
+    std::memcpy(&sum, file.data() + offset + sizeof(size), sizeof(sum));
+    const char* body = file.data() + offset + FRAME_HEADER;
+    if (size == 0 || file.size() - offset - FRAME_HEADER < size || checksum(body, size) != sum) {
+      recovery.torn_tail = true;
+      break;
+    }
+
+    Decoder in(body + 1, size - 1);
+    switch (static_cast<std::uint8_t>(body[0])) {
+      case CUSTOMER: {
+        auto name = in.str();
+        auto age = in.u64();
+        auto gender = in.str();
+        auto fingerprint = hashed_secret(in.u64());
+        auto rank = in.u64();
+        auto is_alive = in.u64() != 0;
+        recovery.customers.push_back(std::make_unique<Person>(name, age, gender, fingerprint, rank, is_alive));
+        fingerprints.push_back(fingerprint);
+        break;
+      }
+      case CREATE_ACCOUNT: {
+        auto owner = in.u64();
+        auto number = in.u64();
+        auto CVV2 = in.str();
+        auto password = hashed_secret(in.u64());
+        RestoredAccountNumber card(number, CVV2);
+        recovery.accounts.push_back(bank.create_account(*recovery.customers.at(owner), fingerprints.at(owner), password));
+        owners.push_back(owner);
+        break;
+      }
+      case DELETE_ACCOUNT: {
+        auto id = in.u64();
+        bank.delete_account(*recovery.accounts.at(id), credentials(id));
+        recovery.accounts[id] = nullptr;
+        break;
+      }
+      case DELETE_CUSTOMER: {
+        auto id = in.u64();
+        bank.delete_customer(*recovery.customers.at(id), fingerprints.at(id));
+        for (size_t account = 0; account < owners.size(); ++account)
+          if (owners[account] == id)
+            recovery.accounts[account] = nullptr;
+        break;
+      }
+      case DEPOSIT: {
+        auto id = in.u64();
+        bank.deposit(*recovery.accounts.at(id), credentials(id), in.f64());
+        break;
+      }
+      case WITHDRAW: {
+        auto id = in.u64();
+        bank.withdraw(*recovery.accounts.at(id), credentials(id), in.f64());
+        break;
+      }
+      case TRANSFER: {
+        auto source = in.u64();
+        auto destination = in.u64();
+        auto& account = *recovery.accounts.at(source);
+        const auto& fingerprint = credentials(source);
+        bank.transfer(account, *recovery.accounts.at(destination), fingerprint, account.get_CVV2(fingerprint),
+                      account.get_password(fingerprint), account.get_exp_date(fingerprint), in.f64());
+        break;
+      }
+      case TAKE_LOAN: {
+        auto id = in.u64();
+        bank.take_loan(*recovery.accounts.at(id), credentials(id), in.f64());
+        break;
+      }
+      case PAY_LOAN: {
+        auto id = in.u64();
+        bank.pay_loan(*recovery.accounts.at(id), in.f64());
+        break;
+      }
+      case SET_OWNER: {
+        auto id = in.u64();
+        auto owner = in.u64();
+        auto fingerprint = credentials(id);
+        bank.set_owner(*recovery.accounts.at(id), recovery.customers.at(owner).get(), fingerprint, bank_fingerprint);
+        owners[id] = owner;
+        break;
+      }
+      case SET_ACCOUNT_STATUS: {
+        auto id = in.u64();
+        bank.set_account_status(*recovery.accounts.at(id), in.u64() != 0, bank_fingerprint);
+        break;
+      }
+      case SET_EXP_DATE: {
+        auto id = in.u64();
+        auto exp_date = in.str();
+        bank.set_exp_date(*recovery.accounts.at(id), exp_date, bank_fingerprint);
+        break;
+      }
+      case END_OF_DAY: {
+        EndOfDay::run(bank, bank_fingerprint, EndOfDayPolicy{.daily_rate = in.f64(), .threads = 1});
+        break;
+      }
+      default:
+        throw std::runtime_error(std::format("unknown journal record type {}", static_cast<int>(body[0])));
+    }
+
+    offset += FRAME_HEADER + size;
+    recovery.valid_bytes = start + offset;
+    ++recovery.records;
+  }
+  return recovery;
+}
@@ -0,0 +1,100 @@
+#include "Ledger.h"
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+bool wanted(const LedgerEntry& entry, const LedgerQuery& query) {
+  return !query.type || entry.type == *query.type;
+}
+}
+
+Ledger::Ledger(Clock clock) :
+    clock(std::move(clock)) {
+
+}
+
+std::uint64_t Ledger::append(LedgerEntryType type, std::uint64_t account, std::uint64_t counterparty, Money amount) {
+  auto now = clock();
+  std::unique_lock lock(mutex);
+  // Binary search by time needs times in sequence order
+  if (!entries.empty() && now < entries.back().time)
+    now = entries.back().time;
+
+  auto sequence = static_cast<std::uint64_t>(entries.size());
+  entries.push_back(LedgerEntry{sequence, now, type, account, counterparty, amount});
+  accounts[account].push_back(sequence);
+  if (type == LedgerEntryType::Transfer && counterparty != account)
+    accounts[counterparty].push_back(sequence);
+  return sequence;
+}
+
+void Ledger::open(std::uint64_t account) {
+  std::unique_lock lock(mutex);
+  opened[account] = static_cast<std::uint64_t>(entries.size());
+}
+
+LedgerPage Ledger::range(const LedgerQuery& query) const {
+  if (query.limit == 0)
+    throw std::invalid_argument("A page holds at least one entry.");
+
+  std::shared_lock lock(mutex);
+  auto first = std::lower_bound(entries.begin(), entries.end(), query.from,
+                                [](const LedgerEntry& entry, auto time) { return entry.time < time; });
+  auto start = std::max<std::uint64_t>(static_cast<std::uint64_t>(first - entries.begin()), query.cursor);
+
+  LedgerPage page;
+  for (auto sequence = start; sequence < entries.size() && entries[sequence].time < query.to; ++sequence) {
+    if (!wanted(entries[sequence], query))
+      continue;
+    if (page.entries.size() == query.limit) {
+      page.next = sequence;
+      break;
+    }
+    page.entries.push_back(entries[sequence]);
+  }
+  return page;
+}
+
+LedgerPage Ledger::history(std::uint64_t account, const LedgerQuery& query) const {
+  if (query.limit == 0)
+    throw std::invalid_argument("A page holds at least one entry.");
+
+  std::shared_lock lock(mutex);
+  LedgerPage page;
+  auto found = accounts.find(account);
+  if (found == accounts.end())
+    return page;
+
+  const auto& sequences = found->second;
+  auto first = std::lower_bound(sequences.begin(), sequences.end(), query.from,
+                                [&](std::uint64_t sequence, auto time) { return entries[sequence].time < time; });
+  first = std::max(first, std::lower_bound(sequences.begin(), sequences.end(), query.cursor));
+  // Entries of an earlier account under the same number aren't this one's
+  if (auto holder = opened.find(account); holder != opened.end())
+    first = std::max(first, std::lower_bound(sequences.begin(), sequences.end(), holder->second));
+
+  for (auto it = first; it != sequences.end() && entries[*it].time < query.to; ++it) {
+    if (!wanted(entries[*it], query))
+      continue;
+    if (page.entries.size() == query.limit) {
+      page.next = *it;
+      break;
+    }
+    page.entries.push_back(entries[*it]);
+  }
+  return page;
+}
+
+std::optional<LedgerEntry> Ledger::at(std::uint64_t sequence) const {
+  std::shared_lock lock(mutex);
+  if (sequence >= entries.size())
+    return std::nullopt;
+  return entries[sequence];
+}
+
+size_t Ledger::size() const {
+  std::shared_lock lock(mutex);
+  return entries.size();
+}
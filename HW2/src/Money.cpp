@@ -0,0 +1,18 @@
+#include "Money.h"
+
+#include <cmath>
+#include <format>
+
+Money Money::from_double(double amount) {
+    return Money(std::llround(amount * MINOR_PER_MAJOR));
+}
+
+double Money::to_double() const {
+    return static_cast<double>(minor_units) / MINOR_PER_MAJOR;
+}
+
+std::string Money::to_string() const {
+    std::int64_t major = minor_units / MINOR_PER_MAJOR;
+    std::int64_t minor = minor_units % MINOR_PER_MAJOR;
+    return std::format("{}{}.{:02}", minor_units < 0 ? "-" : "", major < 0 ? -major : major, minor < 0 ? -minor : minor);
+}
@@ -0,0 +1,89 @@
+#include "PackedAccount.h"
+#include "Account.h"
+#include "AccountIndex.h"
+#include "Session.h"
+#include "Utils.h"
+#include <charconv>
+#include <format>
+#include <stdexcept>
+
+namespace {
+std::optional<unsigned> parse_digits(std::string_view digits) {
+  unsigned value = 0;
+  if (digits.empty())
+    return std::nullopt;
+  auto [end, error] = std::from_chars(digits.data(), digits.data() + digits.size(), value);
+  if (error != std::errc() || end != digits.data() + digits.size())
+    return std::nullopt;
+  return value;
+}
+}
+
+std::uint32_t OwnerIds::intern(const Person* owner) {
+  auto [entry, inserted] = ids.try_emplace(owner, static_cast<std::uint32_t>(people.size()));
+  if (inserted)
+    people.push_back(owner);
+  return entry->second;
+}
+
+std::optional<std::uint32_t> OwnerIds::find(const Person* owner) const {
+  auto entry = ids.find(owner);
+  if (entry == ids.end())
+    return std::nullopt;
+  return entry->second;
+}
+
+const Person* OwnerIds::person(std::uint32_t id) const {
+  return id < people.size() ? people[id] : nullptr;
+}
+
+size_t OwnerIds::size() const {
+  return people.size();
+}
+
+PackedAccount pack(const Account& account, OwnerIds& owners, const std::string& owner_fingerprint) {
+  auto number = AccountIndex::parse(account.get_account_number());
+  if (!number)
+    throw std::invalid_argument("Account number isn't 16 digits.");
+
+  auto CVV2 = account.get_CVV2(owner_fingerprint);
+  auto packed_CVV2 = parse_digits(CVV2);
+  if (CVV2.size() != 4 || !packed_CVV2)
+    throw std::invalid_argument("CVV2 isn't 4 digits.");
+
+  auto exp_date = pack_exp_date(account.get_exp_date(owner_fingerprint));
+  if (!exp_date)
+    throw std::invalid_argument("Expiry date isn't YY-MM.");
+
+  PackedAccount packed{};
+  packed.account_number = *number;
+  packed.password_hash = password_hash(account.get_password(owner_fingerprint));
+  packed.balance = Money::from_double(account.get_balance());
+  packed.owner = owners.intern(account.get_owner());
+  packed.CVV2 = static_cast<std::uint16_t>(*packed_CVV2);
+  packed.exp_date = *exp_date & 0x7fff;
+  packed.status = account.get_status();
+  return packed;
+}
+
+std::optional<std::uint16_t> pack_exp_date(std::string_view exp_date) {
+  if (exp_date.size() != 5 || exp_date[2] != '-')
+    return std::nullopt;
+  auto year = parse_digits(exp_date.substr(0, 2));
+  auto month = parse_digits(exp_date.substr(3, 2));
+  if (!year || !month || *month < 1 || *month > 12)
+    return std::nullopt;
+  return static_cast<std::uint16_t>(*year * 12 + *month - 1);
+}
+
+std::string unpack_exp_date(std::uint16_t exp_date) {
+  return std::format("{:02}-{:02}", exp_date / 12, exp_date % 12 + 1);
+}
+
+std::string unpack_CVV2(std::uint16_t CVV2) {
+  return std::format("{:04}", CVV2);
+}
+
+bool password_matches(const PackedAccount& account, const std::string& password) {
+  return account.password_hash == Hash(password);
+}
@@ -0,0 +1,205 @@
+#include "Report.h"
+#include "Bank.h"
+#include "Person.h"
+#include <format>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+void append_json_string(std::string& out, std::string_view text) {
+  out += '"';
+  for (char c : text) {
+    switch (c) {
+    case '"': out += "\\\""; break;
+    case '\\': out += "\\\\"; break;
+    case '\n': out += "\\n"; break;
+    case '\r': out += "\\r"; break;
+    case '\t': out += "\\t"; break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20)
+        std::format_to(std::back_inserter(out), "\\u{:04x}", static_cast<unsigned>(c));
+      else
+        out += c;
+    }
+  }
+  out += '"';
+}
+
+void append_csv_field(std::string& out, std::string_view text) {
+  if (text.find_first_of(",\"\r\n") == std::string_view::npos) {
+    out += text;
+    return;
+  }
+  out += '"';
+  for (char c : text) {
+    if (c == '"')
+      out += '"';
+    out += c;
+  }
+  out += '"';
+}
+}
+
+ReportFormat report_format_for(std::string_view path) {
+  if (path.ends_with(".csv"))
+    return ReportFormat::CSV;
+  if (path.ends_with(".json"))
+    return ReportFormat::JSON;
+  return ReportFormat::Text;
+}
+
+FileSink::FileSink(const std::string& path) :
+    os(path, std::ios::binary | std::ios::trunc) {
+  if (!os)
+    throw std::runtime_error(std::format("cannot open {}", path));
+}
+
+void FileSink::write(std::string_view chunk) {
+  os.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+}
+
+void FileSink::flush() {
+  os.flush();
+}
+
+void StdoutSink::write(std::string_view chunk) {
+  std::cout.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+}
+
+void StdoutSink::flush() {
+  std::cout.flush();
+}
+
+void MemorySink::write(std::string_view chunk) {
+  text += chunk;
+}
+
+const std::string& MemorySink::str() const {
+  return text;
+}
+
+ReportWriter::ReportWriter(ReportSink& sink, ReportFormat format) :
+    sink(sink),
+    format(format) {
+  buffer.reserve(BUFFER_SIZE + 1024);
+  if (format == ReportFormat::CSV)
+    buffer += "record,name,age,gender,socioeconomic_rank,is_alive,account_number,balance,exp_date,account_status,"
+              "paid_loan,unpaid_loan\n";
+}
+
+ReportWriter::~ReportWriter() {
+  // An exception on the way out would terminate, finish() is where errors surface
+  try {
+    finish();
+  } catch (...) {
+  }
+}
+
+void ReportWriter::bank(std::string_view name, double total_balance, double total_loan) {
+  auto out = std::back_inserter(buffer);
+  switch (format) {
+  case ReportFormat::Text:
+    std::format_to(out, "bank name: {} | bank total balance: {} | bank total loan: {} | \n", name, total_balance, total_loan);
+    break;
+  case ReportFormat::CSV:
+    buffer += "bank,";
+    append_csv_field(buffer, name);
+    std::format_to(out, ",,,,,,{},,,,{}\n", total_balance, total_loan);
+    break;
+  case ReportFormat::JSON:
+    buffer += "{\"bank\":{\"name\":";
+    append_json_string(buffer, name);
+    std::format_to(out, ",\"total_balance\":{},\"total_loan\":{}", total_balance, total_loan);
+    buffer += "},\"customers\":[";
+    break;
+  }
+  drain_if_full();
+}
+
+void ReportWriter::begin_customer(const Person& person, double paid_loan, double unpaid_loan) {
+  auto out = std::back_inserter(buffer);
+  this->paid_loan = paid_loan;
+  this->unpaid_loan = unpaid_loan;
+  first_account = true;
+  switch (format) {
+  case ReportFormat::Text:
+    std::format_to(out, "name : {:<7} | age : {:<3} | gender : {:<6} | hashed_fingerprint : {:<10} | "
+                        "socioeconomic_rank : {:<2} | is_alive : {} \n",
+                   person.get_name(), person.get_age(), person.get_gender(), person.get_hashed_fingerprint(),
+                   person.get_socioeconomic_rank(), person.get_is_alive());
+    break;
+  case ReportFormat::CSV:
+    buffer += "customer,";
+    append_csv_field(buffer, person.get_name());
+    std::format_to(out, ",{},", person.get_age());
+    append_csv_field(buffer, person.get_gender());
+    std::format_to(out, ",{},{},,,,,{},{}\n", person.get_socioeconomic_rank(), person.get_is_alive(), paid_loan, unpaid_loan);
+    break;
+  case ReportFormat::JSON:
+    buffer += first_customer ? "{\"name\":" : ",{\"name\":";
+    append_json_string(buffer, person.get_name());
+    std::format_to(out, ",\"age\":{},\"gender\":", person.get_age());
+    append_json_string(buffer, person.get_gender());
+    std::format_to(out, ",\"socioeconomic_rank\":{},\"is_alive\":{},\"paid_loan\":{},\"unpaid_loan\":{},\"accounts\":[",
+                   person.get_socioeconomic_rank(), person.get_is_alive(), paid_loan, unpaid_loan);
+    break;
+  }
+  first_customer = false;
+  drain_if_full();
+}
+
+void ReportWriter::account(const ReportAccount& account) {
+  auto out = std::back_inserter(buffer);
+  switch (format) {
+  case ReportFormat::Text:
+    std::format_to(out, "account number: {} | balance: {} | exp_date: {} | account_status: {}\n",
+                   account.account_number, account.balance, account.exp_date, account.status);
+    break;
+  case ReportFormat::CSV:
+    std::format_to(out, "account,,,,,,{},{},", account.account_number, account.balance);
+    append_csv_field(buffer, account.exp_date);
+    std::format_to(out, ",{},,\n", account.status);
+    break;
+  case ReportFormat::JSON:
+    buffer += first_account ? "{" : ",{";
+    std::format_to(out, "\"account_number\":\"{}\",\"balance\":{},\"exp_date\":", account.account_number, account.balance);
+    append_json_string(buffer, account.exp_date);
+    std::format_to(out, ",\"account_status\":{}", account.status);
+    buffer += '}';
+    break;
+  }
+  first_account = false;
+  drain_if_full();
+}
+
+void ReportWriter::end_customer() {
+  if (format == ReportFormat::Text)
+    std::format_to(std::back_inserter(buffer), "paid loan: {} |unpaid loan : {} \n", paid_loan, unpaid_loan);
+  else if (format == ReportFormat::JSON)
+    buffer += "]}";
+  drain_if_full();
+}
+
+void ReportWriter::finish() {
+  if (finished)
+    return;
+  finished = true;
+  if (format == ReportFormat::JSON)
+    buffer += "]}\n";
+  sink.write(buffer);
+  buffer.clear();
+  sink.flush();
+}
+
+void ReportWriter::drain_if_full() {
+  if (buffer.size() < BUFFER_SIZE)
+    return;
+  sink.write(buffer);
+  buffer.clear();
+}
+
+void write_report(const Bank& bank, ReportSink& sink, ReportFormat format) {
+  ReportWriter writer(sink, format);
+  bank.get_info(writer);
+}
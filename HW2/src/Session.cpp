@@ -0,0 +1,145 @@
+#include "Session.h"
+#include "Person.h"
+#include "Utils.h"
+#include <charconv>
+#include <random>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+thread_local const Person* verified_owner = nullptr;
+thread_local const std::string* verified_fingerprint = nullptr;
+thread_local bool secrets_restored = false;
+
+// No fingerprint or password a customer types starts with a NUL byte
+constexpr std::string_view HASHED_SECRET_PREFIX{"\0#", 2};
+constexpr size_t HASHED_SECRET_DIGITS = 2 * sizeof(size_t);
+
+std::uint64_t draw_secret() {
+  // Tokens have to be unguessable, not just unique, so no seeded generator
+  static thread_local std::random_device device;
+  return (static_cast<std::uint64_t>(device()) << 32) ^ device();
+}
+}
+
+SessionToken SessionTable::open(const Person& person, const std::string& fingerprint) {
+  if (person.get_hashed_fingerprint() != Hash(fingerprint))
+    throw std::invalid_argument("Input fingerprint don't match.");
+
+  std::uint32_t slot;
+  if (!free_slots.empty()) {
+    slot = free_slots.back();
+    free_slots.pop_back();
+  } else {
+    slot = static_cast<std::uint32_t>(slots.size());
+    slots.push_back(Slot{nullptr, 0, 0, {}});
+  }
+  auto& entry = slots[slot];
+  entry.person = &person;
+  entry.generation++;
+  entry.secret = draw_secret();
+  entry.credential = hashed_secret(person.get_hashed_fingerprint());
+  count++;
+  return SessionToken{slot, entry.generation, entry.secret};
+}
+
+bool SessionTable::close(const SessionToken& token) {
+  if (token.slot >= slots.size())
+    return false;
+  auto& entry = slots[token.slot];
+  if (!entry.person || entry.generation != token.generation || entry.secret != token.secret)
+    return false;
+
+  entry.person = nullptr;
+  entry.credential.clear();
+  free_slots.push_back(token.slot);
+  count--;
+  return true;
+}
+
+size_t SessionTable::close_all(const Person& person) {
+  size_t closed = 0;
+  for (std::uint32_t slot = 0; slot < slots.size(); ++slot) {
+    auto& entry = slots[slot];
+    if (entry.person != &person)
+      continue;
+    entry.person = nullptr;
+    entry.credential.clear();
+    free_slots.push_back(slot);
+    closed++;
+  }
+  count -= closed;
+  return closed;
+}
+
+const std::string& SessionTable::authenticate(const SessionToken& token, const Person& owner) const {
+  if (token.slot < slots.size()) {
+    const auto& entry = slots[token.slot];
+    // No early exit on the first differing bit, the comparison leaks nothing about the secret
+    std::uint64_t difference = (entry.secret ^ token.secret) | (entry.generation ^ token.generation);
+    if ((difference == 0) & (entry.person == &owner))
+      return entry.credential;
+  }
+  throw std::invalid_argument("Session token don't match.");
+}
+
+size_t SessionTable::size() const {
+  return count;
+}
+
+VerifiedFingerprint::VerifiedFingerprint(const Person& owner, const std::string& fingerprint) :
+    previous_owner(verified_owner),
+    previous_fingerprint(verified_fingerprint) {
+  verified_owner = &owner;
+  verified_fingerprint = &fingerprint;
+}
+
+VerifiedFingerprint::~VerifiedFingerprint() {
+  verified_owner = previous_owner;
+  verified_fingerprint = previous_fingerprint;
+}
+
+bool VerifiedFingerprint::covers(const Person* owner, const std::string& fingerprint) {
+  return owner == verified_owner && &fingerprint == verified_fingerprint;
+}
+
+std::string hashed_secret(size_t hash) {
+  std::string secret(HASHED_SECRET_PREFIX);
+  secret.resize(HASHED_SECRET_PREFIX.size() + HASHED_SECRET_DIGITS, '0');
+  for (size_t i = secret.size(); i-- > HASHED_SECRET_PREFIX.size(); hash >>= 4)
+    secret[i] = "0123456789abcdef"[hash & 0xf];
+  return secret;
+}
+
+std::optional<size_t> hashed_secret_value(const std::string& secret) {
+  if (secret.size() != HASHED_SECRET_PREFIX.size() + HASHED_SECRET_DIGITS || !secret.starts_with(HASHED_SECRET_PREFIX))
+    return std::nullopt;
+  size_t hash = 0;
+  const char* end = secret.data() + secret.size();
+  auto [stop, error] = std::from_chars(secret.data() + HASHED_SECRET_PREFIX.size(), end, hash, 16);
+  if (error != std::errc() || stop != end)
+    return std::nullopt;
+  return hash;
+}
+
+size_t password_hash(const std::string& stored) {
+  auto hash = hashed_secret_value(stored);
+  return hash ? *hash : Hash(stored);
+}
+
+bool password_matches(const std::string& stored, const std::string& given) {
+  // Only hashes are compared, a stand-in read back from a recovered account is no password
+  return password_hash(stored) == Hash(given);
+}
+
+RestoredSecrets::RestoredSecrets() : previous(secrets_restored) {
+  secrets_restored = true;
+}
+
+RestoredSecrets::~RestoredSecrets() {
+  secrets_restored = previous;
+}
+
+bool RestoredSecrets::active() {
+  return secrets_restored;
+}
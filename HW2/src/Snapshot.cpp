@@ -0,0 +1,328 @@
+#include "Snapshot.h"
+#include "Bank.h"
+#include "Account.h"
+#include "AccountNumbers.h"
+#include "Person.h"
+#include "Session.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <format>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+// Layout: Header | CustomerRow[customers] | AccountRow[accounts] | strings blob.
+// Rows are fixed size so a loader can split them between threads without parsing.
+constexpr char MAGIC[8] = {'B', 'A', 'N', 'K', 'S', 'N', 'A', 'P'};
+
+struct StringRef {
+  std::uint64_t offset;
+  std::uint64_t size;
+};
+
+struct Header {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t reserved;
+  std::uint64_t journal_offset;
+  std::uint64_t customer_ids_end;
+  std::uint64_t account_ids_end;
+  std::uint64_t customers;
+  std::uint64_t accounts;
+  double total_balance;
+  double total_loan;
+  std::uint64_t strings_offset;
+  std::uint64_t strings_size;
+};
+
+struct CustomerRow {
+  std::uint64_t id;
+  StringRef name;
+  StringRef gender;
+  std::uint64_t hashed_fingerprint;
+  std::uint64_t age;
+  std::uint64_t rank;
+  std::uint8_t is_alive;
+  std::uint8_t has_loan;
+  std::uint8_t padding[6];
+  double paid_loan;
+  double unpaid_loan;
+};
+
+struct AccountRow {
+  std::uint64_t id;
+  std::uint64_t owner;
+  double balance;
+  std::uint8_t status;
+  std::uint8_t padding[7];
+  std::uint64_t number;
+  std::uint64_t password_hash;
+  StringRef CVV2;
+  StringRef exp_date;
+};
+
+static_assert(std::is_trivially_copyable_v<Header> && sizeof(Header) % 8 == 0);
+static_assert(std::is_trivially_copyable_v<CustomerRow> && sizeof(CustomerRow) % 8 == 0);
+static_assert(std::is_trivially_copyable_v<AccountRow> && sizeof(AccountRow) % 8 == 0);
+
+StringRef add_string(std::string& blob, const std::string& value) {
+  StringRef ref{blob.size(), value.size()};
+  blob += value;
+  return ref;
+}
+
+template<typename Row>
+void append_row(std::string& out, const Row& row) {
+  out.append(reinterpret_cast<const char*>(&row), sizeof(row));
+}
+
+// Runs body(begin, end) over [0, count) on up to `threads` threads, rethrows the first failure
+template<typename Body>
+void parallel_ranges(size_t count, size_t threads, Body body) {
+  threads = std::max<size_t>(1, std::min(threads, count / 1024 + 1));
+  std::vector<std::exception_ptr> errors(threads);
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < threads; ++t)
+    workers.emplace_back([&, t] {
+      try {
+        body(count * t / threads, count * (t + 1) / threads);
+      } catch (...) {
+        errors[t] = std::current_exception();
+      }
+    });
+  for (auto& worker : workers)
+    worker.join();
+  for (auto& error : errors)
+    if (error)
+      std::rethrow_exception(error);
+}
+
+class Mapping {
+public:
+  explicit Mapping(const std::string& path) : fd(::open(path.c_str(), O_RDONLY)) {
+    if (fd < 0)
+      throw std::runtime_error(std::format("can't open snapshot {}", path));
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || info.st_size == 0) {
+      ::close(fd);
+      throw std::runtime_error(std::format("snapshot {} is empty", path));
+    }
+    size = static_cast<size_t>(info.st_size);
+    data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      ::close(fd);
+      throw std::runtime_error(std::format("can't map snapshot {}", path));
+    }
+  }
+  ~Mapping() {
+    ::munmap(data, size);
+    ::close(fd);
+  }
+
+  Mapping(const Mapping&) = delete;
+  Mapping& operator=(const Mapping&) = delete;
+
+  const char* bytes() const { return static_cast<const char*>(data); }
+
+  int fd;
+  size_t size{0};
+  void* data{nullptr};
+};
+
+void write_file(const std::string& path, const std::string& bytes) {
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  if (fd < 0)
+    throw std::runtime_error(std::format("can't create snapshot {}", path));
+  const char* data = bytes.data();
+  size_t left = bytes.size();
+  while (left > 0) {
+    ssize_t written = ::write(fd, data, left);
+    if (written < 0) {
+      ::close(fd);
+      throw std::runtime_error(std::format("can't write snapshot {}", path));
+    }
+    data += written;
+    left -= static_cast<size_t>(written);
+  }
+  bool synced = ::fdatasync(fd) == 0;
+  ::close(fd);
+  if (!synced)
+    throw std::runtime_error(std::format("can't write snapshot {}", path));
+}
+}
+
+SnapshotStats write_snapshot(const std::string& path, const SnapshotCapture& capture) {
+  std::string strings;
+  std::string rows;
+  rows.reserve(capture.customers.size() * sizeof(CustomerRow) + capture.accounts.size() * sizeof(AccountRow));
+
+  for (const auto& customer : capture.customers) {
+    CustomerRow row{};
+    row.id = customer.id;
+    row.name = add_string(strings, customer.name);
+    row.gender = add_string(strings, customer.gender);
+    row.hashed_fingerprint = customer.hashed_fingerprint;
+    row.age = customer.age;
+    row.rank = customer.rank;
+    row.is_alive = customer.is_alive;
+    row.has_loan = customer.has_loan;
+    row.paid_loan = customer.paid_loan;
+    row.unpaid_loan = customer.unpaid_loan;
+    append_row(rows, row);
+  }
+  for (const auto& account : capture.accounts) {
+    AccountRow row{};
+    row.id = account.id;
+    row.owner = account.owner;
+    row.balance = account.balance;
+    row.status = account.status;
+    row.number = account.number;
+    row.password_hash = password_hash(account.password);
+    row.CVV2 = add_string(strings, account.CVV2);
+    row.exp_date = add_string(strings, account.exp_date);
+    append_row(rows, row);
+  }
+
+  Header header{};
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = SNAPSHOT_VERSION;
+  header.journal_offset = capture.journal_offset;
+  header.customer_ids_end = capture.customer_ids_end;
+  header.account_ids_end = capture.account_ids_end;
+  header.customers = capture.customers.size();
+  header.accounts = capture.accounts.size();
+  header.total_balance = capture.total_balance;
+  header.total_loan = capture.total_loan;
+  header.strings_offset = sizeof(Header) + rows.size();
+  header.strings_size = strings.size();
+
+  std::string file;
+  file.reserve(header.strings_offset + strings.size());
+  append_row(file, header);
+  file += rows;
+  file += strings;
+
+  // Readers see either the previous snapshot or this one, never half of it
+  std::string temporary = path + ".tmp";
+  write_file(temporary, file);
+  if (std::rename(temporary.c_str(), path.c_str()) != 0)
+    throw std::runtime_error(std::format("can't replace snapshot {}", path));
+
+  SnapshotStats stats;
+  stats.customers = capture.customers.size();
+  stats.accounts = capture.accounts.size();
+  stats.bytes = file.size();
+  return stats;
+}
+
+JournalRecovery load_snapshot(const std::string& path, Bank& bank, std::string bank_fingerprint, size_t threads) {
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+
+  Mapping mapping(path);
+  Header header;
+  if (mapping.size < sizeof(Header))
+    throw std::runtime_error(std::format("{} is not a bank snapshot", path));
+  std::memcpy(&header, mapping.bytes(), sizeof(Header));
+  if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+    throw std::runtime_error(std::format("{} is not a bank snapshot", path));
+  if (header.version != SNAPSHOT_VERSION)
+    throw std::runtime_error(std::format("snapshot {} has version {}, expected {}", path, header.version, SNAPSHOT_VERSION));
+  if (header.customers > mapping.size / sizeof(CustomerRow) || header.accounts > mapping.size / sizeof(AccountRow) ||
+      header.strings_offset != sizeof(Header) + header.customers * sizeof(CustomerRow) + header.accounts * sizeof(AccountRow) ||
+      header.strings_size > mapping.size || header.strings_offset > mapping.size - header.strings_size)
+    throw std::runtime_error(std::format("snapshot {} is truncated or corrupt", path));
+
+  const char* customer_rows = mapping.bytes() + sizeof(Header);
+  const char* account_rows = customer_rows + header.customers * sizeof(CustomerRow);
+  std::string_view strings(mapping.bytes() + header.strings_offset, header.strings_size);
+  auto text = [&](StringRef ref) {
+    if (ref.offset > strings.size() || ref.size > strings.size() - ref.offset)
+      throw std::runtime_error(std::format("snapshot {} is truncated or corrupt", path));
+    return std::string(strings.substr(ref.offset, ref.size));
+  };
+
+  JournalRecovery recovery;
+  recovery.customers.resize(header.customer_ids_end);
+  recovery.credentials.resize(header.customer_ids_end);
+  recovery.accounts.assign(header.account_ids_end, nullptr);
+  recovery.owners.assign(header.account_ids_end, 0);
+  recovery.valid_bytes = header.journal_offset;
+
+  // Decoding and constructing customers is independent per row. The rows hold hashed_secret
+  // stand-ins, every thread that authenticates with them needs a RestoredSecrets scope.
+  RestoredSecrets restored;
+  std::vector<CustomerRow> customers(header.customers);
+  parallel_ranges(customers.size(), threads, [&](size_t begin, size_t end) {
+    RestoredSecrets secrets;
+    for (size_t i = begin; i < end; ++i) {
+      auto& row = customers[i];
+      std::memcpy(&row, customer_rows + i * sizeof(CustomerRow), sizeof(CustomerRow));
+      if (row.id >= header.customer_ids_end)
+        throw std::runtime_error(std::format("snapshot {} is truncated or corrupt", path));
+      recovery.credentials[row.id] = hashed_secret(row.hashed_fingerprint);
+      recovery.customers[row.id] = std::make_unique<Person>(text(row.name), row.age, text(row.gender),
+                                                            recovery.credentials[row.id], row.rank, row.is_alive);
+    }
+  });
+
+  std::vector<AccountRow> accounts(header.accounts);
+  std::vector<std::string> CVV2s(header.accounts);
+  std::vector<std::string> exp_dates(header.accounts);
+  parallel_ranges(accounts.size(), threads, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      auto& row = accounts[i];
+      std::memcpy(&row, account_rows + i * sizeof(AccountRow), sizeof(AccountRow));
+      if (row.id >= header.account_ids_end || row.owner >= header.customer_ids_end)
+        throw std::runtime_error(std::format("snapshot {} is truncated or corrupt", path));
+      CVV2s[i] = text(row.CVV2);
+      exp_dates[i] = text(row.exp_date);
+    }
+  });
+
+  // Bank's containers only grow through create_account, one at a time
+  for (size_t i = 0; i < accounts.size(); ++i) {
+    const auto& row = accounts[i];
+    auto* owner = recovery.customers[row.owner].get();
+    if (!owner)
+      throw std::runtime_error(std::format("snapshot {} is truncated or corrupt", path));
+    const auto& fingerprint = recovery.credentials[row.owner];
+    RestoredAccountNumber card(row.number, std::move(CVV2s[i]));
+    auto* account = bank.create_account(*owner, fingerprint, hashed_secret(row.password_hash));
+    if (row.balance != 0.0)
+      bank.deposit(*account, fingerprint, row.balance);
+    if (!row.status)
+      bank.set_account_status(*account, false, bank_fingerprint);
+    bank.set_exp_date(*account, exp_dates[i], bank_fingerprint);
+    recovery.accounts[row.id] = account;
+    recovery.owners[row.id] = row.owner;
+  }
+
+  // Loans and bank totals are set as they were: replaying take_loan would charge interest
+  // and check balances, and interest paid by customers deleted before the snapshot only
+  // shows in the totals
+  std::vector<Person*> members;
+  std::map<Person*, double> paid_loans;
+  std::map<Person*, double> unpaid_loans;
+  for (const auto& row : customers) {
+    auto* customer = recovery.customers[row.id].get();
+    members.push_back(customer);
+    if (!row.has_loan)
+      continue;
+    paid_loans[customer] = row.paid_loan;
+    unpaid_loans[customer] = row.unpaid_loan;
+  }
+  bank.restore_loans(members, paid_loans, unpaid_loans, header.total_balance, header.total_loan, bank_fingerprint);
+  return recovery;
+}
@@ -1,4 +1,5 @@
 #include "Utils.h"
+#include "Session.h"
 
 #include <random>
 #include <functional>
@@ -7,13 +8,17 @@
 #include <optional>
 
 size_t Rand(size_t min, size_t max) {
-    std::random_device rd;
-    std::mt19937 gen(rd());
+    // Seeding from std::random_device is a syscall, do it once per thread
+    thread_local std::mt19937_64 gen(std::random_device{}());
     std::uniform_int_distribution<size_t> dist(min, max);
 
     return dist(gen);
 };
 
 size_t Hash(const std::string& str) {
+    // Recovery passes hashed_secret stand-ins where the secrets went, see Session.h
+    if (RestoredSecrets::active())
+        if (auto hash = hashed_secret_value(str))
+            return *hash;
     return std::hash<std::string>{}(str);
 };
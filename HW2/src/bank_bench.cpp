@@ -0,0 +1,979 @@
+#include "Account.h"
+#include "Bank.h"
+#include "BankCluster.h"
+#include "ConcurrentBank.h"
+#include "EndOfDay.h"
+#include "FraudMonitor.h"
+#include "Journal.h"
+#include "LatencyHistogram.h"
+#include "Ledger.h"
+#include "PackedAccount.h"
+#include "Person.h"
+#include "Report.h"
+#include "SlabPool.h"
+#include "Snapshot.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace {
+
+struct Customer {
+	std::unique_ptr<Person> person;
+	std::string fingerprint;
+	Account* account;
+	std::string CVV2;
+	std::string exp_date;
+};
+
+const std::string password = "bench-password";
+const std::string bank_fingerprint = "bench-bank";
+
+std::vector<Customer> populate(Bank& bank, size_t count) {
+	std::vector<Customer> customers(count);
+	for (size_t i = 0; i < count; ++i) {
+		auto& c = customers[i];
+		c.fingerprint = std::format("fingerprint-{}", i);
+		c.person = std::make_unique<Person>(std::format("customer-{}", i), 30, "Female", c.fingerprint, 5, true);
+		c.account = bank.create_account(*c.person, c.fingerprint, password);
+		bank.deposit(*c.account, c.fingerprint, 1e9);
+		c.CVV2 = c.account->get_CVV2(c.fingerprint);
+		c.exp_date = c.account->get_exp_date(c.fingerprint);
+	}
+	return customers;
+}
+
+// Runs `ops` random transfers on each of `threads` threads, returns ops/sec
+double run(size_t threads, size_t ops, std::vector<Customer>& customers,
+		   const std::function<void(Customer&, Customer&)>& transfer) {
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> workers;
+	for (size_t t = 0; t < threads; ++t)
+		workers.emplace_back([&, t] {
+			std::mt19937_64 gen(t + 1);
+			std::uniform_int_distribution<size_t> pick(0, customers.size() - 1);
+			for (size_t i = 0; i < ops; ++i)
+				transfer(customers[pick(gen)], customers[pick(gen)]);
+		});
+	for (auto& worker : workers)
+		worker.join();
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return static_cast<double>(threads * ops) / elapsed.count();
+}
+
+void bench_transfer_scaling(size_t accounts, size_t ops) {
+	std::cout << std::format("== transfer scaling: {} accounts, {} transfers per thread ==", accounts, ops) << std::endl;
+	std::cout << std::format("{:>8} | {:>16} | {:>16} | {:>8}", "threads", "global mutex/s", "striped/s", "speedup") << std::endl;
+
+	size_t max_threads = std::max(4u, std::thread::hardware_concurrency());
+	for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+		Bank global_bank("global", bank_fingerprint);
+		auto global_customers = populate(global_bank, accounts);
+		std::mutex global_mutex;
+		double global = run(threads, ops, global_customers, [&](Customer& from, Customer& to) {
+			std::lock_guard lock(global_mutex);
+			global_bank.transfer(*from.account, *to.account, from.fingerprint, from.CVV2, password, from.exp_date, 1.0);
+		});
+
+		Bank striped_bank("striped", bank_fingerprint);
+		ConcurrentBank concurrent(striped_bank);
+		auto striped_customers = populate(striped_bank, accounts);
+		double striped = run(threads, ops, striped_customers, [&](Customer& from, Customer& to) {
+			concurrent.transfer(*from.account, *to.account, from.fingerprint, from.CVV2, password, from.exp_date, 1.0);
+		});
+
+		std::cout << std::format("{:>8} | {:>16.0f} | {:>16.0f} | {:>7.2f}x", threads, global, striped, striped / global)
+				  << std::endl;
+	}
+}
+
+// Every thread hammers the same account with deposit/withdraw pairs: a mutex
+// around the Bank against the lock-free compare-and-swap of ConcurrentBank
+void bench_hot_account(size_t ops) {
+	std::cout << std::format("== hot account contention: {} deposit/withdraw pairs per thread ==", ops) << std::endl;
+	std::cout << std::format("{:>8} | {:>16} | {:>16} | {:>8}", "threads", "mutex/s", "lock-free/s", "speedup") << std::endl;
+
+	auto hammer = [ops](size_t threads, const std::function<void()>& pair) {
+		auto start = std::chrono::steady_clock::now();
+		std::vector<std::thread> workers;
+		for (size_t t = 0; t < threads; ++t)
+			workers.emplace_back([&] {
+				for (size_t i = 0; i < ops; ++i)
+					pair();
+			});
+		for (auto& worker : workers)
+			worker.join();
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		return static_cast<double>(2 * threads * ops) / elapsed.count();
+	};
+
+	size_t max_threads = std::max(4u, std::thread::hardware_concurrency());
+	for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+		Bank mutex_bank("mutex", bank_fingerprint);
+		auto mutex_customers = populate(mutex_bank, 1);
+		auto& m = mutex_customers.front();
+		std::mutex mutex;
+		double locked = hammer(threads, [&] {
+			{
+				std::lock_guard lock(mutex);
+				mutex_bank.deposit(*m.account, m.fingerprint, 0.01);
+			}
+			std::lock_guard lock(mutex);
+			mutex_bank.withdraw(*m.account, m.fingerprint, 0.01);
+		});
+
+		Bank cas_bank("cas", bank_fingerprint);
+		ConcurrentBank concurrent(cas_bank);
+		auto cas_customers = populate(cas_bank, 1);
+		auto& c = cas_customers.front();
+		double lock_free = hammer(threads, [&] {
+			concurrent.deposit(*c.account, c.fingerprint, 0.01);
+			concurrent.withdraw(*c.account, c.fingerprint, 0.01);
+		});
+
+		std::cout << std::format("{:>8} | {:>16.0f} | {:>16.0f} | {:>7.2f}x", threads, locked, lock_free, lock_free / locked)
+				  << std::endl;
+	}
+}
+
+// Durable deposits through a journaled ConcurrentBank; each call returns once its record
+// is fsynced, so throughput is bounded by how many records share one fsync
+void bench_journal_commits(size_t commits) {
+	const size_t threads = 8;
+	const std::string path = "bank_bench.wal";
+	std::cout << std::format("== journal group commit: {} threads, {} commits per thread ==", threads, commits) << std::endl;
+	std::cout << std::format("{:>8} | {:>16} | {:>16}", "batch", "commits/s", "records/fsync") << std::endl;
+
+	for (size_t batch_size : {1, 8, 64, 256}) {
+		std::remove(path.c_str());
+		Bank bank("journaled", bank_fingerprint);
+		auto customers = populate(bank, threads);
+		Journal journal(path, JournalOptions{.batch_size = batch_size});
+		ConcurrentBank concurrent(bank, &journal);
+
+		auto start = std::chrono::steady_clock::now();
+		std::vector<std::thread> workers;
+		for (size_t t = 0; t < threads; ++t)
+			workers.emplace_back([&, t] {
+				// populate() bypassed the journal, so each thread journals an account of its own first
+				auto* account = concurrent.create_account(*customers[t].person, customers[t].fingerprint, password);
+				for (size_t i = 0; i < commits; ++i)
+					concurrent.deposit(*account, customers[t].fingerprint, 1.0);
+			});
+		for (auto& worker : workers)
+			worker.join();
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		auto stats = journal.get_stats();
+		std::cout << std::format("{:>8} | {:>16.0f} | {:>16.1f}", batch_size,
+								 static_cast<double>(threads * commits) / elapsed.count(),
+								 static_cast<double>(stats.records) / static_cast<double>(stats.batches))
+				  << std::endl;
+	}
+	std::remove(path.c_str());
+}
+
+// Snapshot of a journaled bank, then a cold start from it into a fresh Bank
+void bench_snapshot(size_t accounts) {
+	const std::string journal_path = "bank_bench_snapshot.wal";
+	const std::string snapshot_path = "bank_bench.snap";
+	std::remove(journal_path.c_str());
+	std::cout << std::format("== snapshot: {} accounts ==", accounts) << std::endl;
+
+	Bank bank("snapshot", bank_fingerprint);
+	std::vector<Customer> customers(accounts);
+	{
+		Journal journal(journal_path, JournalOptions{.batch_size = 1, .sync = false});
+		ConcurrentBank concurrent(bank, &journal);
+		for (size_t i = 0; i < accounts; ++i) {
+			auto& c = customers[i];
+			c.fingerprint = std::format("fingerprint-{}", i);
+			c.person = std::make_unique<Person>(std::format("customer-{}", i), 30, "Female", c.fingerprint, 5, true);
+			c.account = concurrent.create_account(*c.person, c.fingerprint, password);
+			concurrent.deposit(*c.account, c.fingerprint, static_cast<double>(i % 1000));
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		auto stats = concurrent.snapshot(snapshot_path, bank_fingerprint);
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		std::cout << std::format("write: {:.1f} ms, writers paused {:.1f} ms, {:.1f} bytes/account", elapsed.count(),
+								 static_cast<double>(stats.pause.count()) / 1000,
+								 static_cast<double>(stats.bytes) / static_cast<double>(accounts))
+				  << std::endl;
+	}
+
+	for (size_t threads : {1u, std::max(2u, std::thread::hardware_concurrency())}) {
+		Bank restored("restored", bank_fingerprint);
+		auto start = std::chrono::steady_clock::now();
+		auto recovery = load_snapshot(snapshot_path, restored, bank_fingerprint, threads);
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		std::cout << std::format("load on {} threads: {:.1f} ms", threads, elapsed.count()) << std::endl;
+	}
+	std::remove(journal_path.c_str());
+	std::remove(snapshot_path.c_str());
+}
+
+// Closes every account in random order, then the customers; the cost per deletion
+// should not depend on how many accounts the bank holds
+void bench_deletion(size_t accounts) {
+	std::cout << std::format("== deletion: accounts in random order, then customers ==") << std::endl;
+	std::cout << std::format("{:>10} | {:>16} | {:>16}", "accounts", "ns/account", "ns/customer") << std::endl;
+
+	for (size_t count : {accounts / 4, accounts / 2, accounts}) {
+		const size_t per_customer = 10;
+		Bank bank("deletion", bank_fingerprint);
+		std::vector<std::unique_ptr<Person>> people;
+		std::vector<std::string> fingerprints;
+		std::vector<Account*> opened;
+		for (size_t i = 0; i < count; ++i) {
+			if (i % per_customer == 0) {
+				fingerprints.push_back(std::format("fingerprint-{}", i));
+				people.push_back(std::make_unique<Person>(std::format("customer-{}", i), 30, "Male", fingerprints.back(), 5, true));
+			}
+			opened.push_back(bank.create_account(*people.back(), fingerprints.back(), password));
+		}
+
+		std::vector<size_t> order(count);
+		for (size_t i = 0; i < count; ++i)
+			order[i] = i;
+		std::shuffle(order.begin(), order.end(), std::mt19937_64(42));
+
+		auto start = std::chrono::steady_clock::now();
+		for (auto i : order)
+			bank.delete_account(*opened[i], fingerprints[i / per_customer]);
+		std::chrono::duration<double, std::nano> accounts_elapsed = std::chrono::steady_clock::now() - start;
+
+		start = std::chrono::steady_clock::now();
+		for (size_t c = 0; c < people.size(); ++c)
+			bank.delete_customer(*people[c], fingerprints[c]);
+		std::chrono::duration<double, std::nano> customers_elapsed = std::chrono::steady_clock::now() - start;
+
+		std::cout << std::format("{:>10} | {:>16.1f} | {:>16.1f}", count,
+								 accounts_elapsed.count() / static_cast<double>(std::max<size_t>(count, 1)),
+								 customers_elapsed.count() / static_cast<double>(std::max<size_t>(people.size(), 1)))
+				  << std::endl;
+	}
+}
+
+// Bulk account creation, the account number and CVV2 draws dominate it
+void bench_account_creation(size_t accounts) {
+	std::cout << std::format("== account creation: {} accounts ==", accounts) << std::endl;
+
+	// What every account used to cost: a random_device and a fresh mt19937 per digit
+	auto legacy_digit = [] {
+		std::random_device rd;
+		std::mt19937 gen(rd());
+		return std::uniform_int_distribution<size_t>(0, 9)(gen);
+	};
+	size_t legacy_count = std::min<size_t>(accounts, 10000);
+	auto start = std::chrono::steady_clock::now();
+	size_t checksum = 0;
+	for (size_t i = 0; i < legacy_count; ++i)
+		for (size_t digit = 0; digit < 20; ++digit)
+			checksum += legacy_digit();
+	std::chrono::duration<double> legacy = std::chrono::steady_clock::now() - start;
+	std::cout << std::format("{:>28}: {:>12.0f} numbers/s (checksum {})", "per-digit random_device",
+							 static_cast<double>(legacy_count) / legacy.count(), checksum % 10)
+			  << std::endl;
+
+	Person owner("bulk", 30, "Male", "bulk-fingerprint", 5, true);
+	{
+		Bank bank("bulk", bank_fingerprint);
+		start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < accounts; ++i)
+			bank.create_account(owner, "bulk-fingerprint", password);
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		std::cout << std::format("{:>28}: {:>12.0f} accounts/s", "Bank::create_account",
+								 static_cast<double>(accounts) / elapsed.count())
+				  << std::endl;
+	}
+	{
+		Bank bank("bulk", bank_fingerprint);
+		ConcurrentBank concurrent(bank);
+		start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < accounts; ++i)
+			concurrent.create_account(owner, "bulk-fingerprint", password);
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		std::cout << std::format("{:>28}: {:>12.0f} accounts/s", "unique via index",
+								 static_cast<double>(accounts) / elapsed.count())
+				  << std::endl;
+	}
+}
+
+// take_loan against customers holding more and more accounts, it should not slow down
+void bench_loan_eligibility() {
+	std::cout << std::format("== take_loan eligibility ==") << std::endl;
+	std::cout << std::format("{:>10} | {:>16}", "accounts", "ns/take_loan") << std::endl;
+
+	const size_t loans = 10000;
+	for (size_t held : {1, 100, 10000}) {
+		Bank bank("loans", bank_fingerprint);
+		Person owner("borrower", 30, "Male", "borrower-fingerprint", 5, true);
+		Account* account = nullptr;
+		for (size_t i = 0; i < held; ++i) {
+			account = bank.create_account(owner, "borrower-fingerprint", password);
+			bank.deposit(*account, "borrower-fingerprint", 1000.0);
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < loans; ++i)
+			bank.take_loan(*account, "borrower-fingerprint", 0.01);
+		std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+		std::cout << std::format("{:>10} | {:>16.1f}", held, elapsed.count() / loans) << std::endl;
+	}
+}
+
+// The same transfers as single journaled calls and as batches, each batch waits for one commit
+void bench_batch(size_t accounts, size_t transfers) {
+	const std::string path = "bank_bench_batch.wal";
+	std::cout << std::format("== batch transfers: {} accounts, {} journaled transfers ==", accounts, transfers) << std::endl;
+	std::cout << std::format("{:>12} | {:>12} | {:>16}", "mode", "batch size", "transfers/s") << std::endl;
+
+	auto measure = [&](const std::string& mode, size_t batch_size) {
+		std::remove(path.c_str());
+		Bank bank("batch", bank_fingerprint);
+		Journal journal(path);
+		ConcurrentBank concurrent(bank, &journal);
+		std::vector<Customer> customers(accounts);
+		for (size_t i = 0; i < accounts; ++i) {
+			auto& c = customers[i];
+			c.fingerprint = std::format("fingerprint-{}", i);
+			c.person = std::make_unique<Person>(std::format("customer-{}", i), 30, "Female", c.fingerprint, 5, true);
+			c.account = concurrent.create_account(*c.person, c.fingerprint, password);
+			bank.deposit(*c.account, c.fingerprint, 1e9);
+			c.CVV2 = c.account->get_CVV2(c.fingerprint);
+			c.exp_date = c.account->get_exp_date(c.fingerprint);
+		}
+
+		std::mt19937_64 gen(1);
+		std::uniform_int_distribution<size_t> pick(0, accounts - 1);
+		std::vector<BatchOperation> operations;
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < transfers; ++i) {
+			auto& from = customers[pick(gen)];
+			auto& to = customers[pick(gen)];
+			if (mode == "single") {
+				concurrent.transfer(*from.account, *to.account, from.fingerprint, from.CVV2, password, from.exp_date, 1.0);
+				continue;
+			}
+			operations.push_back({BatchOperationType::Transfer, from.account, to.account, from.fingerprint, 1.0,
+								  from.CVV2, password, from.exp_date});
+			if (operations.size() == batch_size || i + 1 == transfers) {
+				concurrent.submit(operations, mode == "atomic" ? BatchMode::Atomic : BatchMode::PerOperation);
+				operations.clear();
+			}
+		}
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		std::cout << std::format("{:>12} | {:>12} | {:>16.0f}", mode, batch_size,
+								 static_cast<double>(transfers) / elapsed.count())
+				  << std::endl;
+	};
+
+	measure("single", 1);
+	for (size_t batch_size : {16, 256, 4096}) {
+		measure("per-op", batch_size);
+		measure("atomic", batch_size);
+	}
+	std::remove(path.c_str());
+}
+
+// The authenticated hot path: the fingerprint hashed on every call against a session token
+void bench_sessions(size_t ops) {
+	std::cout << std::format("== authenticated deposits: {} per row ==", ops) << std::endl;
+	std::cout << std::format("{:>18} | {:>16} | {:>16} | {:>8}", "fingerprint bytes", "fingerprint ns", "session ns", "speedup")
+			  << std::endl;
+
+	for (size_t length : {16, 256, 4096}) {
+		Bank bank("sessions", bank_fingerprint);
+		ConcurrentBank concurrent(bank);
+		std::string fingerprint(length, 'f');
+		Person person("session-owner", 30, "Female", fingerprint, 5, true);
+		auto* account = concurrent.create_account(person, fingerprint, password);
+
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < ops; ++i)
+			concurrent.deposit(*account, fingerprint, 1.0);
+		std::chrono::duration<double, std::nano> plain = std::chrono::steady_clock::now() - start;
+
+		auto session = concurrent.open_session(person, fingerprint);
+		start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < ops; ++i)
+			concurrent.deposit(*account, session, 1.0);
+		std::chrono::duration<double, std::nano> tokened = std::chrono::steady_clock::now() - start;
+
+		std::cout << std::format("{:>18} | {:>16.1f} | {:>16.1f} | {:>7.2f}x", length, plain.count() / ops,
+								 tokened.count() / ops, plain.count() / tokened.count())
+				  << std::endl;
+	}
+}
+
+// Bytes malloc has handed out and not got back, chunk overhead included. glibc only, 0 elsewhere.
+size_t heap_in_use() {
+#if defined(__GLIBC__)
+	auto info = mallinfo2();
+	return info.uordblks + info.hblkhd;
+#else
+	return 0;
+#endif
+}
+
+// Heap cost of an account held by a Bank against the same accounts packed into a vector
+void bench_account_layout(size_t count) {
+	std::cout << std::format("== account layout: {} accounts ==", count) << std::endl;
+	std::cout << std::format("{:>18} | {:>8} | {:>16}", "layout", "sizeof", "bytes/account") << std::endl;
+
+	const size_t per_owner = 100;
+	std::vector<std::unique_ptr<Person>> owners;
+	std::vector<std::string> fingerprints;
+	for (size_t i = 0; i < (count + per_owner - 1) / per_owner; ++i) {
+		fingerprints.push_back(std::format("fingerprint-{}", i));
+		owners.push_back(std::make_unique<Person>(std::format("customer-{}", i), 30, "Female", fingerprints.back(), 5, true));
+	}
+	std::vector<Account*> accounts;
+	accounts.reserve(count);
+
+	Bank bank("layout", bank_fingerprint);
+	auto before = heap_in_use();
+	for (size_t i = 0; i < count; ++i)
+		accounts.push_back(bank.create_account(*owners[i / per_owner], fingerprints[i / per_owner], password));
+	auto held = heap_in_use() - before;
+
+	before = heap_in_use();
+	OwnerIds ids;
+	std::vector<PackedAccount> packed;
+	packed.reserve(count);
+	for (size_t i = 0; i < count; ++i)
+		packed.push_back(pack(*accounts[i], ids, fingerprints[i / per_owner]));
+	auto compact = heap_in_use() - before;
+
+	std::cout << std::format("{:>18} | {:>8} | {:>16.1f}", "Account in a Bank", sizeof(Account),
+							 static_cast<double>(held) / static_cast<double>(count))
+			  << std::endl;
+	std::cout << std::format("{:>18} | {:>8} | {:>16.1f}", "PackedAccount", sizeof(PackedAccount),
+							 static_cast<double>(compact) / static_cast<double>(count))
+			  << std::endl;
+}
+
+// Account churn: open a wave of accounts and close them all, new/delete against a SlabPool
+void bench_account_pool(size_t accounts, size_t rounds) {
+	std::cout << std::format("== account allocation: {} rounds of {} accounts ==", rounds, accounts) << std::endl;
+	std::cout << std::format("{:>12} | {:>20}", "allocator", "ns/create+destroy") << std::endl;
+
+	Bank bank("pool", bank_fingerprint);
+	Person owner("pool-owner", 30, "Female", "pool-fingerprint", 5, true);
+	std::vector<Account*> wave(accounts);
+	auto churn = [&](const std::string& name, const std::function<Account*()>& create,
+					 const std::function<void(Account*)>& destroy) {
+		auto start = std::chrono::steady_clock::now();
+		for (size_t round = 0; round < rounds; ++round) {
+			for (auto& account : wave)
+				account = create();
+			for (auto* account : wave)
+				destroy(account);
+		}
+		std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+		std::cout << std::format("{:>12} | {:>20.1f}", name, elapsed.count() / static_cast<double>(accounts * rounds))
+				  << std::endl;
+	};
+
+	churn("new/delete", [&] { return new Account(&owner, &bank, password); }, [](Account* account) { delete account; });
+	SlabPool<Account> pool;
+	churn("SlabPool", [&] { return pool.create(&owner, &bank, password); }, [&](Account* account) { pool.destroy(account); });
+}
+
+// Whole-bank aggregates: walking the Account pointers against the columnar store
+void bench_columnar_reports(size_t accounts) {
+	std::cout << std::format("== whole-bank reports: {} accounts ==", accounts) << std::endl;
+	std::cout << std::format("{:>12} | {:>16} | {:>16} | {:>8}", "report", "pointers ms", "columns ms", "speedup")
+			  << std::endl;
+
+	Bank bank("reports", bank_fingerprint);
+	ConcurrentBank concurrent(bank);
+	Person owner("report-owner", 30, "Female", "report-fingerprint", 5, true);
+	for (size_t i = 0; i < accounts; ++i)
+		concurrent.deposit(*concurrent.create_account(owner, "report-fingerprint", password), "report-fingerprint",
+						   static_cast<double>(i % 10000));
+	std::string fingerprint = bank_fingerprint;
+	const auto& held = bank.get_bank_accounts(fingerprint);
+	const Money width(100000);
+	const size_t buckets = 16;
+
+	auto time = [](const std::function<void()>& report) {
+		const int repeats = 10;
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < repeats; ++i)
+			report();
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		return elapsed.count() / repeats;
+	};
+	auto row = [](const std::string& report, double pointers, double columns) {
+		std::cout << std::format("{:>12} | {:>16.2f} | {:>16.2f} | {:>7.2f}x", report, pointers, columns, pointers / columns)
+				  << std::endl;
+	};
+
+	Money total;
+	row("sum", time([&] {
+			Money sum;
+			for (const auto* account : held)
+				sum += Money::from_double(account->get_balance());
+			total = sum;
+		}),
+		time([&] { total = concurrent.total_balance(); }));
+
+	size_t active = 0;
+	row("by status", time([&] {
+			size_t count = 0;
+			for (const auto* account : held)
+				count += account->get_status();
+			active = count;
+		}),
+		time([&] { active = concurrent.count_by_status().active; }));
+
+	std::vector<size_t> counts;
+	row("histogram", time([&] {
+			std::vector<size_t> histogram(buckets, 0);
+			for (const auto* account : held) {
+				auto bucket = Money::from_double(account->get_balance()).get_minor_units() / width.get_minor_units();
+				histogram[std::min<size_t>(static_cast<size_t>(bucket), buckets - 1)]++;
+			}
+			counts = histogram;
+		}),
+		time([&] { counts = concurrent.balance_histogram(width, buckets); }));
+}
+
+// A year of transfers in the ledger, then one account's month: the account index against a scan
+void bench_ledger(size_t accounts, size_t entries) {
+	std::cout << std::format("== ledger: {} entries over {} accounts ==", entries, accounts) << std::endl;
+
+	using namespace std::chrono;
+	system_clock::time_point now{};
+	auto step = duration_cast<system_clock::duration>(hours(24 * 365)) / static_cast<std::int64_t>(entries);
+	Ledger ledger([&] { return now += step; });
+	std::mt19937_64 gen(7);
+	std::uniform_int_distribution<std::uint64_t> pick(1, accounts);
+
+	auto start = steady_clock::now();
+	for (size_t i = 0; i < entries; ++i)
+		ledger.append(LedgerEntryType::Transfer, pick(gen), pick(gen), Money(100));
+	duration<double> appended = steady_clock::now() - start;
+	std::cout << std::format("{:>24}: {:>12.0f} entries/s", "append", static_cast<double>(entries) / appended.count())
+			  << std::endl;
+
+	const std::uint64_t account = 1;
+	LedgerQuery month{.from = system_clock::time_point{} + hours(24 * 180), .to = system_clock::time_point{} + hours(24 * 210),
+					  .limit = entries};
+	start = steady_clock::now();
+	auto indexed = ledger.history(account, month).entries.size();
+	duration<double, std::micro> by_index = steady_clock::now() - start;
+
+	start = steady_clock::now();
+	size_t scanned = 0;
+	for (std::uint64_t sequence = 0; sequence < ledger.size(); ++sequence) {
+		auto entry = *ledger.at(sequence);
+		scanned += entry.time >= month.from && entry.time < month.to && (entry.account == account || entry.counterparty == account);
+	}
+	duration<double, std::micro> by_scan = steady_clock::now() - start;
+
+	std::cout << std::format("{:>24}: {:>12.1f} us for {} entries", "account month, indexed", by_index.count(), indexed)
+			  << std::endl;
+	std::cout << std::format("{:>24}: {:>12.1f} us for {} entries", "account month, scan", by_scan.count(), scanned)
+			  << std::endl;
+}
+
+// Transfers while a reporter keeps summing the whole bank from read views, against no reporter
+void bench_read_views(size_t accounts, size_t ops) {
+	std::cout << std::format("== read views: {} accounts, {} transfers per thread ==", accounts, ops) << std::endl;
+	std::cout << std::format("{:>16} | {:>16} | {:>12} | {:>16}", "reporter", "transfers/s", "reports", "us/view") << std::endl;
+
+	size_t threads = std::max(2u, std::thread::hardware_concurrency());
+	for (bool reporting : {false, true}) {
+		Bank bank("views", bank_fingerprint);
+		ConcurrentBank concurrent(bank);
+		std::vector<Customer> customers(accounts);
+		for (size_t i = 0; i < accounts; ++i) {
+			auto& c = customers[i];
+			c.fingerprint = std::format("fingerprint-{}", i);
+			c.person = std::make_unique<Person>(std::format("customer-{}", i), 30, "Female", c.fingerprint, 5, true);
+			c.account = concurrent.create_account(*c.person, c.fingerprint, password);
+			concurrent.deposit(*c.account, c.fingerprint, 1e9);
+			c.CVV2 = c.account->get_CVV2(c.fingerprint);
+			c.exp_date = c.account->get_exp_date(c.fingerprint);
+		}
+
+		std::atomic<bool> done{false};
+		size_t reports = 0;
+		double view_us = 0;
+		std::thread reporter([&] {
+			while (reporting && !done.load(std::memory_order_relaxed)) {
+				auto start = std::chrono::steady_clock::now();
+				auto view = concurrent.read_view();
+				view_us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+				// A long report, it never holds the transfers up
+				view.sum();
+				view.histogram(Money(100000000), 16);
+				reports++;
+			}
+		});
+		double rate = run(threads, ops, customers, [&](Customer& from, Customer& to) {
+			concurrent.transfer(*from.account, *to.account, from.fingerprint, from.CVV2, password, from.exp_date, 1.0);
+		});
+		done = true;
+		reporter.join();
+
+		std::cout << std::format("{:>16} | {:>16.0f} | {:>12} | {:>16.1f}", reporting ? "read views" : "none", rate, reports,
+								 reports ? view_us / static_cast<double>(reports) : 0.0)
+				  << std::endl;
+	}
+}
+
+// A whole-bank report to a file in each format, against the old per-line std::endl writes
+void bench_report(size_t accounts) {
+	std::cout << std::format("== report: {} accounts ==", accounts) << std::endl;
+	std::cout << std::format("{:>16} | {:>12} | {:>12} | {:>12}", "format", "ms", "MB", "MB/s") << std::endl;
+
+	Bank bank("report", bank_fingerprint);
+	auto customers = populate(bank, accounts);
+	auto path = (std::filesystem::temp_directory_path() / "bank_bench_report").string();
+	auto row = [&](const char* name, const std::function<void()>& write) {
+		auto start = std::chrono::steady_clock::now();
+		write();
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		double mb = static_cast<double>(std::filesystem::file_size(path)) / (1024.0 * 1024.0);
+		std::cout << std::format("{:>16} | {:>12.1f} | {:>12.1f} | {:>12.1f}", name, elapsed.count() * 1000, mb,
+								 mb / elapsed.count())
+				  << std::endl;
+	};
+
+	row("text, per line", [&] {
+		std::ofstream os(path);
+		os << std::format("bank name: {} | bank total balance: {} | bank total loan: {} | ", "report", 0, 0) << std::endl;
+		for (const auto& c : customers) {
+			const Person& p = *c.person;
+			os << std::format("name : {:<7} | age : {:<3} | gender : {:<6} | hashed_fingerprint : {:<10} | "
+							  "socioeconomic_rank : {:<2} | is_alive : {} ",
+							  p.get_name(), p.get_age(), p.get_gender(), p.get_hashed_fingerprint(),
+							  p.get_socioeconomic_rank(), p.get_is_alive())
+			   << std::endl;
+			os << std::format("account number: {} | balance: {} | exp_date: {} | account_status: {}",
+							  c.account->get_account_number(), c.account->get_balance(), c.exp_date, c.account->get_status())
+			   << std::endl;
+			os << std::format("paid loan: {} |unpaid loan : {} ", 0, 0) << std::endl;
+		}
+	});
+	for (auto [name, extension] : {std::pair{"text, streamed", ""}, {"csv, streamed", ".csv"}, {"json, streamed", ".json"}}) {
+		auto target = path + extension;
+		row(name, [&] {
+			FileSink sink(path);
+			write_report(bank, sink, report_format_for(target));
+		});
+	}
+	std::cout << std::format("{:>16}: {} KiB, whatever the number of accounts", "writer buffer",
+							 ReportWriter::BUFFER_SIZE / 1024)
+			  << std::endl;
+	std::filesystem::remove(path);
+}
+
+// The end-of-day loan job over every customer, with more and more threads
+void bench_end_of_day(size_t customers) {
+	std::cout << std::format("== end of day: {} customers with loans ==", customers) << std::endl;
+	std::cout << std::format("{:>8} | {:>10} | {:>12} | {:>14} | {:>14}", "threads", "ms", "customers/s",
+							 "partition min", "partition max")
+			  << std::endl;
+
+	Bank bank("end-of-day", bank_fingerprint);
+	auto population = populate(bank, customers);
+	for (auto& c : population)
+		bank.take_loan(*c.account, c.fingerprint, 1000.0);
+
+	size_t most = std::max(4u, std::thread::hardware_concurrency());
+	for (size_t threads = 1; threads <= most; threads *= 2) {
+		auto report = EndOfDay::run(bank, bank_fingerprint, EndOfDayPolicy{.daily_rate = 0.0005, .threads = threads});
+		auto [fastest, slowest] = std::minmax_element(report.partitions.begin(), report.partitions.end(),
+													  [](const auto& a, const auto& b) { return a.elapsed < b.elapsed; });
+		double ms = std::chrono::duration<double, std::milli>(report.elapsed).count();
+		std::cout << std::format("{:>8} | {:>10.1f} | {:>12.0f} | {:>11.2f} ms | {:>11.2f} ms", threads, ms,
+								 static_cast<double>(customers) / ms * 1000,
+								 std::chrono::duration<double, std::milli>(fastest->elapsed).count(),
+								 std::chrono::duration<double, std::milli>(slowest->elapsed).count())
+				  << std::endl;
+	}
+}
+
+// Random transfers over a cluster of 1, 2, 4 and 8 shards: throughput and per-transfer latency.
+// A cross-shard transfer is a two-phase commit, so latency grows with the share of those.
+void bench_cluster(size_t accounts, size_t ops) {
+	std::cout << std::format("== cluster: {} accounts, {} transfers per thread ==", accounts, ops) << std::endl;
+	std::cout << std::format("{:>8} | {:>12} | {:>10} | {:>10} | {:>10}", "shards", "transfers/s", "cross", "p50 us",
+							 "p99 us")
+			  << std::endl;
+
+	size_t threads = std::max(2u, std::thread::hardware_concurrency());
+	for (size_t shards : {1, 2, 4, 8}) {
+		BankCluster cluster(shards, "cluster", bank_fingerprint);
+		std::vector<Customer> customers(accounts);
+		for (size_t i = 0; i < accounts; ++i) {
+			auto& c = customers[i];
+			c.fingerprint = std::format("fingerprint-{}", i);
+			c.person = std::make_unique<Person>(std::format("customer-{}", i), 30, "Female", c.fingerprint, 5, true);
+			c.account = cluster.create_account(*c.person, c.fingerprint, password);
+			cluster.deposit(*c.account, c.fingerprint, 1e9);
+			c.CVV2 = c.account->get_CVV2(c.fingerprint);
+			c.exp_date = c.account->get_exp_date(c.fingerprint);
+		}
+
+		std::vector<LatencyHistogram> latencies(threads);
+		auto start = std::chrono::steady_clock::now();
+		std::vector<std::thread> workers;
+		for (size_t t = 0; t < threads; ++t)
+			workers.emplace_back([&, t] {
+				std::mt19937_64 gen(t + 1);
+				std::uniform_int_distribution<size_t> pick(0, customers.size() - 1);
+				for (size_t i = 0; i < ops; ++i) {
+					auto& from = customers[pick(gen)];
+					auto& to = customers[pick(gen)];
+					auto begin = std::chrono::steady_clock::now();
+					cluster.transfer(*from.account, *to.account, from.fingerprint, from.CVV2, password, from.exp_date, 1.0);
+					latencies[t].record(static_cast<std::uint64_t>(
+						std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count()));
+				}
+			});
+		for (auto& worker : workers)
+			worker.join();
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		LatencyHistogram all;
+		for (const auto& latency : latencies)
+			all.merge(latency);
+		auto stats = cluster.stats();
+		double cross = static_cast<double>(stats.committed) / static_cast<double>(stats.committed + stats.local_transfers);
+		std::cout << std::format("{:>8} | {:>12.0f} | {:>9.1f}% | {:>10.2f} | {:>10.2f}", shards,
+								 static_cast<double>(all.count()) / elapsed.count(), cross * 100,
+								 static_cast<double>(all.value_at_percentile(50)) / 1000,
+								 static_cast<double>(all.value_at_percentile(99)) / 1000)
+				  << std::endl;
+	}
+}
+
+// Shares of each kind of operation in the mixed workload, e.g. "30:20:45:5"
+struct WorkloadMix {
+	unsigned deposit{30};
+	unsigned withdraw{20};
+	unsigned transfer{45};
+	unsigned loan{5}; // take_loan and pay_loan in turn
+
+	static WorkloadMix parse(const std::string& text) {
+		WorkloadMix mix;
+		if (std::sscanf(text.c_str(), "%u:%u:%u:%u", &mix.deposit, &mix.withdraw, &mix.transfer, &mix.loan) != 4 ||
+			mix.deposit + mix.withdraw + mix.transfer + mix.loan == 0)
+			throw std::invalid_argument(std::format("workload mix {} isn't deposit:withdraw:transfer:loan", text));
+		return mix;
+	}
+};
+
+// Account i is picked with probability proportional to 1 / (i + 1)^exponent, 0 is uniform
+class ZipfPicker {
+public:
+	ZipfPicker(size_t accounts, double exponent) : cdf(accounts) {
+		double total = 0;
+		for (size_t i = 0; i < accounts; ++i)
+			cdf[i] = total += 1.0 / std::pow(static_cast<double>(i + 1), exponent);
+		for (auto& share : cdf)
+			share /= total;
+	}
+
+	size_t operator()(std::mt19937_64& gen) const {
+		double u = std::uniform_real_distribution<double>(0.0, 1.0)(gen);
+		return std::min<size_t>(static_cast<size_t>(std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin()),
+								cdf.size() - 1);
+	}
+
+private:
+	std::vector<double> cdf;
+};
+
+// The mixed workload on a ConcurrentBank, uniform and skewed, with more and more threads:
+// ops/s and latency percentiles from per-thread histograms
+void bench_mixed_workload(size_t accounts, size_t ops, WorkloadMix mix, double zipf) {
+	std::cout << std::format("== mixed workload: {} accounts, {} ops per thread, deposit:withdraw:transfer:loan {}:{}:{}:{} ==",
+							 accounts, ops, mix.deposit, mix.withdraw, mix.transfer, mix.loan)
+			  << std::endl;
+	std::cout << std::format("{:>6} | {:>8} | {:>12} | {:>9} | {:>9} | {:>9} | {:>9}", "zipf", "threads", "ops/s",
+							 "p50 us", "p99 us", "p999 us", "max us")
+			  << std::endl;
+
+	Bank bank("mixed", bank_fingerprint);
+	ConcurrentBank concurrent(bank);
+	std::vector<Customer> customers(accounts);
+	for (size_t i = 0; i < accounts; ++i) {
+		auto& c = customers[i];
+		c.fingerprint = std::format("fingerprint-{}", i);
+		c.person = std::make_unique<Person>(std::format("customer-{}", i), 30, "Female", c.fingerprint, 5, true);
+		c.account = concurrent.create_account(*c.person, c.fingerprint, password);
+		concurrent.deposit(*c.account, c.fingerprint, 1e9);
+		c.CVV2 = c.account->get_CVV2(c.fingerprint);
+		c.exp_date = c.account->get_exp_date(c.fingerprint);
+	}
+
+	unsigned shares = mix.deposit + mix.withdraw + mix.transfer + mix.loan;
+	size_t max_threads = std::max(4u, std::thread::hardware_concurrency());
+	for (double exponent : {0.0, zipf}) {
+		ZipfPicker pick(accounts, exponent);
+		for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+			std::vector<LatencyHistogram> latencies(threads);
+			auto start = std::chrono::steady_clock::now();
+			std::vector<std::thread> workers;
+			for (size_t t = 0; t < threads; ++t)
+				workers.emplace_back([&, t] {
+					std::mt19937_64 gen(t + 1);
+					std::uniform_int_distribution<unsigned> kind(0, shares - 1);
+					Account* borrower = nullptr; // repaid by the next loan operation of this thread
+					for (size_t i = 0; i < ops; ++i) {
+						auto& c = customers[pick(gen)];
+						unsigned k = kind(gen);
+						auto begin = std::chrono::steady_clock::now();
+						if (k < mix.deposit) {
+							concurrent.deposit(*c.account, c.fingerprint, 1.0);
+						} else if ((k -= mix.deposit) < mix.withdraw) {
+							concurrent.withdraw(*c.account, c.fingerprint, 1.0);
+						} else if ((k -= mix.withdraw) < mix.transfer) {
+							auto& to = customers[pick(gen)];
+							concurrent.transfer(*c.account, *to.account, c.fingerprint, c.CVV2, password, c.exp_date, 1.0);
+						} else if (borrower) {
+							concurrent.pay_loan(*borrower, 1.0);
+							borrower = nullptr;
+						} else {
+							concurrent.take_loan(*c.account, c.fingerprint, 1.0);
+							borrower = c.account;
+						}
+						latencies[t].record(static_cast<std::uint64_t>(
+							std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count()));
+					}
+				});
+			for (auto& worker : workers)
+				worker.join();
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+			LatencyHistogram all;
+			for (const auto& latency : latencies)
+				all.merge(latency);
+			auto us = [](std::uint64_t nanoseconds) { return static_cast<double>(nanoseconds) / 1000; };
+			std::cout << std::format("{:>6.2f} | {:>8} | {:>12.0f} | {:>9.2f} | {:>9.2f} | {:>9.2f} | {:>9.2f}", exponent,
+									 threads, static_cast<double>(all.count()) / elapsed.count(),
+									 us(all.value_at_percentile(50)), us(all.value_at_percentile(99)),
+									 us(all.value_at_percentile(99.9)), us(all.max()))
+					  << std::endl;
+		}
+	}
+}
+
+// Transfer latency with and without the fraud monitor behind it, and how much it kept up with
+void bench_fraud_monitor(size_t accounts, size_t ops) {
+	std::cout << std::format("== fraud monitor: {} accounts, {} transfers per thread ==", accounts, ops) << std::endl;
+	std::cout << std::format("{:>10} | {:>12} | {:>9} | {:>9} | {:>9} | {:>10} | {:>8}", "stage", "transfers/s", "p50 us",
+							 "p99 us", "p999 us", "dropped", "alerts")
+			  << std::endl;
+
+	size_t threads = std::max(2u, std::thread::hardware_concurrency());
+	for (bool watched : {false, true}) {
+		Bank bank("fraud", bank_fingerprint);
+		ConcurrentBank concurrent(bank);
+		std::vector<Customer> customers(accounts);
+		for (size_t i = 0; i < accounts; ++i) {
+			auto& c = customers[i];
+			c.fingerprint = std::format("fingerprint-{}", i);
+			c.person = std::make_unique<Person>(std::format("customer-{}", i), 30, "Female", c.fingerprint, 5, true);
+			c.account = concurrent.create_account(*c.person, c.fingerprint, password);
+			concurrent.deposit(*c.account, c.fingerprint, 1e9);
+			c.CVV2 = c.account->get_CVV2(c.fingerprint);
+			c.exp_date = c.account->get_exp_date(c.fingerprint);
+		}
+		FraudMonitor monitor(FraudRules{}, nullptr);
+		if (watched)
+			concurrent.set_commit_stage(&monitor);
+
+		std::vector<LatencyHistogram> latencies(threads);
+		auto start = std::chrono::steady_clock::now();
+		std::vector<std::thread> workers;
+		for (size_t t = 0; t < threads; ++t)
+			workers.emplace_back([&, t] {
+				std::mt19937_64 gen(t + 1);
+				std::uniform_int_distribution<size_t> pick(0, customers.size() - 1);
+				for (size_t i = 0; i < ops; ++i) {
+					auto& from = customers[pick(gen)];
+					auto& to = customers[pick(gen)];
+					auto begin = std::chrono::steady_clock::now();
+					concurrent.transfer(*from.account, *to.account, from.fingerprint, from.CVV2, password, from.exp_date, 1.0);
+					latencies[t].record(static_cast<std::uint64_t>(
+						std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count()));
+				}
+			});
+		for (auto& worker : workers)
+			worker.join();
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		monitor.drain();
+		concurrent.set_commit_stage(nullptr);
+
+		LatencyHistogram all;
+		for (const auto& latency : latencies)
+			all.merge(latency);
+		auto stats = monitor.stats();
+		auto us = [](std::uint64_t nanoseconds) { return static_cast<double>(nanoseconds) / 1000; };
+		std::cout << std::format("{:>10} | {:>12.0f} | {:>9.2f} | {:>9.2f} | {:>9.2f} | {:>10} | {:>8}",
+								 watched ? "monitor" : "none", static_cast<double>(all.count()) / elapsed.count(),
+								 us(all.value_at_percentile(50)), us(all.value_at_percentile(99)),
+								 us(all.value_at_percentile(99.9)), stats.dropped, stats.alerts)
+				  << std::endl;
+	}
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+	size_t accounts = argc > 1 ? std::stoul(argv[1]) : 10000;
+	size_t ops = argc > 2 ? std::stoul(argv[2]) : 200000;
+	size_t layout_accounts = argc > 3 ? std::stoul(argv[3]) : 10000000;
+	auto mix = argc > 4 ? WorkloadMix::parse(argv[4]) : WorkloadMix{};
+	double zipf = argc > 5 ? std::stod(argv[5]) : 0.99;
+
+	bench_account_creation(accounts);
+	bench_transfer_scaling(accounts, ops);
+	bench_mixed_workload(accounts, ops, mix, zipf);
+	bench_hot_account(ops);
+	bench_journal_commits(std::max<size_t>(ops / 100, 100));
+	bench_snapshot(accounts);
+	bench_deletion(accounts);
+	bench_account_pool(accounts, 20);
+	bench_loan_eligibility();
+	bench_batch(accounts, std::max<size_t>(ops / 20, 1000));
+	bench_sessions(ops);
+	bench_ledger(accounts, std::max<size_t>(ops * 10, 1000000));
+	bench_read_views(std::max<size_t>(accounts, 100000), ops);
+	bench_columnar_reports(std::max<size_t>(accounts, 1000000));
+	bench_cluster(accounts, ops);
+	bench_fraud_monitor(accounts, ops);
+	bench_end_of_day(std::max<size_t>(accounts, 200000));
+	bench_report(std::max<size_t>(accounts, 200000));
+	bench_account_layout(layout_accounts);
+	return 0;
+}
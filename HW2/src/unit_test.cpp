@@ -4,11 +4,32 @@
 #include <fstream> // For file operations
 #include <regex> // Include for std::regex
 #include <cmath>
+#include <cstdio> // For std::remove
+#include <algorithm> // For std::find, std::sort
+#include <atomic> // For std::atomic
+#include <iterator> // For std::istreambuf_iterator
+#include <memory> // For std::unique_ptr
+#include <thread> // For std::thread
+#include <type_traits> // For std::is_constructible_v
 
 
 #include "Account.h" 
+#include "AccountIndex.h"
+#include "AccountNumbers.h"
 #include "Bank.h"
+#include "BankCluster.h"
+#include "ConcurrentBank.h"
+#include "EndOfDay.h"
+#include "FraudMonitor.h"
+#include "Journal.h"
+#include "LatencyHistogram.h"
+#include "Ledger.h"
+#include "Money.h"
+#include "PackedAccount.h"
 #include "Person.h"
+#include "Report.h"
+#include "SlabPool.h"
+#include "Snapshot.h"
 
 
 // "============================================="
@@ -444,6 +465,27 @@ TEST_F(BankTest, Bank_DeleteAccountIntegrityCheck) {
     delete person;
 }
 
+TEST_F(BankTest, Bank_DeleteAccountDropsItsBalanceFromLoanLimit) {
+    Bank bank = createValidBank();
+    Person* person = createValidPerson();
+    std::string ownerFingerprint = "personFingerprint";
+    std::string password = "securePassword";
+
+    Account* funded = bank.create_account(*person, ownerFingerprint, password);
+    Account* kept = bank.create_account(*person, ownerFingerprint, password);
+    bank.deposit(*funded, ownerFingerprint, 5000.0);
+    EXPECT_ANY_THROW({bank.delete_account(*funded, ownerFingerprint);}) << "A funded account should not be deleted.";
+
+    // Emptied and deleted, its money no longer counts towards a loan
+    bank.withdraw(*funded, ownerFingerprint, 5000.0);
+    bank.delete_account(*funded, ownerFingerprint);
+    EXPECT_ANY_THROW({bank.take_loan(*kept, ownerFingerprint, 10.0);}) << "Loan limit still counts a deleted account.";
+    EXPECT_EQ(bank.get_bank_total_loan(validBankFingerprint), 0.0);
+
+    // Clean up
+    delete person;
+}
+
 TEST_F(BankTest, Bank_DeleteAccountUnpaidLoanFailure) {
     Bank bank = createValidBank();
     Person* person = createValidPerson();
@@ -758,4 +800,1496 @@ TEST_F(BankTest, Bank_PayLoanSuccessAndRankUpgrade) {
 
     // Clean up
     delete person;
-}
\ No newline at end of file
+}
+// "============================================="
+// "          ConcurrentBank Class Tests         "
+// "============================================="
+
+TEST_F(BankTest, ConcurrentBank_ParallelTransfersConserveMoney) {
+    Bank bank = createValidBank();
+    ConcurrentBank concurrent(bank);
+    std::string password = "securePassword";
+
+    std::vector<std::unique_ptr<Person>> persons;
+    std::vector<Account*> accounts;
+    std::vector<std::string> fingerprints, cvv2s, expDates;
+    for (size_t i = 0; i < 8; ++i) {
+        fingerprints.push_back("fingerprint" + std::to_string(i));
+        persons.push_back(std::make_unique<Person>("Person", 30, "Female", fingerprints[i], 5, true));
+        accounts.push_back(concurrent.create_account(*persons[i], fingerprints[i], password));
+        concurrent.deposit(*accounts[i], fingerprints[i], 1000.0);
+        cvv2s.push_back(accounts[i]->get_CVV2(fingerprints[i]));
+        expDates.push_back(accounts[i]->get_exp_date(fingerprints[i]));
+    }
+
+    // Every pair is transferred in both directions at once, which deadlocks without ordered locking
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t] {
+            for (size_t k = 0; k < 2000; ++k) {
+                size_t from = (t % 2 == 0) ? k % 8 : (k + 1) % 8;
+                size_t to = (t % 2 == 0) ? (k + 1) % 8 : k % 8;
+                concurrent.transfer(*accounts[from], *accounts[to], fingerprints[from], cvv2s[from], password, expDates[from], 1.0);
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    double total = 0.0;
+    for (auto* account : accounts)
+        total += account->get_balance();
+    EXPECT_EQ(total, 8000.0) << "Concurrent transfers must neither create nor destroy money.";
+}
+
+TEST_F(BankTest, ConcurrentBank_ParallelDepositsAreNotLost) {
+    Bank bank = createValidBank();
+    ConcurrentBank concurrent(bank);
+    Person* person = createValidPerson();
+    std::string ownerFingerprint = "personFingerprint";
+    Account* account = concurrent.create_account(*person, ownerFingerprint, "securePassword");
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < 4; ++t)
+        threads.emplace_back([&] {
+            for (size_t k = 0; k < 5000; ++k)
+                concurrent.deposit(*account, ownerFingerprint, 1.0);
+        });
+    for (auto& thread : threads)
+        thread.join();
+
+    EXPECT_EQ(account->get_balance(), 20000.0) << "Every concurrent deposit should be applied exactly once.";
+    delete person;
+}
+
+TEST_F(BankTest, Money_RoundsToCentsWithoutDrift) {
+    EXPECT_EQ(Money::from_double(0.125).get_minor_units(), 13);
+    EXPECT_EQ(Money::from_double(-0.125).get_minor_units(), -13);
+    EXPECT_EQ(Money(-1234).to_string(), "-12.34");
+    EXPECT_EQ(Money(5).to_string(), "0.05");
+
+    Money total;
+    for (size_t k = 0; k < 1000000; ++k)
+        total += Money::from_double(0.1);
+    EXPECT_EQ(total, Money(10000000)) << "A million ten-cent deposits must add up to exactly 100000.00.";
+}
+
+TEST_F(BankTest, ConcurrentBank_ParallelWithdrawalsNeverOverdraw) {
+    Bank bank = createValidBank();
+    ConcurrentBank concurrent(bank);
+    Person* person = createValidPerson();
+    std::string ownerFingerprint = "personFingerprint";
+    Account* account = concurrent.create_account(*person, ownerFingerprint, "securePassword");
+    concurrent.deposit(*account, ownerFingerprint, 1000.0);
+
+    std::atomic<size_t> succeeded{0};
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < 4; ++t)
+        threads.emplace_back([&] {
+            for (size_t k = 0; k < 1000; ++k) {
+                try {
+                    concurrent.withdraw(*account, ownerFingerprint, 0.7);
+                    ++succeeded;
+                } catch (const std::invalid_argument&) {
+                }
+            }
+        });
+    for (auto& thread : threads)
+        thread.join();
+
+    EXPECT_EQ(succeeded.load(), 1428u) << "Exactly floor(1000 / 0.7) withdrawals fit in the balance.";
+    EXPECT_EQ(Money::from_double(account->get_balance()), Money(40));
+    delete person;
+}
+
+TEST_F(BankTest, Journal_RecoveryRebuildsBank) {
+    const std::string path = "journal_test.wal";
+    std::remove(path.c_str());
+    std::string ownerFingerprint = "personFingerprint";
+    std::vector<double> balances;
+    {
+        Bank bank = createValidBank();
+        Journal journal(path, JournalOptions{.batch_size = 4});
+        ConcurrentBank concurrent(bank, &journal);
+        Person* person = createValidPerson();
+        Account* first = concurrent.create_account(*person, ownerFingerprint, "securePassword");
+        Account* second = concurrent.create_account(*person, ownerFingerprint, "securePassword");
+        concurrent.deposit(*first, ownerFingerprint, 1000.0);
+        concurrent.withdraw(*first, ownerFingerprint, 150.25);
+        concurrent.transfer(*first, *second, ownerFingerprint, first->get_CVV2(ownerFingerprint),
+                            "securePassword", first->get_exp_date(ownerFingerprint), 300.0);
+        concurrent.take_loan(*second, ownerFingerprint, 100.0);
+        concurrent.pay_loan(*second, 40.0);
+        EXPECT_THROW(concurrent.withdraw(*first, ownerFingerprint, 1e6), std::invalid_argument);
+        balances = {first->get_balance(), second->get_balance()};
+        EXPECT_EQ(journal.get_stats().records, 8u) << "Failed calls must not reach the journal.";
+        delete person;
+    }
+
+    Bank recovered = createValidBank();
+    auto recovery = Journal::recover(path, recovered, validBankFingerprint);
+    EXPECT_EQ(recovery.records, 8u);
+    EXPECT_FALSE(recovery.torn_tail);
+    ASSERT_EQ(recovery.customers.size(), 1u);
+    ASSERT_EQ(recovery.accounts.size(), 2u);
+    EXPECT_EQ(recovery.accounts[0]->get_balance(), balances[0]);
+    EXPECT_EQ(recovery.accounts[1]->get_balance(), balances[1]);
+    EXPECT_NEAR(recovered.get_customer_2_unpaid_loan_map(validBankFingerprint).at(recovery.customers[0].get()), 61.67, 0.01);
+    EXPECT_EQ(recovery.accounts[0]->get_owner()->get_hashed_fingerprint(), hashFingerprint(ownerFingerprint));
+    std::remove(path.c_str());
+}
+
+TEST_F(BankTest, Journal_TornTailIsCutOff) {
+    const std::string path = "journal_torn.wal";
+    std::remove(path.c_str());
+    std::string ownerFingerprint = "personFingerprint";
+    Person* person = createValidPerson();
+    {
+        Bank bank = createValidBank();
+        Journal journal(path);
+        ConcurrentBank concurrent(bank, &journal);
+        Account* account = concurrent.create_account(*person, ownerFingerprint, "securePassword");
+        concurrent.deposit(*account, ownerFingerprint, 500.0);
+    }
+    {
+        // A crash in the middle of a write leaves half a frame behind
+        std::ofstream os(path, std::ios::binary | std::ios::app);
+        const char torn[] = {0x20, 0, 0, 0, 'g', 'a', 'r'};
+        os.write(torn, sizeof(torn));
+    }
+
+    Bank recovered = createValidBank();
+    auto recovery = Journal::recover(path, recovered, validBankFingerprint);
+    EXPECT_TRUE(recovery.torn_tail);
+    EXPECT_EQ(recovery.records, 3u);
+    {
+        Journal journal(path, {}, recovery);
+        ConcurrentBank concurrent(recovered, &journal);
+        concurrent.deposit(*recovery.accounts[0], ownerFingerprint, 250.0);
+    }
+
+    Bank again = createValidBank();
+    auto second = Journal::recover(path, again, validBankFingerprint);
+    EXPECT_FALSE(second.torn_tail) << "Resuming the journal should cut the torn record off.";
+    EXPECT_EQ(second.records, 4u);
+    EXPECT_EQ(second.accounts[0]->get_balance(), 750.0);
+    std::remove(path.c_str());
+    delete person;
+}
+
+// Reads a whole file, to check that no secret made it into a journal or a snapshot
+static std::string read_file(const std::string& path) {
+    std::ifstream is(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+}
+
+TEST_F(BankTest, Journal_RecoveryKeepsCardsStatusesAndExpiry) {
+    const std::string path = "journal_cards.wal";
+    std::remove(path.c_str());
+    std::string ownerFingerprint = "personFingerprint";
+    std::string leaverFingerprint = "leaverFingerprint";
+    std::string expDate = "12-31";
+    Person* person = createValidPerson();
+    Person leaver("Jane Roe", 40, "Female", leaverFingerprint, 3, true);
+    std::vector<std::string> numbers, cvv2s;
+    {
+        Bank bank = createValidBank();
+        Journal journal(path);
+        ConcurrentBank concurrent(bank, &journal);
+        Account* first = concurrent.create_account(*person, ownerFingerprint, "securePassword");
+        Account* second = concurrent.create_account(*person, ownerFingerprint, "securePassword");
+        concurrent.set_account_status(*second, false, validBankFingerprint);
+        concurrent.set_exp_date(*first, expDate, validBankFingerprint);
+        for (auto* account : {first, second}) {
+            numbers.push_back(account->get_account_number());
+            cvv2s.push_back(account->get_CVV2(ownerFingerprint));
+        }
+
+        // The freed slot is handed to the next account, which must get an id of its own
+        Account* gone = concurrent.create_account(leaver, leaverFingerprint, "leaverPassword");
+        concurrent.delete_customer(leaver, leaverFingerprint);
+        EXPECT_THROW(journal.account_id(*gone), std::out_of_range);
+        Account* third = concurrent.create_account(*person, ownerFingerprint, "securePassword");
+        concurrent.deposit(*third, ownerFingerprint, 75.0);
+        EXPECT_EQ(journal.account_id(*third), 3u);
+    }
+
+    Bank recovered = createValidBank();
+    auto recovery = Journal::recover(path, recovered, validBankFingerprint);
+    ASSERT_EQ(recovery.accounts.size(), 4u);
+    for (size_t i = 0; i < 2; ++i) {
+        EXPECT_EQ(recovery.accounts[i]->get_account_number(), numbers[i]);
+        EXPECT_EQ(recovery.accounts[i]->get_CVV2(ownerFingerprint), cvv2s[i]);
+    }
+    EXPECT_TRUE(recovery.accounts[0]->get_status());
+    EXPECT_FALSE(recovery.accounts[1]->get_status());
+    EXPECT_EQ(recovery.accounts[0]->get_exp_date(ownerFingerprint), expDate);
+    EXPECT_EQ(recovery.accounts[2], nullptr);
+    EXPECT_EQ(recovery.accounts[3]->get_balance(), 75.0);
+
+    // Only hashes were logged, yet the customer's own fingerprint and password still work
+    auto log = read_file(path);
+    for (const auto* secret : {"personFingerprint", "leaverFingerprint", "securePassword", "leaverPassword"})
+        EXPECT_EQ(log.find(secret), std::string::npos) << secret << " is in the journal.";
+    EXPECT_EQ(recovery.credentials[0].find(ownerFingerprint), std::string::npos);
+    EXPECT_TRUE(recovered.transfer(*recovery.accounts[3], *recovery.accounts[0], ownerFingerprint,
+                                   recovery.accounts[3]->get_CVV2(ownerFingerprint), "securePassword",
+                                   recovery.accounts[3]->get_exp_date(ownerFingerprint), 25.0));
+    EXPECT_THROW(recovered.transfer(*recovery.accounts[3], *recovery.accounts[0], ownerFingerprint,
+                                    recovery.accounts[3]->get_CVV2(ownerFingerprint), "wrongPassword",
+                                    recovery.accounts[3]->get_exp_date(ownerFingerprint), 25.0), std::invalid_argument);
+    EXPECT_THROW(recovered.deposit(*recovery.accounts[0], recovery.credentials[0], 1.0), std::invalid_argument)
+        << "A stand-in authenticates only while recovery runs.";
+    const std::string standIn = recovery.accounts[3]->get_password(ownerFingerprint);
+    EXPECT_NE(standIn, "securePassword");
+    EXPECT_THROW(recovered.transfer(*recovery.accounts[3], *recovery.accounts[0], ownerFingerprint,
+                                    recovery.accounts[3]->get_CVV2(ownerFingerprint), standIn,
+                                    recovery.accounts[3]->get_exp_date(ownerFingerprint), 25.0), std::invalid_argument)
+        << "The stored stand-in isn't the password.";
+    std::remove(path.c_str());
+    delete person;
+}
+
+TEST_F(BankTest, Snapshot_LoadThenReplayJournalTail) {
+    const std::string journalPath = "snapshot_test.wal";
+    const std::string snapshotPath = "snapshot_test.snap";
+    std::remove(journalPath.c_str());
+    std::string ownerFingerprint = "personFingerprint";
+    std::string leaverFingerprint = "leaverFingerprint";
+    Person* person = createValidPerson();
+    Person leaver("Jane Roe", 40, "Female", leaverFingerprint, 3, true);
+    double totalBalance, totalLoan, unpaid, paid, balance;
+    std::string number, cvv2;
+    {
+        Bank bank = createValidBank();
+        Journal journal(journalPath);
+        ConcurrentBank concurrent(bank, &journal);
+        Account* account = concurrent.create_account(*person, ownerFingerprint, "securePassword");
+        Account* spare = concurrent.create_account(*person, ownerFingerprint, "securePassword");
+        concurrent.deposit(*account, ownerFingerprint, 2000.0);
+        concurrent.take_loan(*account, ownerFingerprint, 333.33);
+        concurrent.pay_loan(*account, 100.0);
+        concurrent.delete_account(*spare, ownerFingerprint);
+
+        // A customer who paid off a loan and left, their interest stays in the bank's total
+        Account* gone = concurrent.create_account(leaver, leaverFingerprint, "leaverPassword");
+        concurrent.deposit(*gone, leaverFingerprint, 1000.0);
+        concurrent.take_loan(*gone, leaverFingerprint, 100.0);
+        concurrent.pay_loan(*gone, 103.33);
+        concurrent.delete_customer(leaver, leaverFingerprint);
+
+        auto stats = concurrent.snapshot(snapshotPath, validBankFingerprint);
+        EXPECT_EQ(stats.customers, 1u);
+        EXPECT_EQ(stats.accounts, 1u);
+
+        // Only this is left for the journal to replay
+        concurrent.withdraw(*account, ownerFingerprint, 250.5);
+
+        balance = account->get_balance();
+        number = account->get_account_number();
+        cvv2 = account->get_CVV2(ownerFingerprint);
+        totalBalance = bank.get_bank_total_balance(validBankFingerprint);
+        totalLoan = bank.get_bank_total_loan(validBankFingerprint);
+        unpaid = bank.get_customer_2_unpaid_loan_map(validBankFingerprint).at(person);
+        paid = bank.get_customer_2_paid_loan_map(validBankFingerprint).at(person);
+    }
+
+    Bank recovered = createValidBank();
+    auto recovery = Journal::recover(journalPath, recovered, validBankFingerprint,
+                                     load_snapshot(snapshotPath, recovered, validBankFingerprint, 2));
+    EXPECT_EQ(recovery.records, 1u) << "Only the record written after the snapshot should be replayed.";
+    ASSERT_EQ(recovery.accounts.size(), 3u);
+    EXPECT_EQ(recovery.accounts[1], nullptr);
+    EXPECT_EQ(recovery.accounts[2], nullptr);
+    Person* restored = recovery.customers[0].get();
+    EXPECT_EQ(restored->get_hashed_fingerprint(), hashFingerprint(ownerFingerprint));
+    EXPECT_EQ(restored->get_socioeconomic_rank(), person->get_socioeconomic_rank());
+    EXPECT_EQ(recovery.accounts[0]->get_balance(), balance);
+    EXPECT_EQ(recovery.accounts[0]->get_account_number(), number);
+    EXPECT_EQ(recovery.accounts[0]->get_CVV2(ownerFingerprint), cvv2);
+    EXPECT_EQ(recovered.get_bank_accounts(validBankFingerprint).size(), 1u);
+    EXPECT_EQ(recovered.get_bank_customers(validBankFingerprint).size(), 1u);
+    EXPECT_DOUBLE_EQ(recovered.get_customer_2_unpaid_loan_map(validBankFingerprint).at(restored), unpaid);
+    EXPECT_DOUBLE_EQ(recovered.get_customer_2_paid_loan_map(validBankFingerprint).at(restored), paid);
+    EXPECT_DOUBLE_EQ(recovered.get_bank_total_balance(validBankFingerprint), totalBalance);
+    EXPECT_DOUBLE_EQ(recovered.get_bank_total_loan(validBankFingerprint), totalLoan);
+    auto snapshot = read_file(snapshotPath);
+    EXPECT_EQ(snapshot.find(ownerFingerprint), std::string::npos);
+    EXPECT_EQ(snapshot.find("securePassword"), std::string::npos);
+    recovered.withdraw(*recovery.accounts[0], ownerFingerprint, 1.0);
+
+    std::remove(journalPath.c_str());
+    std::remove(snapshotPath.c_str());
+    delete person;
+}
+
+// Test that restore_loans sets loans and totals as given, and registers customers without accounts
+TEST_F(BankTest, Snapshot_RestoreLoansSetsStateAsCaptured) {
+    Bank bank = createValidBank();
+    Person* person = createValidPerson();
+    std::string wrongFingerprint = "wrongFingerprint";
+    std::map<Person*, double> paid{{person, 40.0}};
+    std::map<Person*, double> unpaid{{person, 60.5}};
+    EXPECT_THROW(bank.restore_loans({person}, paid, unpaid, 12.0, 60.5, wrongFingerprint), std::invalid_argument);
+
+    EXPECT_TRUE(bank.restore_loans({person}, paid, unpaid, 12.0, 60.5, validBankFingerprint));
+    EXPECT_EQ(bank.get_bank_customers(validBankFingerprint).size(), 1u);
+    EXPECT_TRUE(bank.get_customer_2_accounts_map(validBankFingerprint).at(person).empty());
+    EXPECT_DOUBLE_EQ(bank.get_customer_2_paid_loan_map(validBankFingerprint).at(person), 40.0);
+    EXPECT_DOUBLE_EQ(bank.get_customer_2_unpaid_loan_map(validBankFingerprint).at(person), 60.5);
+    EXPECT_DOUBLE_EQ(bank.get_bank_total_balance(validBankFingerprint), 12.0);
+    EXPECT_DOUBLE_EQ(bank.get_bank_total_loan(validBankFingerprint), 60.5);
+
+    // The customer is known now, a new account doesn't register them twice
+    std::string ownerFingerprint = "personFingerprint";
+    bank.create_account(*person, ownerFingerprint, "securePassword");
+    EXPECT_EQ(bank.get_bank_customers(validBankFingerprint).size(), 1u);
+    delete person;
+}
+
+TEST_F(BankTest, Snapshot_ChunkedCaptureUnderConcurrentWriters) {
+    const std::string journalPath = "snapshot_chunks.wal";
+    const std::string snapshotPath = "snapshot_chunks.snap";
+    std::remove(journalPath.c_str());
+    std::string ownerFingerprint = "personFingerprint";
+    Person* person = createValidPerson();
+    const size_t count = ConcurrentBank::SNAPSHOT_CHUNK + 100;
+    std::vector<std::string> numbers, expDates;
+    std::vector<double> balances;
+    {
+        Bank bank = createValidBank();
+        Journal journal(journalPath, JournalOptions{.sync = false});
+        ConcurrentBank concurrent(bank, &journal);
+        std::vector<Account*> accounts;
+        for (size_t i = 0; i < count; ++i)
+            accounts.push_back(concurrent.create_account(*person, ownerFingerprint, "securePassword"));
+
+        // Deposits run between the chunks, the expiry dates force the capture to start over
+        std::atomic<bool> done{false};
+        std::thread writer([&] {
+            std::string expDate = "11-30";
+            for (size_t i = 0; !done.load(); i = (i + 1) % count) {
+                concurrent.deposit(*accounts[i], ownerFingerprint, 1.0);
+                if (i % 512 == 0)
+                    concurrent.set_exp_date(*accounts[i], expDate, validBankFingerprint);
+            }
+        });
+        auto stats = concurrent.snapshot(snapshotPath, validBankFingerprint);
+        done = true;
+        writer.join();
+        EXPECT_EQ(stats.accounts, count);
+        for (auto* account : accounts) {
+            numbers.push_back(account->get_account_number());
+            expDates.push_back(account->get_exp_date(ownerFingerprint));
+            balances.push_back(account->get_balance());
+        }
+    }
+
+    Bank recovered = createValidBank();
+    auto recovery = Journal::recover(journalPath, recovered, validBankFingerprint,
+                                     load_snapshot(snapshotPath, recovered, validBankFingerprint, 2));
+    ASSERT_EQ(recovery.accounts.size(), count);
+    for (size_t i = 0; i < count; ++i) {
+        EXPECT_EQ(recovery.accounts[i]->get_account_number(), numbers[i]);
+        EXPECT_EQ(recovery.accounts[i]->get_exp_date(ownerFingerprint), expDates[i]);
+        EXPECT_EQ(recovery.accounts[i]->get_balance(), balances[i]) << "account " << i;
+    }
+    std::remove(journalPath.c_str());
+    std::remove(snapshotPath.c_str());
+    delete person;
+}
+
+TEST_F(BankTest, AccountIndex_FindsEveryAccountAcrossGrowthAndErase) {
+    Bank bank = createValidBank();
+    Person* person = createValidPerson();
+    Person other("Jane Roe", 40, "Female", "otherFingerprint", 3, true);
+    std::vector<Account*> accounts;
+    for (size_t i = 0; i < 600; ++i)
+        accounts.push_back(bank.create_account(i % 3 ? *person : other, i % 3 ? "personFingerprint" : "otherFingerprint", "pw"));
+
+    AccountIndex index;
+    for (auto* account : accounts)
+        index.insert(account);
+    EXPECT_EQ(index.size(), accounts.size());
+    EXPECT_GE(index.capacity() * 3, index.size() * 4) << "The table should grow before it is 3/4 full.";
+
+    for (size_t i = 0; i < accounts.size(); i += 2)
+        EXPECT_TRUE(index.erase(*AccountIndex::parse(accounts[i]->get_account_number())));
+    for (size_t i = 0; i < accounts.size(); ++i)
+        EXPECT_EQ(index.find(*AccountIndex::parse(accounts[i]->get_account_number())), i % 2 ? accounts[i] : nullptr);
+
+    EXPECT_EQ(index.erase_owned_by(&other), 100u);
+    for (size_t i = 1; i < accounts.size(); i += 2)
+        EXPECT_EQ(index.find(*AccountIndex::parse(accounts[i]->get_account_number())) != nullptr, i % 3 != 0);
+    // The reverse lookup follows every erase without reading the accounts
+    for (size_t i = 0; i < accounts.size(); ++i)
+        EXPECT_EQ(index.number_of(accounts[i]).has_value(), i % 2 && i % 3 != 0) << i;
+    EXPECT_EQ(index.number_of(accounts[1]), AccountIndex::parse(accounts[1]->get_account_number()));
+    index.clear();
+    EXPECT_FALSE(index.number_of(accounts[1]).has_value());
+    EXPECT_FALSE(AccountIndex::parse("12345").has_value());
+    EXPECT_FALSE(AccountIndex::parse("12345678abcdefgh").has_value());
+    delete person;
+}
+
+TEST_F(BankTest, ConcurrentBank_FindAccountByNumber) {
+    Bank bank = createValidBank();
+    ConcurrentBank concurrent(bank);
+    Person* person = createValidPerson();
+    std::string ownerFingerprint = "personFingerprint";
+    Account* kept = concurrent.create_account(*person, ownerFingerprint, "securePassword");
+    Account* dropped = concurrent.create_account(*person, ownerFingerprint, "securePassword");
+    std::string droppedNumber = dropped->get_account_number();
+
+    EXPECT_EQ(concurrent.find_account(kept->get_account_number()), kept);
+    EXPECT_EQ(concurrent.find_account(droppedNumber), dropped);
+    concurrent.delete_account(*dropped, ownerFingerprint);
+    EXPECT_EQ(concurrent.find_account(droppedNumber), nullptr);
+    EXPECT_EQ(concurrent.find_account("not a number"), nullptr);
+
+    // Accounts created behind its back show up after a reindex
+    Account* direct = bank.create_account(*person, ownerFingerprint, "securePassword");
+    EXPECT_EQ(concurrent.find_account(direct->get_account_number()), nullptr);
+    concurrent.reindex(validBankFingerprint);
+    EXPECT_EQ(concurrent.find_account(direct->get_account_number()), direct);
+    EXPECT_EQ(concurrent.find_account(kept->get_account_number()), kept);
+    delete person;
+}
+
+TEST_F(BankTest, DeleteManyAccountsKeepsContainersConsistent) {
+    Bank bank = createValidBank();
+    Person* person = createValidPerson();
+    Person other("Jane Roe", 40, "Female", "otherFingerprint", 3, true);
+    std::vector<Account*> mine, theirs;
+    for (size_t i = 0; i < 200; ++i) {
+        mine.push_back(bank.create_account(*person, "personFingerprint", "pw"));
+        theirs.push_back(bank.create_account(other, "otherFingerprint", "pw"));
+    }
+
+    // Deleting from the front used to shift the whole vector every time
+    for (size_t i = 0; i < mine.size(); i += 2)
+        bank.delete_account(*mine[i], "personFingerprint");
+    bank.delete_customer(other, "otherFingerprint");
+
+    const auto& accounts = bank.get_bank_accounts(validBankFingerprint);
+    ASSERT_EQ(accounts.size(), 100u);
+    for (size_t i = 1; i < mine.size(); i += 2)
+        EXPECT_NE(std::find(accounts.begin(), accounts.end(), mine[i]), accounts.end());
+    EXPECT_EQ(bank.get_customer_2_accounts_map(validBankFingerprint).at(person).size(), 100u);
+    EXPECT_EQ(bank.get_account_2_customer_map(validBankFingerprint).size(), 100u);
+    EXPECT_EQ(bank.get_bank_customers(validBankFingerprint), std::vector<Person*>{person});
+
+    for (size_t i = 1; i < mine.size(); i += 2)
+        bank.delete_account(*mine[i], "personFingerprint");
+    EXPECT_TRUE(bank.get_bank_accounts(validBankFingerprint).empty());
+    EXPECT_TRUE(bank.get_customer_2_accounts_map(validBankFingerprint).at(person).empty());
+    delete person;
+}
+
+TEST_F(BankTest, AccountNumbers_LuhnOptionAndUniqueness) {
+    EXPECT_TRUE(luhn_valid("79927398713"));
+    EXPECT_FALSE(luhn_valid("79927398710"));
+    EXPECT_EQ(format_account_number(42), "0000000000000042");
+
+    Bank bank = createValidBank();
+    ConcurrentBank concurrent(bank);
+    Person* person = createValidPerson();
+    set_luhn_account_numbers(true);
+    std::vector<std::string> numbers;
+    for (size_t i = 0; i < 500; ++i)
+        numbers.push_back(concurrent.create_account(*person, "personFingerprint", "pw")->get_account_number());
+    set_luhn_account_numbers(false);
+
+    for (const auto& number : numbers) {
+        EXPECT_EQ(number.size(), 16u);
+        EXPECT_TRUE(luhn_valid(number)) << number << " should carry a Luhn check digit.";
+    }
+    std::sort(numbers.begin(), numbers.end());
+    EXPECT_EQ(std::adjacent_find(numbers.begin(), numbers.end()), numbers.end()) << "Account numbers must be unique.";
+
+    // Replay goes through the same draw: a free restored number is kept, a taken one is refused
+    {
+        RestoredAccountNumber card(42, "0042");
+        Account* restored = bank.create_account(*person, "personFingerprint", "pw");
+        EXPECT_EQ(restored->get_account_number(), "0000000000000042");
+        EXPECT_EQ(restored->get_CVV2("personFingerprint"), "0042");
+    }
+    size_t accounts = bank.get_bank_accounts(validBankFingerprint).size();
+    {
+        RestoredAccountNumber card(*AccountIndex::parse(numbers.front()), "0001");
+        EXPECT_THROW(bank.create_account(*person, "personFingerprint", "pw"), std::invalid_argument);
+    }
+    EXPECT_EQ(bank.get_bank_accounts(validBankFingerprint).size(), accounts);
+    delete person;
+}
+
+TEST_F(BankTest, TakeLoanEligibilityFollowsEveryBalanceChange) {
+    Bank bank = createValidBank();
+    Person* person = createValidPerson();
+    Person other("Jane Roe", 40, "Female", "otherFingerprint", 5, true);
+    std::string ownerFingerprint = "personFingerprint";
+    std::string password = "pw";
+    Account* first = bank.create_account(*person, ownerFingerprint, password);
+    Account* second = bank.create_account(*person, ownerFingerprint, password);
+    Account* theirs = bank.create_account(other, "otherFingerprint", password);
+
+    bank.deposit(*first, ownerFingerprint, 600.0);
+    bank.deposit(*second, ownerFingerprint, 600.0);
+    bank.withdraw(*second, ownerFingerprint, 200.0);
+    // 1000 across both accounts at rank 6 allows 600 of loans
+    bank.transfer(*first, *theirs, ownerFingerprint, first->get_CVV2(ownerFingerprint), password,
+                  first->get_exp_date(ownerFingerprint), 500.0);
+    EXPECT_ANY_THROW(bank.take_loan(*first, ownerFingerprint, 301.0)) << "Transferred money no longer counts.";
+    EXPECT_TRUE(bank.take_loan(*first, ownerFingerprint, 200.0));
+    EXPECT_ANY_THROW(bank.take_loan(*first, ownerFingerprint, 97.0)) << "Unpaid loan plus interest counts against the limit.";
+
+    // The other customer's limit includes what arrived by transfer, and moves with set_owner
+    EXPECT_TRUE(bank.take_loan(*theirs, "otherFingerprint", 250.0));
+    std::string otherFingerprint = "otherFingerprint";
+    bank.set_owner(*second, &other, ownerFingerprint, validBankFingerprint);
+    EXPECT_ANY_THROW(bank.take_loan(*first, ownerFingerprint, 1.0)) << "The moved account's balance left with it.";
+    EXPECT_TRUE(bank.take_loan(*theirs, otherFingerprint, 190.0));
+    delete person;
+}
+
+TEST_F(BankTest, ConcurrentBank_BatchAtomicOrPerOperation) {
+    Bank bank = createValidBank();
+    ConcurrentBank concurrent(bank);
+    Person* person = createValidPerson();
+    std::string ownerFingerprint = "personFingerprint";
+    std::string password = "pw";
+    Account* source = concurrent.create_account(*person, ownerFingerprint, password);
+    Account* destination = concurrent.create_account(*person, ownerFingerprint, password);
+    std::string CVV2 = source->get_CVV2(ownerFingerprint);
+    std::string expDate = source->get_exp_date(ownerFingerprint);
+    concurrent.deposit(*destination, ownerFingerprint, 10.0);
+
+    std::vector<BatchOperation> operations = {
+        {BatchOperationType::Deposit, source, nullptr, ownerFingerprint, 100.0},
+        {BatchOperationType::Transfer, source, destination, ownerFingerprint, 60.0, CVV2, password, expDate},
+        {BatchOperationType::Withdraw, destination, nullptr, ownerFingerprint, 10.0},
+        {BatchOperationType::Withdraw, source, nullptr, ownerFingerprint, 50.0},
+        {BatchOperationType::Deposit, destination, nullptr, "wrongFingerprint", 1.0},
+    };
+
+    // One overdraft and one bad fingerprint spoil the whole atomic batch
+    auto atomic = concurrent.submit(operations, BatchMode::Atomic);
+    EXPECT_EQ(atomic.applied, 0u);
+    EXPECT_EQ(atomic.statuses[3], BatchStatus::InsufficientFunds);
+    EXPECT_EQ(atomic.statuses[4], BatchStatus::BadCredentials);
+    EXPECT_EQ(atomic.statuses[0], BatchStatus::Aborted);
+    EXPECT_DOUBLE_EQ(source->get_balance(), 0.0);
+    EXPECT_DOUBLE_EQ(destination->get_balance(), 10.0);
+
+    auto single = concurrent.submit(operations, BatchMode::PerOperation);
+    EXPECT_EQ(single.applied, 3u);
+    EXPECT_EQ(single.failed, 2u);
+    EXPECT_EQ(single.statuses[1], BatchStatus::Applied);
+    EXPECT_EQ(single.statuses[3], BatchStatus::InsufficientFunds);
+    EXPECT_DOUBLE_EQ(source->get_balance(), 40.0);
+    EXPECT_DOUBLE_EQ(destination->get_balance(), 60.0);
+
+    operations.resize(3);
+    EXPECT_EQ(concurrent.submit(operations, BatchMode::Atomic).applied, 3u);
+    EXPECT_DOUBLE_EQ(source->get_balance(), 80.0);
+    EXPECT_DOUBLE_EQ(destination->get_balance(), 110.0);
+
+    // Blocked destinations and ones the index does not know are refused in the dry run already
+    Account* blocked = concurrent.create_account(*person, ownerFingerprint, password);
+    concurrent.set_account_status(*blocked, false, validBankFingerprint);
+    Account* unindexed = bank.create_account(*person, ownerFingerprint, password);
+    std::vector<BatchOperation> refused = {
+        {BatchOperationType::Transfer, source, blocked, ownerFingerprint, 1.0, CVV2, password, expDate},
+        {BatchOperationType::Transfer, source, unindexed, ownerFingerprint, 1.0, CVV2, password, expDate},
+    };
+    auto rejected = concurrent.submit(refused, BatchMode::Atomic);
+    EXPECT_EQ(rejected.statuses[0], BatchStatus::BadDestination);
+    EXPECT_EQ(rejected.statuses[1], BatchStatus::BadDestination);
+    EXPECT_EQ(concurrent.submit(refused, BatchMode::PerOperation).failed, 2u);
+    EXPECT_DOUBLE_EQ(source->get_balance(), 80.0);
+
+    // Submission order holds across accounts, whichever of them sits at the lower address
+    for (auto mode : {BatchMode::Atomic, BatchMode::PerOperation}) {
+        std::vector<BatchOperation> chained = {
+            {BatchOperationType::Transfer, source, destination, ownerFingerprint, 80.0, CVV2, password, expDate},
+            {BatchOperationType::Withdraw, destination, nullptr, ownerFingerprint, 190.0},
+            {BatchOperationType::Deposit, destination, nullptr, ownerFingerprint, 190.0},
+            {BatchOperationType::Transfer, destination, source, ownerFingerprint, 80.0,
+             destination->get_CVV2(ownerFingerprint), password, destination->get_exp_date(ownerFingerprint)},
+            {BatchOperationType::Withdraw, source, nullptr, ownerFingerprint, 80.0},
+            {BatchOperationType::Deposit, source, nullptr, ownerFingerprint, 80.0},
+        };
+        EXPECT_EQ(concurrent.submit(chained, mode).applied, 6u);
+    }
+    EXPECT_DOUBLE_EQ(source->get_balance(), 80.0);
+    EXPECT_DOUBLE_EQ(destination->get_balance(), 110.0);
+    delete person;
+}
+
+TEST_F(BankTest, ConcurrentBank_AtomicBatchRollsBackWhenApplyingFails) {
+    using namespace std::chrono;
+    int appends = 0;
+    Ledger ledger([&] {
+        // The second entry of the batch can't be written
+        if (++appends == 3)
+            throw std::runtime_error("clock failed");
+        return system_clock::time_point{};
+    });
+    Bank bank = createValidBank();
+    ConcurrentBank concurrent(bank, nullptr, &ledger);
+    Person* person = createValidPerson();
+    std::string ownerFingerprint = "personFingerprint";
+    std::string password = "pw";
+    Account* source = concurrent.create_account(*person, ownerFingerprint, password);
+    Account* destination = concurrent.create_account(*person, ownerFingerprint, password);
+    std::string CVV2 = source->get_CVV2(ownerFingerprint);
+    std::string expDate = source->get_exp_date(ownerFingerprint);
+    concurrent.deposit(*source, ownerFingerprint, 50.0);
+
+    std::vector<BatchOperation> operations = {
+        {BatchOperationType::Deposit, source, nullptr, ownerFingerprint, 100.0},
+        {BatchOperationType::Transfer, source, destination, ownerFingerprint, 120.0, CVV2, password, expDate},
+        {BatchOperationType::Withdraw, destination, nullptr, ownerFingerprint, 20.0},
+    };
+    EXPECT_THROW(concurrent.submit(operations, BatchMode::Atomic), std::runtime_error);
+    EXPECT_DOUBLE_EQ(source->get_balance(), 50.0);
+    EXPECT_DOUBLE_EQ(destination->get_balance(), 0.0);
+    EXPECT_EQ(concurrent.total_balance(), Money::from_double(50.0));
+    // The deposit that went through and its reversal both stay on record
+    EXPECT_EQ(ledger.size(), 3u);
+    EXPECT_EQ(ledger.at(2)->type, LedgerEntryType::Withdraw);
+
+    // Nothing is left half applied, the same batch goes through once the clock works
+    EXPECT_EQ(concurrent.submit(operations, BatchMode::Atomic).applied, 3u);
+    EXPECT_DOUBLE_EQ(source->get_balance(), 30.0);
+    EXPECT_DOUBLE_EQ(destination->get_balance(), 100.0);
+    delete person;
+}
+
+TEST_F(BankTest, ConcurrentBank_SessionTokens) {
+    Bank bank = createValidBank();
+    ConcurrentBank concurrent(bank);
+    Person* person = createValidPerson();
+    Person other("Jane Roe", 40, "Female", "otherFingerprint", 5, true);
+    std::string ownerFingerprint = "personFingerprint";
+    std::string password = "pw";
+    Account* account = concurrent.create_account(*person, ownerFingerprint, password);
+    Account* theirs = concurrent.create_account(other, "otherFingerprint", password);
+
+    EXPECT_ANY_THROW(concurrent.open_session(*person, "wrongFingerprint"));
+    SessionToken session = concurrent.open_session(*person, ownerFingerprint);
+    EXPECT_TRUE(concurrent.deposit(*account, session, 100.0));
+    EXPECT_TRUE(concurrent.withdraw(*account, session, 30.0));
+    EXPECT_TRUE(concurrent.transfer(*account, *theirs, session, account->get_CVV2(ownerFingerprint), password,
+                                    account->get_exp_date(ownerFingerprint), 20.0));
+    EXPECT_TRUE(concurrent.take_loan(*account, session, 10.0));
+    EXPECT_DOUBLE_EQ(account->get_balance(), 50.0);
+    EXPECT_DOUBLE_EQ(theirs->get_balance(), 20.0);
+    EXPECT_ANY_THROW(concurrent.withdraw(*account, session, 51.0)) << "Sessions don't skip the balance checks.";
+
+    EXPECT_ANY_THROW(concurrent.deposit(*theirs, session, 1.0)) << "The session belongs to another customer.";
+    static_assert(!std::is_constructible_v<VerifiedFingerprint, const Person&, const std::string&>,
+                  "Only the classes that checked a fingerprint may vouch for it.");
+    SessionToken forged = session;
+    forged.secret ^= 1;
+    EXPECT_ANY_THROW(concurrent.deposit(*account, forged, 1.0));
+
+    EXPECT_TRUE(concurrent.close_session(session));
+    EXPECT_FALSE(concurrent.close_session(session));
+    EXPECT_ANY_THROW(concurrent.deposit(*account, session, 1.0)) << "Closed sessions stay closed.";
+    SessionToken reopened = concurrent.open_session(*person, ownerFingerprint);
+    EXPECT_ANY_THROW(concurrent.deposit(*account, session, 1.0)) << "A reused slot doesn't revive the old token.";
+    EXPECT_TRUE(concurrent.deposit(*account, reopened, 1.0));
+
+    // The table keeps a stand-in rather than the fingerprint, useless outside a verified call
+    SessionTable table;
+    const std::string& credential = table.authenticate(table.open(*person, ownerFingerprint), *person);
+    EXPECT_EQ(credential.find(ownerFingerprint), std::string::npos);
+    EXPECT_ANY_THROW(account->get_CVV2(credential));
+
+    // The raw fingerprint path is untouched
+    EXPECT_ANY_THROW(concurrent.deposit(*account, "wrongFingerprint", 1.0));
+    delete person;
+}
+
+TEST_F(BankTest, PackedAccount_RoundTripsEveryField) {
+    Bank bank = createValidBank();
+    Person* person = createValidPerson();
+    std::string ownerFingerprint = "personFingerprint";
+    std::string password = "pw";
+    Account* first = bank.create_account(*person, ownerFingerprint, password);
+    Account* second = bank.create_account(*person, ownerFingerprint, password);
+    bank.deposit(*first, ownerFingerprint, 12.34);
+
+    OwnerIds owners;
+    PackedAccount packed = pack(*first, owners, ownerFingerprint);
+    EXPECT_EQ(sizeof(PackedAccount), 32u);
+    EXPECT_EQ(format_account_number(packed.account_number), first->get_account_number());
+    EXPECT_EQ(unpack_CVV2(packed.CVV2), first->get_CVV2(ownerFingerprint));
+    EXPECT_EQ(unpack_exp_date(packed.exp_date), first->get_exp_date(ownerFingerprint));
+    EXPECT_EQ(packed.balance, Money(1234));
+    EXPECT_TRUE(packed.status);
+    EXPECT_TRUE(password_matches(packed, password));
+    EXPECT_FALSE(password_matches(packed, "wrong"));
+    EXPECT_EQ(owners.person(packed.owner), person);
+    EXPECT_EQ(pack(*second, owners, ownerFingerprint).owner, packed.owner) << "One id per owner.";
+    EXPECT_EQ(owners.size(), 1u);
+
+    EXPECT_EQ(pack_exp_date("99-12"), std::optional<std::uint16_t>(99 * 12 + 11));
+    EXPECT_FALSE(pack_exp_date("30-13"));
+    EXPECT_FALSE(pack_exp_date("2030-02"));
+    std::string expDate = "next year";
+    bank.set_exp_date(*second, expDate, validBankFingerprint);
+    EXPECT_ANY_THROW(pack(*second, owners, ownerFingerprint));
+    delete person;
+}
+
+TEST_F(BankTest, SlabPool_ReusesSlotsAndStalesHandles) {
+    static int alive = 0;
+    struct Tracked {
+        int value;
+        explicit Tracked(int value) : value(value) { ++alive; }
+        ~Tracked() { --alive; }
+    };
+
+    {
+        SlabPool<Tracked, 4> pool;
+        std::vector<Tracked*> objects;
+        for (int i = 0; i < 10; ++i)
+            objects.push_back(pool.create(i));
+        EXPECT_EQ(pool.size(), 10u);
+        EXPECT_EQ(pool.capacity(), 12u);
+        EXPECT_EQ(alive, 10);
+
+        auto handle = pool.handle(objects[5]);
+        EXPECT_EQ(pool.get(handle), objects[5]);
+        pool.destroy(objects[5]);
+        EXPECT_EQ(alive, 9);
+        EXPECT_EQ(pool.get(handle), nullptr) << "The handle outlived its object.";
+
+        Tracked* reused = pool.create(42);
+        EXPECT_EQ(reused, objects[5]) << "The freed slot comes back first.";
+        EXPECT_EQ(pool.get(handle), nullptr) << "A new object in the slot doesn't revive the old handle.";
+        EXPECT_EQ(pool.get(pool.handle(reused))->value, 42);
+        for (int i = 0; i < 10; ++i)
+            EXPECT_EQ(objects[i]->value, i == 5 ? 42 : i) << "Objects never move.";
+    }
+    EXPECT_EQ(alive, 0) << "The pool destroys what is still alive.";
+
+    // Deleted accounts go back to the Bank's pool
+    Bank bank = createValidBank();
+    Person* person = createValidPerson();
+    ConcurrentBank concurrent(bank);
+    Account* first = concurrent.create_account(*person, "personFingerprint", "pw");
+    Account* kept = concurrent.create_account(*person, "personFingerprint", "pw");
+    std::string keptNumber = kept->get_account_number();
+    concurrent.delete_account(*first, "personFingerprint");
+    Account* second = concurrent.create_account(*person, "personFingerprint", "pw");
+    EXPECT_EQ(second, first);
+    EXPECT_EQ(concurrent.find_account(second->get_account_number()), second);
+    concurrent.delete_customer(*person, "personFingerprint");
+    EXPECT_TRUE(bank.get_bank_accounts(validBankFingerprint).empty());
+    EXPECT_EQ(concurrent.find_account(keptNumber), nullptr);
+    delete person;
+}
+
+TEST_F(BankTest, ConcurrentBank_ColumnarReportsFollowEveryChange) {
+    Bank bank = createValidBank();
+    ConcurrentBank concurrent(bank);
+    Person* person = createValidPerson();
+    Person other("Jane Roe", 40, "Female", "otherFingerprint", 5, true);
+    std::string ownerFingerprint = "personFingerprint";
+    std::string password = "pw";
+    std::vector<Account*> mine;
+    for (int i = 0; i < 5; ++i) {
+        mine.push_back(concurrent.create_account(*person, ownerFingerprint, password));
+        concurrent.deposit(*mine.back(), ownerFingerprint, 100.0 * i + 0.5);
+    }
+    Account* theirs = concurrent.create_account(other, "otherFingerprint", password);
+    concurrent.withdraw(*mine[4], ownerFingerprint, 0.5);
+    concurrent.transfer(*mine[3], *theirs, ownerFingerprint, mine[3]->get_CVV2(ownerFingerprint), password,
+                        mine[3]->get_exp_date(ownerFingerprint), 150.0);
+    concurrent.submit({{BatchOperationType::Deposit, theirs, nullptr, "otherFingerprint", 49.5}}, BatchMode::Atomic);
+
+    // 0.5, 100.5, 200.5, 150.5, 400 and 199.5
+    EXPECT_EQ(concurrent.total_balance(), Money(105150));
+    EXPECT_EQ(concurrent.balance_histogram(Money(10000), 3), (std::vector<size_t>{1, 3, 2}));
+    EXPECT_EQ(concurrent.count_by_status().active, 6u);
+
+    concurrent.withdraw(*mine[0], ownerFingerprint, 0.5);
+    concurrent.delete_account(*mine[0], ownerFingerprint);
+    EXPECT_EQ(concurrent.balance_histogram(Money(10000), 3), (std::vector<size_t>{0, 3, 2}));
+
+    // Status changes show up at once, those made on the Bank directly only after a reindex
+    concurrent.set_account_status(*theirs, false, validBankFingerprint);
+    EXPECT_EQ(concurrent.count_by_status().inactive, 1u);
+    bank.set_account_status(*mine[1], false, validBankFingerprint);
+    EXPECT_EQ(concurrent.count_by_status().inactive, 1u);
+    concurrent.reindex(validBankFingerprint);
+    EXPECT_EQ(concurrent.count_by_status().inactive, 2u);
+    EXPECT_EQ(concurrent.total_balance(), Money(105100));
+
+    for (size_t i = 1; i < mine.size(); ++i)
+        concurrent.withdraw(*mine[i], ownerFingerprint, mine[i]->get_balance());
+    concurrent.delete_customer(*person, ownerFingerprint);
+    EXPECT_EQ(concurrent.total_balance(), Money(19950));
+    EXPECT_ANY_THROW(concurrent.balance_histogram(Money(), 3));
+    delete person;
+}
+
+TEST_F(BankTest, Ledger_RangeAndAccountHistoryWithPages) {
+    using namespace std::chrono;
+    system_clock::time_point now{};
+    Ledger ledger([&] { return now; });
+    Bank bank = createValidBank();
+    ConcurrentBank concurrent(bank, nullptr, &ledger);
+    Person* person = createValidPerson();
+    std::string ownerFingerprint = "personFingerprint";
+    std::string password = "pw";
+    Account* source = concurrent.create_account(*person, ownerFingerprint, password);
+    Account* destination = concurrent.create_account(*person, ownerFingerprint, password);
+    std::string CVV2 = source->get_CVV2(ownerFingerprint);
+    std::string expDate = source->get_exp_date(ownerFingerprint);
+    auto sourceNumber = *AccountIndex::parse(source->get_account_number());
+    auto destinationNumber = *AccountIndex::parse(destination->get_account_number());
+
+    // One day per operation: a deposit, then ten transfers, then a withdrawal from the destination
+    concurrent.deposit(*source, ownerFingerprint, 100.0);
+    for (int day = 1; day <= 10; ++day) {
+        now += hours(24);
+        concurrent.transfer(*source, *destination, ownerFingerprint, CVV2, password, expDate, 1.0);
+    }
+    now += hours(24);
+    concurrent.withdraw(*destination, ownerFingerprint, 5.0);
+    EXPECT_ANY_THROW(concurrent.withdraw(*destination, ownerFingerprint, 500.0));
+    EXPECT_EQ(ledger.size(), 12u) << "Failed operations leave no entry.";
+
+    // Transfers on the destination between days 3 and 7, three per page
+    LedgerQuery query{.from = system_clock::time_point{} + hours(24 * 3), .to = system_clock::time_point{} + hours(24 * 8),
+                      .type = LedgerEntryType::Transfer, .limit = 3};
+    LedgerPage first = ledger.history(destinationNumber, query);
+    ASSERT_EQ(first.entries.size(), 3u);
+    ASSERT_TRUE(first.next.has_value());
+    EXPECT_EQ(first.entries[0].sequence, 3u);
+    EXPECT_EQ(first.entries[0].account, sourceNumber);
+    EXPECT_EQ(first.entries[0].counterparty, destinationNumber);
+    EXPECT_EQ(first.entries[0].amount, Money(100));
+    query.cursor = *first.next;
+    LedgerPage second = ledger.history(destinationNumber, query);
+    ASSERT_EQ(second.entries.size(), 2u);
+    EXPECT_EQ(second.entries[1].sequence, 7u);
+    EXPECT_FALSE(second.next.has_value());
+
+    // The source's history has its deposit, the destination's its withdrawal
+    auto all = ledger.history(sourceNumber, LedgerQuery{});
+    EXPECT_EQ(all.entries.size(), 11u);
+    EXPECT_EQ(all.entries.front().type, LedgerEntryType::Deposit);
+    EXPECT_EQ(ledger.history(destinationNumber, LedgerQuery{.type = LedgerEntryType::Withdraw}).entries.size(), 1u);
+    EXPECT_TRUE(ledger.history(12345, LedgerQuery{}).entries.empty());
+
+    // A clock stepping back doesn't break the time order
+    now -= hours(24 * 100);
+    concurrent.deposit(*source, ownerFingerprint, 1.0);
+    EXPECT_EQ(ledger.at(12)->time, ledger.at(11)->time);
+    EXPECT_EQ(ledger.range(LedgerQuery{.from = ledger.at(11)->time}).entries.size(), 2u);
+    EXPECT_ANY_THROW(ledger.range(LedgerQuery{.limit = 0}));
+
+    // A number is only unique among live accounts, the next holder starts with an empty history
+    Account* closed = concurrent.create_account(*person, ownerFingerprint, password);
+    auto closedNumber = *AccountIndex::parse(closed->get_account_number());
+    concurrent.deposit(*closed, ownerFingerprint, 3.0);
+    concurrent.withdraw(*closed, ownerFingerprint, 3.0);
+    concurrent.delete_account(*closed, ownerFingerprint);
+    EXPECT_EQ(ledger.history(closedNumber, LedgerQuery{}).entries.size(), 2u);
+    {
+        RestoredAccountNumber card(closedNumber, "0000");
+        Account* reopened = concurrent.create_account(*person, ownerFingerprint, password);
+        ASSERT_EQ(*AccountIndex::parse(reopened->get_account_number()), closedNumber);
+        EXPECT_TRUE(ledger.history(closedNumber, LedgerQuery{}).entries.empty());
+        concurrent.deposit(*reopened, ownerFingerprint, 7.0);
+    }
+    auto reopenedHistory = ledger.history(closedNumber, LedgerQuery{});
+    ASSERT_EQ(reopenedHistory.entries.size(), 1u);
+    EXPECT_EQ(reopenedHistory.entries[0].amount, Money(700));
+    EXPECT_EQ(ledger.range(LedgerQuery{.cursor = 13}).entries.size(), 3u) << "The earlier holder's entries stay in the ledger.";
+    delete person;
+}
+
+TEST_F(BankTest, ConcurrentBank_ReadViewsCarryLoans) {
+    Bank bank = createValidBank();
+    ConcurrentBank concurrent(bank);
+    Person* person = createValidPerson();
+    std::string ownerFingerprint = "personFingerprint";
+    Account* account = concurrent.create_account(*person, ownerFingerprint, "pw");
+    concurrent.deposit(*account, ownerFingerprint, 100.0);
+
+    EXPECT_EQ(concurrent.read_view().loans(), nullptr) << "Loans need the bank fingerprint.";
+    ASSERT_NE(concurrent.read_view(validBankFingerprint).loans(), nullptr);
+    EXPECT_TRUE(concurrent.read_view(validBankFingerprint).loans()->customers.empty());
+
+    concurrent.take_loan(*account, ownerFingerprint, 10.0);
+    auto before = concurrent.read_view(validBankFingerprint);
+    Money owed = Money::from_double(bank.get_customer_2_unpaid_loan_map(validBankFingerprint).at(person));
+    EXPECT_EQ(before.loans(), concurrent.read_view(validBankFingerprint).loans()) << "Unchanged loans are not copied again.";
+
+    concurrent.pay_loan(*account, 4.0);
+    auto after = concurrent.read_view(validBankFingerprint);
+    ASSERT_EQ(before.loans()->customers.size(), 1u);
+    EXPECT_EQ(before.loans()->customers[0].unpaid, owed);
+    EXPECT_EQ(before.loans()->customers[0].paid, Money());
+    EXPECT_EQ(after.loans()->customers[0].unpaid, owed - Money::from_double(4.0));
+    EXPECT_EQ(after.loans()->customers[0].paid, Money::from_double(4.0));
+    EXPECT_EQ(after.loans()->total_loan, Money::from_double(bank.get_bank_total_loan(validBankFingerprint)));
+    EXPECT_EQ(after.loans()->total_balance, Money::from_double(bank.get_bank_total_balance(validBankFingerprint)));
+    delete person;
+}
+
+TEST_F(BankTest, ConcurrentBank_ReadViewsStayConsistentUnderTransfers) {
+    Bank bank = createValidBank();
+    ConcurrentBank concurrent(bank);
+    Person* person = createValidPerson();
+    std::string ownerFingerprint = "personFingerprint";
+    std::string password = "pw";
+    std::vector<Account*> accounts;
+    for (int i = 0; i < 64; ++i) {
+        accounts.push_back(concurrent.create_account(*person, ownerFingerprint, password));
+        concurrent.deposit(*accounts.back(), ownerFingerprint, 100.0);
+    }
+    auto before = concurrent.read_view();
+    std::atomic<bool> done{false};
+    std::vector<std::thread> movers;
+    for (int t = 0; t < 4; ++t)
+        movers.emplace_back([&, t] {
+            for (int i = 0; i < 2000; ++i) {
+                auto* source = accounts[(i * 7 + t) % accounts.size()];
+                auto* destination = accounts[(i * 13 + t + 1) % accounts.size()];
+                try {
+                    concurrent.transfer(*source, *destination, ownerFingerprint, source->get_CVV2(ownerFingerprint),
+                                        password, source->get_exp_date(ownerFingerprint), 3.0);
+                } catch (const std::invalid_argument&) {
+                    // ran dry, fine
+                }
+            }
+        });
+
+    // Transfers move money around but never change the total, every view must agree.
+    // Views are taken beside the transfers, with or without loans.
+    std::vector<std::thread> reporters;
+    for (int r = 0; r < 2; ++r)
+        reporters.emplace_back([&, r] {
+            while (!done.load()) {
+                auto view = r ? concurrent.read_view(validBankFingerprint) : concurrent.read_view();
+                EXPECT_EQ(view.sum(), Money(640000));
+                EXPECT_EQ(view.size(), 64u);
+                if (r) {
+                    EXPECT_NE(view.loans(), nullptr);
+                }
+            }
+        });
+    for (auto& mover : movers)
+        mover.join();
+    done = true;
+    for (auto& reporter : reporters)
+        reporter.join();
+
+    // The first view still shows the balances from before any transfer
+    size_t unchanged = 0;
+    before.for_each([&](const AccountRow& row) { unchanged += row.balance == Money(10000); });
+    EXPECT_EQ(unchanged, 64u);
+
+    Money total;
+    for (auto* account : accounts)
+        total += Money::from_double(account->get_balance());
+    auto after = concurrent.read_view();
+    EXPECT_EQ(total, Money(640000));
+    size_t matching = 0;
+    after.for_each([&](const AccountRow& row) {
+        auto* account = concurrent.find_account(row.account_number);
+        matching += account && Money::from_double(account->get_balance()) == row.balance;
+    });
+    EXPECT_EQ(matching, 64u);
+    delete person;
+}
+
+TEST_F(BankTest, Report_StreamsEveryAccountInEachFormat) {
+    Bank bank = createValidBank();
+    Person* person = createValidPerson();
+    std::string ownerFingerprint = "personFingerprint";
+    std::vector<Account*> accounts;
+    for (int i = 0; i < 3000; ++i) {
+        accounts.push_back(bank.create_account(*person, ownerFingerprint, "pw"));
+        bank.deposit(*accounts.back(), ownerFingerprint, 1.5);
+    }
+
+    // Far more than one buffer of text, every account still comes out once and in order
+    MemorySink text;
+    write_report(bank, text, ReportFormat::Text);
+    EXPECT_GT(text.str().size(), ReportWriter::BUFFER_SIZE);
+    EXPECT_EQ(text.str().find("bank name: "), 0u);
+    size_t lines = std::count(text.str().begin(), text.str().end(), '\n');
+    EXPECT_EQ(lines, 3000u + 3u) << "The bank, the customer, their accounts and their loans.";
+    EXPECT_LT(text.str().find(accounts.front()->get_account_number()), text.str().find(accounts.back()->get_account_number()));
+    EXPECT_NE(text.str().find("paid loan: 0 |unpaid loan : 0 \n"), std::string::npos);
+
+    MemorySink csv;
+    write_report(bank, csv, ReportFormat::CSV);
+    EXPECT_EQ(csv.str().find("record,name,age,gender,"), 0u);
+    EXPECT_EQ(static_cast<size_t>(std::count(csv.str().begin(), csv.str().end(), '\n')), 1u + 1u + 1u + 3000u);
+    EXPECT_NE(csv.str().find("\ncustomer,John Doe,30,Male,"), std::string::npos);
+    EXPECT_NE(csv.str().find("\naccount,,,,,," + accounts[7]->get_account_number() + ",1.5,"), std::string::npos);
+
+    MemorySink json;
+    write_report(bank, json, ReportFormat::JSON);
+    EXPECT_EQ(json.str().find("{\"bank\":{\"name\":\"" + validBankName + "\""), 0u);
+    EXPECT_EQ(json.str().substr(json.str().size() - 6), "}]}]}\n");
+    size_t objects = 0;
+    for (size_t at = json.str().find("\"account_number\""); at != std::string::npos; at = json.str().find("\"account_number\"", at + 1))
+        objects++;
+    EXPECT_EQ(objects, 3000u);
+
+    // A writer handed to get_info directly gets the same report as write_report
+    MemorySink direct;
+    {
+        ReportWriter writer(direct, ReportFormat::JSON);
+        bank.get_info(writer);
+    }
+    EXPECT_EQ(direct.str(), json.str());
+
+    // get_info on a path picks the format from the extension and writes the whole report to it
+    std::string filename = "test_bank_report.csv";
+    bank.get_info(filename);
+    std::ifstream file(filename, std::ios::binary);
+    std::string written((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(written, csv.str());
+    file.close();
+    std::remove(filename.c_str());
+    delete person;
+}
+
+TEST_F(BankTest, EndOfDay_SameResultForAnyPartitioningAndOnReplay) {
+    const std::string path = "end_of_day_test.wal";
+    std::remove(path.c_str());
+    // Every fifth customer starts at rank 1 and repays far more than they owe
+    auto populate = [](std::vector<std::unique_ptr<Person>>& people) {
+        for (int i = 0; i < 40; ++i) {
+            std::string fingerprint = "customer-" + std::to_string(i);
+            size_t rank = i % 5 == 0 ? 1 : 3;
+            people.push_back(std::make_unique<Person>(fingerprint, 30, "Male", fingerprint, rank, true));
+        }
+    };
+    auto operate = [](auto& bank, std::vector<std::unique_ptr<Person>>& people) {
+        for (int i = 0; i < 40; ++i) {
+            std::string fingerprint = "customer-" + std::to_string(i);
+            Account* account = bank.create_account(*people[i], fingerprint, "pw");
+            bank.deposit(*account, fingerprint, 10000.0);
+            if (i % 7 == 3)
+                continue;
+            bank.take_loan(*account, fingerprint, i % 5 == 0 ? 500.0 : 100.0 + i * 10);
+            if (i % 5 == 0)
+                bank.pay_loan(*account, 5000.0);
+        }
+    };
+
+    std::vector<std::unique_ptr<Person>> serialPeople;
+    Bank serial = createValidBank();
+    populate(serialPeople);
+    operate(serial, serialPeople);
+    auto one = EndOfDay::run(serial, validBankFingerprint, EndOfDayPolicy{.daily_rate = 0.01, .threads = 1, .partitions = 1});
+
+    std::vector<std::unique_ptr<Person>> parallelPeople;
+    Bank parallel = createValidBank();
+    {
+        Journal journal(path);
+        ConcurrentBank concurrent(parallel, &journal);
+        populate(parallelPeople);
+        operate(concurrent, parallelPeople);
+        auto many = concurrent.end_of_day(EndOfDayPolicy{.daily_rate = 0.01, .threads = 4, .partitions = 7}, validBankFingerprint);
+        ASSERT_EQ(many.partitions.size(), 7u);
+        size_t covered = 0;
+        for (const auto& partition : many.partitions) {
+            EXPECT_EQ(partition.first, covered);
+            covered += partition.customers;
+        }
+        EXPECT_EQ(covered, 40u);
+        EXPECT_EQ(many.interest, one.interest);
+        EXPECT_EQ(many.accrued, one.accrued);
+        EXPECT_EQ(many.promoted, one.promoted);
+        EXPECT_THROW(concurrent.end_of_day(EndOfDayPolicy{.daily_rate = 0.01}, "wrongFingerprint"), std::invalid_argument);
+    }
+
+    // Customer 1 owed 110 plus 110 / 3 / 10 of interest, a day at 1% adds 1.14
+    const auto& unpaid = serial.get_customer_2_unpaid_loan_map(validBankFingerprint);
+    EXPECT_NEAR(unpaid.at(serialPeople[1].get()), 113.67 + 1.14, 1e-9);
+    // Six customers never borrow, seven repay more than they owe (customer 10 is in both groups)
+    EXPECT_EQ(one.accrued, 40u - 6u - 7u) << "No interest without a loan or on an overpaid one.";
+    EXPECT_EQ(one.promoted, 7u);
+    // 5000 repaid: pay_loan takes rank 1 to 2, the end of day on to 4 since 5000 > 1000
+    EXPECT_EQ(serialPeople[5]->get_socioeconomic_rank(), 4u);
+    EXPECT_EQ(serialPeople[1]->get_socioeconomic_rank(), 3u);
+
+    Bank recovered = createValidBank();
+    auto recovery = Journal::recover(path, recovered, validBankFingerprint);
+    std::vector<Bank*> banks = {&serial, &parallel, &recovered};
+    std::vector<std::vector<Person*>> people(3);
+    for (int i = 0; i < 40; ++i) {
+        people[0].push_back(serialPeople[i].get());
+        people[1].push_back(parallelPeople[i].get());
+        people[2].push_back(recovery.customers[i].get());
+    }
+    for (size_t b = 1; b < banks.size(); ++b) {
+        EXPECT_EQ(banks[b]->get_bank_total_loan(validBankFingerprint), serial.get_bank_total_loan(validBankFingerprint));
+        EXPECT_EQ(banks[b]->get_bank_total_balance(validBankFingerprint), serial.get_bank_total_balance(validBankFingerprint));
+        const auto& other = banks[b]->get_customer_2_unpaid_loan_map(validBankFingerprint);
+        for (int i = 0; i < 40; ++i) {
+            auto expected = unpaid.find(people[0][i]);
+            auto found = other.find(people[b][i]);
+            ASSERT_EQ(found == other.end(), expected == unpaid.end());
+            if (found != other.end()) {
+                EXPECT_EQ(found->second, expected->second) << "customer " << i;
+            }
+            EXPECT_EQ(people[b][i]->get_socioeconomic_rank(), people[0][i]->get_socioeconomic_rank()) << "customer " << i;
+        }
+    }
+
+    // Accrual needs the bank fingerprint and books interest on existing loans only, customer 3 never borrowed
+    {
+        const auto& held = serial.get_customer_2_accounts_map(validBankFingerprint);
+        Account* borrower = held.at(serialPeople[1].get()).front();
+        Account* saver = held.at(serialPeople[3].get()).front();
+        std::string wrongFingerprint = "wrongFingerprint";
+        EXPECT_THROW(serial.accrue_interest(*borrower, 1.0, wrongFingerprint), std::invalid_argument);
+        EXPECT_THROW(serial.accrue_interest(*borrower, 0.0, validBankFingerprint), std::invalid_argument);
+        EXPECT_THROW(serial.accrue_interest(*borrower, -1.0, validBankFingerprint), std::invalid_argument);
+        EXPECT_THROW(serial.accrue_interest(*saver, 1.0, validBankFingerprint), std::invalid_argument);
+        // Outside end of day take_loan is the ordinary one, an empty fingerprint is refused
+        EXPECT_THROW(serial.take_loan(*borrower, "", 1.0), std::invalid_argument);
+    }
+    EXPECT_NEAR(unpaid.at(serialPeople[1].get()), 113.67 + 1.14, 1e-9);
+    EXPECT_FALSE(unpaid.contains(serialPeople[3].get()));
+    std::remove(path.c_str());
+}
+
+TEST_F(BankTest, BankCluster_CrossShardTransfersCommitOrAbort) {
+    BankCluster cluster(4, validBankName, validBankFingerprint);
+    std::vector<std::unique_ptr<Person>> people;
+    std::vector<std::string> fingerprints;
+    std::vector<Account*> accounts;
+    for (int i = 0; i < 16; ++i) {
+        fingerprints.push_back("customer-" + std::to_string(i));
+        people.push_back(std::make_unique<Person>(fingerprints.back(), 30, "Male", fingerprints.back(), 5, true));
+        accounts.push_back(cluster.create_account(*people.back(), fingerprints.back(), "pw"));
+        cluster.deposit(*accounts.back(), fingerprints.back(), 1000.0);
+        EXPECT_EQ(cluster.shard_of(*accounts.back()), cluster.shard_of(*people.back()));
+    }
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; ++t)
+        workers.emplace_back([&, t] {
+            for (int i = 0; i < 500; ++i) {
+                size_t from = (i * 5 + t) % accounts.size();
+                size_t to = (i * 11 + t + 1) % accounts.size();
+                auto* source = accounts[from];
+                try {
+                    cluster.transfer(*source, *accounts[to], fingerprints[from], source->get_CVV2(fingerprints[from]),
+                                     "pw", source->get_exp_date(fingerprints[from]), 7.5);
+                } catch (const std::invalid_argument&) {
+                    // ran dry, fine
+                }
+            }
+        });
+    for (auto& worker : workers)
+        worker.join();
+
+    auto stats = cluster.stats();
+    EXPECT_GT(stats.committed, 0u);
+    EXPECT_GT(stats.local_transfers, 0u);
+    EXPECT_EQ(stats.aborted, 0u);
+    EXPECT_EQ(cluster.in_flight(), Money());
+    EXPECT_EQ(cluster.total_balance(), Money(1600000));
+    Money summed;
+    for (auto* account : accounts)
+        summed += Money::from_double(account->get_balance());
+    EXPECT_EQ(summed, Money(1600000));
+
+    // Pick a source and a destination on different shards
+    size_t from = 0, to = 1;
+    while (cluster.shard_of(*accounts[to]) == cluster.shard_of(*accounts[from]))
+        ++to;
+    auto* source = accounts[from];
+    double before = source->get_balance();
+    EXPECT_THROW(cluster.transfer(*source, *accounts[to], fingerprints[from], "000", "pw",
+                                  source->get_exp_date(fingerprints[from]), 1.0), std::invalid_argument);
+    EXPECT_EQ(source->get_balance(), before) << "A no vote from the source leaves nothing to undo.";
+
+    // A blocked destination votes no, the source gets its money back
+    std::string bankFingerprint = validBankFingerprint;
+    auto& destinationShard = cluster.shard(cluster.shard_of(*accounts[to]));
+    destinationShard.get_bank().set_account_status(*accounts[to], false, bankFingerprint);
+    EXPECT_THROW(cluster.transfer(*source, *accounts[to], fingerprints[from], source->get_CVV2(fingerprints[from]), "pw",
+                                  source->get_exp_date(fingerprints[from]), 1.0), std::invalid_argument);
+    // Commit checks the destination again as it credits it, a refund to a blocked source still goes in
+    EXPECT_THROW(destinationShard.credit(*accounts[to], 1.0, validBankFingerprint), std::invalid_argument);
+    EXPECT_THROW(destinationShard.refund(*accounts[to], 1.0, "wrongFingerprint"), std::invalid_argument);
+    double blocked = accounts[to]->get_balance();
+    EXPECT_TRUE(destinationShard.refund(*accounts[to], 1.0, validBankFingerprint));
+    EXPECT_EQ(accounts[to]->get_balance(), blocked + 1.0);
+    EXPECT_TRUE(destinationShard.withdraw(*accounts[to], fingerprints[to], 1.0));
+    destinationShard.get_bank().set_account_status(*accounts[to], true, bankFingerprint);
+    Account* gone = destinationShard.create_account(*people[to], fingerprints[to], "pw");
+    EXPECT_EQ(source->get_balance(), before);
+    EXPECT_EQ(cluster.stats().aborted, 1u);
+    EXPECT_EQ(cluster.in_flight(), Money());
+    EXPECT_THROW(cluster.shard_of(*gone), std::invalid_argument) << "Only accounts created through the cluster are routed.";
+
+    // Within one shard a blocked destination is refused just the same
+    size_t local = from + 1;
+    while (cluster.shard_of(*accounts[local]) != cluster.shard_of(*accounts[from]))
+        ++local;
+    auto& sourceShard = cluster.shard(cluster.shard_of(*source));
+    sourceShard.set_account_status(*accounts[local], false, bankFingerprint);
+    auto locals = cluster.stats().local_transfers;
+    EXPECT_THROW(cluster.transfer(*source, *accounts[local], fingerprints[from], source->get_CVV2(fingerprints[from]), "pw",
+                                  source->get_exp_date(fingerprints[from]), 1.0), std::invalid_argument);
+    EXPECT_EQ(source->get_balance(), before);
+    EXPECT_EQ(cluster.stats().local_transfers, locals);
+
+    // The destination is blocked and unblocked while transfers to it are between prepare and commit:
+    // each one is either credited or refunded in full, never credited while blocked
+    cluster.deposit(*source, fingerprints[from], 200.0);
+    before += 200.0;
+    auto outcomes = cluster.stats();
+    double received = accounts[to]->get_balance();
+    std::atomic<bool> done{false};
+    std::thread toggler([&] {
+        for (bool status = false; !done; status = !status)
+            destinationShard.set_account_status(*accounts[to], status, bankFingerprint);
+    });
+    for (int i = 0; i < 200; ++i) {
+        try {
+            cluster.transfer(*source, *accounts[to], fingerprints[from], source->get_CVV2(fingerprints[from]), "pw",
+                             source->get_exp_date(fingerprints[from]), 1.0);
+        } catch (const std::invalid_argument&) {
+            // blocked at prepare or at commit
+        }
+    }
+    done = true;
+    toggler.join();
+    auto committed = cluster.stats().committed - outcomes.committed;
+    EXPECT_EQ(committed + cluster.stats().aborted - outcomes.aborted, 200u);
+    EXPECT_EQ(accounts[to]->get_balance(), received + static_cast<double>(committed));
+    EXPECT_EQ(source->get_balance(), before - static_cast<double>(committed));
+    EXPECT_EQ(cluster.in_flight(), Money());
+    EXPECT_EQ(cluster.total_balance(), Money(1620000));
+}
+
+TEST_F(BankTest, BankCluster_CommitStageSeesCrossShardTransfers) {
+    struct Recording : CommitStage {
+        std::mutex mutex;
+        std::vector<TransferEvent> events;
+        void on_transfer(const TransferEvent& event) noexcept override {
+            std::lock_guard lock(mutex);
+            events.push_back(event);
+        }
+    };
+
+    BankCluster cluster(2, validBankName, validBankFingerprint);
+    std::vector<std::unique_ptr<Person>> people;
+    std::vector<std::string> fingerprints;
+    std::vector<Account*> accounts;
+    for (int i = 0; i < 8; ++i) {
+        fingerprints.push_back("customer-" + std::to_string(i));
+        people.push_back(std::make_unique<Person>(fingerprints.back(), 30, "Male", fingerprints.back(), 5, true));
+        accounts.push_back(cluster.create_account(*people.back(), fingerprints.back(), "pw"));
+        cluster.deposit(*accounts.back(), fingerprints.back(), 100.0);
+    }
+    size_t from = 0, to = 1, local = 1;
+    while (cluster.shard_of(*accounts[to]) == cluster.shard_of(*accounts[from]))
+        ++to;
+    while (cluster.shard_of(*accounts[local]) != cluster.shard_of(*accounts[from]))
+        ++local;
+    auto* source = accounts[from];
+    auto send = [&](Account* destination, double amount) {
+        cluster.transfer(*source, *destination, fingerprints[from], source->get_CVV2(fingerprints[from]), "pw",
+                         source->get_exp_date(fingerprints[from]), amount);
+    };
+
+    Recording stage;
+    cluster.set_commit_stage(&stage);
+    send(accounts[to], 2.5);
+    send(accounts[local], 1.0);
+    // An aborted transfer is no event
+    std::string bankFingerprint = validBankFingerprint;
+    auto& destinationShard = cluster.shard(cluster.shard_of(*accounts[to]));
+    destinationShard.set_account_status(*accounts[to], false, bankFingerprint);
+    EXPECT_THROW(send(accounts[to], 1.0), std::invalid_argument);
+    destinationShard.set_account_status(*accounts[to], true, bankFingerprint);
+
+    ASSERT_EQ(stage.events.size(), 2u);
+    EXPECT_EQ(stage.events[0].source, *AccountIndex::parse(source->get_account_number()));
+    EXPECT_EQ(stage.events[0].destination, *AccountIndex::parse(accounts[to]->get_account_number()));
+    EXPECT_EQ(stage.events[0].amount, Money(250));
+    EXPECT_EQ(stage.events[1].destination, *AccountIndex::parse(accounts[local]->get_account_number()));
+    EXPECT_EQ(cluster.stats().committed + cluster.stats().local_transfers, stage.events.size());
+
+    cluster.set_commit_stage(nullptr);
+    send(accounts[to], 1.0);
+    EXPECT_EQ(stage.events.size(), 2u);
+}
+
+TEST_F(BankTest, LatencyHistogram_PercentilesWithinOnePercent) {
+    LatencyHistogram first, second;
+    EXPECT_EQ(first.value_at_percentile(99), 0u);
+    for (std::uint64_t value = 1; value <= 100000; ++value)
+        (value % 2 ? first : second).record(value * 1000);
+    first.merge(second);
+
+    EXPECT_EQ(first.count(), 100000u);
+    EXPECT_EQ(first.min(), 1000u);
+    EXPECT_EQ(first.max(), 100000000u);
+    EXPECT_NEAR(first.mean(), 50000500.0, 1e-3);
+    for (double percentile : {50.0, 99.0, 99.9}) {
+        double exact = percentile * 1000000;
+        auto reported = static_cast<double>(first.value_at_percentile(percentile));
+        EXPECT_GE(reported, exact) << percentile;
+        EXPECT_LE(reported, exact * (1 + 1.0 / LatencyHistogram::SUB_BUCKETS)) << percentile;
+    }
+    EXPECT_EQ(first.value_at_percentile(100), first.max());
+
+    // Small values have a bucket each, the largest one still has a bucket
+    LatencyHistogram edges;
+    edges.record(0);
+    edges.record(255);
+    edges.record(std::numeric_limits<std::uint64_t>::max());
+    EXPECT_EQ(edges.value_at_percentile(1), 0u);
+    EXPECT_EQ(edges.value_at_percentile(50), 255u);
+    EXPECT_EQ(edges.value_at_percentile(100), std::numeric_limits<std::uint64_t>::max());
+}
+
+TEST_F(BankTest, ConcurrentBank_DetachingAStageWaitsForItsCalls) {
+    // Counts events that arrive after set_commit_stage said the stage was free
+    struct Counting : CommitStage {
+        std::atomic<bool> detached{false};
+        std::atomic<size_t> events{0};
+        std::atomic<size_t> late{0};
+        std::atomic<size_t> unnumbered{0};
+        void on_transfer(const TransferEvent& event) noexcept override {
+            std::this_thread::sleep_for(std::chrono::microseconds(20));
+            events++;
+            if (event.source == 0 || event.destination == 0)
+                unnumbered++;
+            if (detached)
+                late++;
+        }
+    };
+
+    Bank bank = createValidBank();
+    ConcurrentBank concurrent(bank);
+    Person* person = createValidPerson();
+    std::string ownerFingerprint = "personFingerprint";
+    std::vector<Account*> accounts;
+    for (int i = 0; i < 8; ++i) {
+        accounts.push_back(concurrent.create_account(*person, ownerFingerprint, "pw"));
+        concurrent.deposit(*accounts.back(), ownerFingerprint, 1000.0);
+    }
+
+    Counting stage;
+    concurrent.set_commit_stage(&stage);
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; ++t)
+        workers.emplace_back([&, t] {
+            for (size_t i = t; !stop; ++i) {
+                auto* source = accounts[i % accounts.size()];
+                concurrent.transfer(*source, *accounts[(i + 1) % accounts.size()], ownerFingerprint,
+                                    source->get_CVV2(ownerFingerprint), "pw", source->get_exp_date(ownerFingerprint), 0.01);
+            }
+        });
+    while (stage.events < 100)
+        std::this_thread::yield();
+    concurrent.set_commit_stage(nullptr);
+    stage.detached = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    stop = true;
+    for (auto& worker : workers)
+        worker.join();
+
+    EXPECT_EQ(stage.late, 0u);
+    EXPECT_EQ(stage.unnumbered, 0u);
+    delete person;
+}
+
+TEST_F(BankTest, FraudMonitor_AlertsOnBurstsAmountsAndHeavyHitters) {
+    using namespace std::chrono;
+    std::atomic<std::int64_t> now{0};
+    std::mutex alertsMutex;
+    std::vector<FraudAlert> alerts;
+    FraudRules rules{.window = milliseconds(8000), .max_transfers = 10, .max_amount = Money(50000),
+                     .heavy_hitter_share = 0.3, .heavy_hitter_minimum = 100, .queue_capacity = 1024};
+    FraudMonitor monitor(
+        rules,
+        [&](const FraudAlert& alert) {
+            std::lock_guard lock(alertsMutex);
+            alerts.push_back(alert);
+        },
+        [&] { return system_clock::time_point(milliseconds(now.load())); });
+
+    Bank bank = createValidBank();
+    ConcurrentBank concurrent(bank);
+    concurrent.set_commit_stage(&monitor);
+    Person* person = createValidPerson();
+    std::string ownerFingerprint = "personFingerprint";
+    std::vector<Account*> accounts;
+    for (int i = 0; i < 4; ++i) {
+        accounts.push_back(concurrent.create_account(*person, ownerFingerprint, "pw"));
+        concurrent.deposit(*accounts.back(), ownerFingerprint, 10000.0);
+    }
+    auto send = [&](Account* source, Account* destination, double amount) {
+        concurrent.transfer(*source, *destination, ownerFingerprint, source->get_CVV2(ownerFingerprint), "pw",
+                            source->get_exp_date(ownerFingerprint), amount);
+    };
+    auto count = [&](FraudAlertType type, const Account* account) {
+        monitor.drain();
+        std::lock_guard lock(alertsMutex);
+        auto number = *AccountIndex::parse(account->get_account_number());
+        return std::count_if(alerts.begin(), alerts.end(),
+                             [&](const FraudAlert& alert) { return alert.type == type && alert.account == number; });
+    };
+
+    // The eleventh transfer in the window is a burst, reported once however long it goes on
+    for (int i = 0; i < 13; ++i)
+        send(accounts[0], accounts[1], 1.0);
+    EXPECT_EQ(count(FraudAlertType::Burst, accounts[0]), 1);
+    {
+        std::lock_guard lock(alertsMutex);
+        EXPECT_EQ(alerts.front().transfers, 11u);
+        EXPECT_EQ(alerts.front().amount, Money(1100));
+    }
+
+    // Once the window has slid past, a new burst is a new alert
+    now = 9000;
+    for (int i = 0; i < 11; ++i)
+        send(accounts[0], accounts[1], 1.0);
+    EXPECT_EQ(count(FraudAlertType::Burst, accounts[0]), 2);
+
+    send(accounts[2], accounts[1], 600.0);
+    EXPECT_EQ(count(FraudAlertType::Amount, accounts[2]), 1);
+    EXPECT_EQ(count(FraudAlertType::Burst, accounts[2]), 0);
+
+    // In a fresh window account 3 sends 40% of the transfers, the others 20% each.
+    // Shares only count from the hundredth transfer on, account 3's next ones report it.
+    now = 20000;
+    for (int i = 0; i < 110; ++i)
+        send(i % 5 < 2 ? accounts[3] : accounts[i % 3], accounts[(i + 1) % 3], 0.01);
+    EXPECT_EQ(count(FraudAlertType::HeavyHitter, accounts[3]), 1);
+    for (int i = 0; i < 3; ++i)
+        EXPECT_EQ(count(FraudAlertType::HeavyHitter, accounts[i]), 0) << i;
+
+    auto stats = monitor.stats();
+    EXPECT_EQ(stats.received, 13u + 11u + 1u + 110u);
+    EXPECT_EQ(stats.processed, stats.received);
+    EXPECT_EQ(stats.dropped, 0u);
+    concurrent.set_commit_stage(nullptr);
+    send(accounts[0], accounts[1], 1.0);
+    EXPECT_EQ(monitor.stats().received, stats.received);
+    delete person;
+}